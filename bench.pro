@@ -0,0 +1,11 @@
+# Microbenchmarks for the simulation's hot paths; prints CSV, or JSON with --json.
+# Build it alongside cloth.pro with qmake bench.pro && make
+TARGET=cloth_bench
+OBJECTS_DIR=obj/bench
+# no Qt at all, just the simulation and NGL
+CONFIG-=qt app_bundle
+CONFIG+=console
+SOURCES+= $$PWD/bench/main.cpp
+include($$PWD/sim.pri)
+# where our exe is going to live (root of project)
+DESTDIR=./
@@ -0,0 +1,320 @@
+/****************************************************************************
+Times the simulation's hot paths one at a time over a range of cloth resolutions and prints the
+results as CSV (or JSON with --json), so that a slower build shows up before it is deployed.
+****************************************************************************/
+#include "Cloth.h"
+#include "Integrator.h"
+#include "PackedPoints.h"
+#include "Solver.h"
+#include "ThreadPool.h"
+#include "TopologyCache.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    //the settings shared by every benchmark
+    struct Settings
+    {
+        unsigned int minResolution;
+        unsigned int maxResolution;
+        double minSeconds;
+        unsigned int minRepetitions;
+        bool json;
+        std::string only;
+    };
+
+    //one line of output
+    struct Result
+    {
+        std::string name;
+        unsigned int widthNum;
+        unsigned int heightNum;
+        unsigned int particleNum;
+        unsigned int springNum;
+        unsigned int repetitions;
+        double bestNanoseconds;
+        double meanNanoseconds;
+        //scratch buffers each repetition took from the solver's FrameArena, and the blocks the
+        //arena had to take from the heap over the whole measurement
+        double arenaAllocations;
+        unsigned int heapAllocations;
+    };
+
+    CS::ClothInfo makeInfo(const unsigned int &_resolution)
+    {
+        CS::ClothInfo info;
+        info.widthNum = _resolution;
+        info.heightNum = _resolution;
+        info.width = 2.56f;
+        info.height = 1.636f;
+        info.springConstant = 1024.0f;
+        info.dampingConstant = 512.0f;
+        info.sphereRadius = 1.0f;
+        info.anchoredTopLeft = true;
+        info.anchoredTopRight = true;
+        return info;
+    }
+
+    //runs _setup then times _body until enough time and repetitions have passed; _setup isn't
+    //timed, so each repetition can start from the same state
+    void measure(const Settings &_settings, Result &_result, const std::function<void()> &_setup, const std::function<void()> &_body)
+    {
+        double best = 0.0;
+        double total = 0.0;
+        unsigned int repetitions = 0;
+
+        while (repetitions < _settings.minRepetitions || total < _settings.minSeconds * 1e9)
+        {
+            _setup();
+            Clock::time_point start = Clock::now();
+            _body();
+            double nanoseconds = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+            best = (repetitions == 0 || nanoseconds < best) ? nanoseconds : best;
+            total += nanoseconds;
+            ++repetitions;
+        }
+
+        _result.repetitions = repetitions;
+        _result.bestNanoseconds = best;
+        _result.meanNanoseconds = total / repetitions;
+    }
+
+    void printHeader(const Settings &_settings)
+    {
+        if (_settings.json)
+        {
+            std::printf("{\n  \"threads\": %u,\n  \"integrator\": \"%s\",\n  \"results\": [",
+                        ThreadPool::instance()->getThreadCount(),
+                        Integrator::getInstructionSetName(Integrator::getInstructionSet()));
+        }
+        else
+        {
+            std::printf("benchmark,width,height,particles,springs,repetitions,best_ns,mean_ns,ns_per_particle,ns_per_spring,arena_allocs_per_rep,arena_heap_allocs\n");
+        }
+    }
+
+    void printResult(const Settings &_settings, const Result &_result, const bool &_first)
+    {
+        double perParticle = _result.particleNum ? _result.bestNanoseconds / _result.particleNum : 0.0;
+        double perSpring = _result.springNum ? _result.bestNanoseconds / _result.springNum : 0.0;
+
+        if (_settings.json)
+        {
+            std::printf("%s\n    {\"benchmark\": \"%s\", \"width\": %u, \"height\": %u, \"particles\": %u, \"springs\": %u, "
+                        "\"repetitions\": %u, \"best_ns\": %.1f, \"mean_ns\": %.1f, \"ns_per_particle\": %.4f, \"ns_per_spring\": %.4f, "
+                        "\"arena_allocs_per_rep\": %.1f, \"arena_heap_allocs\": %u}",
+                        _first ? "" : ",", _result.name.c_str(), _result.widthNum, _result.heightNum, _result.particleNum,
+                        _result.springNum, _result.repetitions, _result.bestNanoseconds, _result.meanNanoseconds, perParticle, perSpring,
+                        _result.arenaAllocations, _result.heapAllocations);
+        }
+        else
+        {
+            std::printf("%s,%u,%u,%u,%u,%u,%.1f,%.1f,%.4f,%.4f,%.1f,%u\n",
+                        _result.name.c_str(), _result.widthNum, _result.heightNum, _result.particleNum,
+                        _result.springNum, _result.repetitions, _result.bestNanoseconds, _result.meanNanoseconds, perParticle, perSpring,
+                        _result.arenaAllocations, _result.heapAllocations);
+        }
+        std::fflush(stdout);
+    }
+
+    void printFooter(const Settings &_settings)
+    {
+        if (_settings.json)
+        {
+            std::printf("\n  ]\n}\n");
+        }
+    }
+
+    void printUsage(const char *_program)
+    {
+        std::cout<<"usage: "<<_program<<" [options]\n"
+                 <<"  --min-resolution N  smallest cloth to time, NxN (default 16)\n"
+                 <<"  --max-resolution N  largest cloth to time, NxN (default 1024)\n"
+                 <<"  --min-time SECONDS  minimum time spent on each measurement (default 0.2)\n"
+                 <<"  --min-reps N        minimum repetitions of each measurement (default 3)\n"
+                 <<"  --threads N         solver threads, 0 for one per core (default 0)\n"
+                 <<"  --only NAME         only run the named benchmark\n"
+                 <<"  --json              print JSON rather than CSV\n"
+                 <<"benchmarks: updateSpring updateParticle integrate selfCollision sphereCollision step reset resetCached getPoints packPoints getIndices\n";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Settings settings;
+    settings.minResolution = 16;
+    settings.maxResolution = 1024;
+    settings.minSeconds = 0.2;
+    settings.minRepetitions = 3;
+    settings.json = false;
+    unsigned int threads = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *option = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(option, "--min-resolution") && hasValue)
+        {
+            settings.minResolution = (unsigned int)atoi(argv[++i]);
+        }
+        else if (!strcmp(option, "--max-resolution") && hasValue)
+        {
+            settings.maxResolution = (unsigned int)atoi(argv[++i]);
+        }
+        else if (!strcmp(option, "--min-time") && hasValue)
+        {
+            settings.minSeconds = atof(argv[++i]);
+        }
+        else if (!strcmp(option, "--min-reps") && hasValue)
+        {
+            settings.minRepetitions = std::max(1, atoi(argv[++i]));
+        }
+        else if (!strcmp(option, "--threads") && hasValue)
+        {
+            threads = (unsigned int)atoi(argv[++i]);
+        }
+        else if (!strcmp(option, "--only") && hasValue)
+        {
+            settings.only = argv[++i];
+        }
+        else if (!strcmp(option, "--json"))
+        {
+            settings.json = true;
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return strcmp(option, "--help") ? EXIT_FAILURE : EXIT_SUCCESS;
+        }
+    }
+
+    ThreadPool::instance()->setThreadCount(threads);
+    printHeader(settings);
+
+    bool first = true;
+    for (unsigned int resolution = std::max(2u, settings.minResolution); resolution <= settings.maxResolution; resolution *= 2)
+    {
+        CS::ClothInfo info = makeInfo(resolution);
+        Cloth cloth(info);
+        const CS::SpringStore &springs = cloth.getSprings();
+        const unsigned int particleNum = cloth.getParticles().size();
+        const unsigned int springNum = springs.size();
+
+        Solver solver;
+        CS::ParticleStore particles;
+        CS::Particle sphere(0, 1.0f, 1.0f, ngl::Vec3(0.0f, 0.0f, -0.5f));
+        //a whole step with everything that needs scratch space turned on; XPBD, as the
+        //force-based springs aren't stable at the larger sizes with this step
+        Solver stepSolver;
+        stepSolver.m_mode = Solver::XPBD;
+        stepSolver.m_applySelfCollision = true;
+        stepSolver.m_sphere = &sphere;
+        std::vector<GLfloat> points(cloth.getPointsArraySizeCopy() / sizeof(GLfloat));
+        std::vector<GLuint> indices(cloth.getIndicesArraySize());
+        std::vector<uint16_t> packed(4 * (size_t)particleNum);
+
+        //every timed pass starts from a fresh copy of the cloth's initial particles
+        std::function<void()> copyParticles = [&]() {particles = cloth.getParticles();};
+        std::function<void()> nothing = []() {};
+        std::function<void()> forgetTopology = []() {TopologyCache::instance()->clear();};
+
+        struct Benchmark
+        {
+            const char *name;
+            std::function<void()> setup;
+            std::function<void()> body;
+        };
+        std::vector<Benchmark> benchmarks;
+
+        benchmarks.push_back({"updateSpring", copyParticles, [&]()
+        {
+            for (unsigned int i = 0; i < springNum; ++i)
+            {
+                solver.updateSpring(&particles, &springs, i);
+            }
+        }});
+        benchmarks.push_back({"updateParticle", copyParticles, [&]()
+        {
+            for (unsigned int i = 0; i < particleNum; ++i)
+            {
+                solver.updateParticle(&particles, i, 0.01f);
+            }
+        }});
+        //the batched version of updateParticle() that advance() actually uses, with the Solver's air resistance
+        benchmarks.push_back({"integrate", copyParticles, [&]()
+        {
+            Integrator::integrate(&particles, 0, 0, particleNum, solver.m_gravity, -256.0f, 0.0001f);
+        }});
+        benchmarks.push_back({"selfCollision", copyParticles, [&]()
+        {
+            solver.resolveSelfCollisions(&particles);
+        }});
+        benchmarks.push_back({"sphereCollision", copyParticles, [&]()
+        {
+            solver.resolveSphereCollisions(&particles, &sphere);
+        }});
+        benchmarks.push_back({"step", copyParticles, [&]()
+        {
+            stepSolver.advance(&springs, &particles, 0.0, 0.001f);
+        }});
+        //making the springs from scratch, as for a size that hasn't been seen before...
+        benchmarks.push_back({"reset", forgetTopology, [&]()
+        {
+            cloth.reset(info);
+        }});
+        //...and copying them out of the TopologyCache, as every later reset at that size does
+        benchmarks.push_back({"resetCached", nothing, [&]()
+        {
+            cloth.reset(info);
+        }});
+        benchmarks.push_back({"getPoints", nothing, [&]()
+        {
+            cloth.getPoints(&points[0]);
+        }});
+        //the conversion GLWindow does on the way to the GPU
+        benchmarks.push_back({"packPoints", nothing, [&]()
+        {
+            PackedPoints::pack(&points[0], &packed[0], 0, particleNum);
+        }});
+        benchmarks.push_back({"getIndices", nothing, [&]()
+        {
+            cloth.getIndices(&indices[0]);
+        }});
+
+        for (std::vector<Benchmark>::iterator it = benchmarks.begin(); it != benchmarks.end(); ++it)
+        {
+            if (!settings.only.empty() && settings.only != (*it).name)
+            {
+                continue;
+            }
+
+            Result result;
+            result.name = (*it).name;
+            result.widthNum = resolution;
+            result.heightNum = resolution;
+            result.particleNum = particleNum;
+            result.springNum = springNum;
+            const unsigned long long allocations = solver.getArena().getTotalAllocationCount() + stepSolver.getArena().getTotalAllocationCount();
+            const unsigned int heapAllocations = solver.getArena().getHeapAllocationCount() + stepSolver.getArena().getHeapAllocationCount();
+            measure(settings, result, (*it).setup, (*it).body);
+            result.arenaAllocations = double(solver.getArena().getTotalAllocationCount() + stepSolver.getArena().getTotalAllocationCount() - allocations) / result.repetitions;
+            result.heapAllocations = solver.getArena().getHeapAllocationCount() + stepSolver.getArena().getHeapAllocationCount() - heapAllocations;
+            printResult(settings, result, first);
+            first = false;
+        }
+    }
+
+    printFooter(settings);
+    return EXIT_SUCCESS;
+}
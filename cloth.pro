@@ -30,6 +30,8 @@ OTHER_FILES+= shaders/*.glsl \
     shaders/NormalGeneration.frag
 # were are going to default to a console app
 CONFIG += console
+# the solver uses std::thread for its parallel passes
+CONFIG += c++11 thread
 DEFINES+=ADDLARGEMODELS
 # note each command you add needs a ; as it will be run as a single line
 # first check if we are shadow building or not easiest way is to check out against current
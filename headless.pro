@@ -0,0 +1,11 @@
+# A command-line build of the simulation with no window or GL context, for batch runs on
+# machines without a display. Build it alongside cloth.pro with qmake headless.pro && make
+TARGET=cloth_headless
+OBJECTS_DIR=obj/headless
+# no Qt at all, just the simulation and NGL
+CONFIG-=qt app_bundle
+CONFIG+=console
+SOURCES+= $$PWD/headless/main.cpp
+include($$PWD/sim.pri)
+# where our exe is going to live (root of project)
+DESTDIR=./
@@ -0,0 +1,372 @@
+/****************************************************************************
+Runs the cloth simulation without a window or GL context and reports how fast it stepped; for batch
+sims on machines with no display.
+****************************************************************************/
+#include "Cloth.h"
+#include "ClothFile.h"
+#include "PointCacheWriter.h"
+#include "Replay.h"
+#include "ThreadPool.h"
+#include "TopologyCache.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+    void printUsage(const char *_program)
+    {
+        std::cout<<"usage: "<<_program<<" [options]\n"
+                 <<"  --resolution W H   particles along each axis (default 16 16)\n"
+                 <<"  --size W H         dimensions of the sheet (default 2.56 1.636)\n"
+                 <<"  --block-size N     store the particles in NxN blocks, 1 for rows (default 8)\n"
+                 <<"  --steps N          how many steps to run (default 1000)\n"
+                 <<"  --dt SECONDS       timestep of each step (default 0.01)\n"
+                 <<"  --threads N        solver threads, 0 for one per core (default 0)\n"
+                 <<"  --spring K         spring constant (default 1024)\n"
+                 <<"  --damping D        damping constant (default 512)\n"
+                 <<"  --gravity G        gravity strength (default 32)\n"
+                 <<"  --speed S          simulation speed multiplier (default 1)\n"
+                 <<"  --xpbd             solve the springs as XPBD constraints instead of forces\n"
+                 <<"  --iterations N     XPBD iterations per step (default 8)\n"
+                 <<"  --implicit         integrate the springs implicitly (backward Euler)\n"
+                 <<"  --self-collision   collide the cloth with itself\n"
+                 <<"  --no-sphere        don't collide with the sphere\n"
+                 <<"  --wind             apply the wind force\n"
+                 <<"  --anchor-bottom    anchor the bottom corners as well as the top ones\n"
+                 <<"  --sleep            let settled parts of the cloth sleep until disturbed\n"
+                 <<"  --load FILE        start from a state saved with --save; the options above\n"
+                 <<"                     that set up the cloth are then ignored\n"
+                 <<"  --save FILE        save the state after the last step\n"
+                 <<"  --topology-cache DIR  keep the springs made for each size of cloth in DIR and\n"
+                 <<"                     reuse them in later runs\n"
+                 <<"  --cache FILE       record the particle positions at every step to a point cache\n"
+                 <<"  --cache-encoding E raw, quantized or delta (default delta)\n"
+                 <<"  --record FILE      record a replay of the run; the starting state goes in\n"
+                 <<"                     FILE.cloth\n"
+                 <<"  --hash-interval N  steps between the replay's state checks (default 10)\n"
+                 <<"  --replay FILE      run a recorded replay instead and report any step where\n"
+                 <<"                     the state differs; every option but --threads is ignored\n";
+    }
+
+    //restores a replay's starting state and runs it through, printing where it diverges
+    int runReplay(const char *_path)
+    {
+        Replay replay;
+        if (!replay.load(_path))
+        {
+            std::cerr<<"couldn't load a replay from "<<_path<<"\n";
+            return EXIT_FAILURE;
+        }
+        Cloth cloth;
+        if (!ClothFile::load(cloth, Replay::getStatePath(_path)))
+        {
+            std::cerr<<"couldn't load the replay's starting state from "<<Replay::getStatePath(_path)<<"\n";
+            return EXIT_FAILURE;
+        }
+
+        std::vector<Replay::Divergence> divergences;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        replay.play(cloth, divergences);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout<<"replayed "<<replay.getStepNum()<<" steps and "<<replay.getEvents().size()<<" command(s) on "
+                 <<ThreadPool::instance()->getThreadCount()<<" thread(s) in "<<seconds<<" s: "
+                 <<divergences.size()<<" of "<<replay.getCheckpoints().size()<<" checkpoints diverged\n";
+        if (divergences.empty())
+        {
+            return EXIT_SUCCESS;
+        }
+        std::cout<<"first divergence at step "<<divergences[0].m_step<<": expected "<<std::hex
+                 <<divergences[0].m_expected<<", got "<<divergences[0].m_actual<<std::dec<<"\n";
+        return EXIT_FAILURE;
+    }
+
+    //checks there are enough arguments left for an option, complaining if not
+    bool hasValues(const int &_argc, const int &_i, const int &_count, const char *_option)
+    {
+        if (_i + _count >= _argc)
+        {
+            std::cerr<<_option<<" needs "<<_count<<" value(s)\n";
+            return false;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    CS::ClothInfo info;
+    info.widthNum = 16;
+    info.heightNum = 16;
+    info.width = 2.56f;
+    info.height = 1.636f;
+    info.springConstant = 1024.0f;
+    info.dampingConstant = 512.0f;
+    info.sphereRadius = 1.0f;
+    info.anchoredTopLeft = true;
+    info.anchoredTopRight = true;
+    info.blockSize = 8;
+
+    unsigned int steps = 1000;
+    unsigned int threads = 0;
+    float deltaSeconds = 0.01f;
+    float gravity = 32.0f;
+    float speed = 1.0f;
+    bool selfCollision = false;
+    bool sleeping = false;
+    bool sphereCollision = true;
+    bool wind = false;
+    Solver::Mode mode = Solver::FORCE_BASED;
+    unsigned int iterations = 8;
+    const char *loadPath = 0;
+    const char *savePath = 0;
+    const char *cachePath = 0;
+    PointCache::Encoding cacheEncoding = PointCache::DELTA;
+    const char *recordPath = 0;
+    const char *replayPath = 0;
+    unsigned int hashInterval = 10;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *option = argv[i];
+        if (!strcmp(option, "--resolution") && hasValues(argc, i, 2, option))
+        {
+            info.widthNum = atoi(argv[++i]);
+            info.heightNum = atoi(argv[++i]);
+        }
+        else if (!strcmp(option, "--size") && hasValues(argc, i, 2, option))
+        {
+            info.width = (float)atof(argv[++i]);
+            info.height = (float)atof(argv[++i]);
+        }
+        else if (!strcmp(option, "--block-size") && hasValues(argc, i, 1, option))
+        {
+            info.blockSize = atoi(argv[++i]);
+        }
+        else if (!strcmp(option, "--steps") && hasValues(argc, i, 1, option))
+        {
+            steps = (unsigned int)atoi(argv[++i]);
+        }
+        else if (!strcmp(option, "--dt") && hasValues(argc, i, 1, option))
+        {
+            deltaSeconds = (float)atof(argv[++i]);
+        }
+        else if (!strcmp(option, "--threads") && hasValues(argc, i, 1, option))
+        {
+            threads = (unsigned int)atoi(argv[++i]);
+        }
+        else if (!strcmp(option, "--spring") && hasValues(argc, i, 1, option))
+        {
+            info.springConstant = (float)atof(argv[++i]);
+        }
+        else if (!strcmp(option, "--damping") && hasValues(argc, i, 1, option))
+        {
+            info.dampingConstant = (float)atof(argv[++i]);
+        }
+        else if (!strcmp(option, "--gravity") && hasValues(argc, i, 1, option))
+        {
+            gravity = (float)atof(argv[++i]);
+        }
+        else if (!strcmp(option, "--speed") && hasValues(argc, i, 1, option))
+        {
+            speed = (float)atof(argv[++i]);
+        }
+        else if (!strcmp(option, "--xpbd"))
+        {
+            mode = Solver::XPBD;
+        }
+        else if (!strcmp(option, "--implicit"))
+        {
+            mode = Solver::IMPLICIT;
+        }
+        else if (!strcmp(option, "--iterations") && hasValues(argc, i, 1, option))
+        {
+            iterations = (unsigned int)atoi(argv[++i]);
+        }
+        else if (!strcmp(option, "--self-collision"))
+        {
+            selfCollision = true;
+        }
+        else if (!strcmp(option, "--no-sphere"))
+        {
+            sphereCollision = false;
+        }
+        else if (!strcmp(option, "--wind"))
+        {
+            wind = true;
+        }
+        else if (!strcmp(option, "--topology-cache") && hasValues(argc, i, 1, option))
+        {
+            TopologyCache::instance()->setDirectory(argv[++i]);
+        }
+        else if (!strcmp(option, "--sleep"))
+        {
+            sleeping = true;
+        }
+        else if (!strcmp(option, "--anchor-bottom"))
+        {
+            info.anchoredBottomLeft = true;
+            info.anchoredBottomRight = true;
+        }
+        else if (!strcmp(option, "--load") && hasValues(argc, i, 1, option))
+        {
+            loadPath = argv[++i];
+        }
+        else if (!strcmp(option, "--save") && hasValues(argc, i, 1, option))
+        {
+            savePath = argv[++i];
+        }
+        else if (!strcmp(option, "--cache") && hasValues(argc, i, 1, option))
+        {
+            cachePath = argv[++i];
+        }
+        else if (!strcmp(option, "--cache-encoding") && hasValues(argc, i, 1, option))
+        {
+            const char *encoding = argv[++i];
+            if (!strcmp(encoding, "raw"))
+            {
+                cacheEncoding = PointCache::RAW;
+            }
+            else if (!strcmp(encoding, "quantized"))
+            {
+                cacheEncoding = PointCache::QUANTIZED;
+            }
+            else if (!strcmp(encoding, "delta"))
+            {
+                cacheEncoding = PointCache::DELTA;
+            }
+            else
+            {
+                std::cerr<<"unknown cache encoding "<<encoding<<"\n";
+                return EXIT_FAILURE;
+            }
+        }
+        else if (!strcmp(option, "--record") && hasValues(argc, i, 1, option))
+        {
+            recordPath = argv[++i];
+        }
+        else if (!strcmp(option, "--hash-interval") && hasValues(argc, i, 1, option))
+        {
+            hashInterval = (unsigned int)atoi(argv[++i]);
+        }
+        else if (!strcmp(option, "--replay") && hasValues(argc, i, 1, option))
+        {
+            replayPath = argv[++i];
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return strcmp(option, "--help") ? EXIT_FAILURE : EXIT_SUCCESS;
+        }
+    }
+
+    ThreadPool::instance()->setThreadCount(threads);
+
+    if (replayPath)
+    {
+        return runReplay(replayPath);
+    }
+
+    if (info.widthNum < 2 || info.heightNum < 2)
+    {
+        std::cerr<<"the cloth needs at least 2 particles along each axis\n";
+        return EXIT_FAILURE;
+    }
+
+    Cloth cloth(info);
+    cloth.setGravity(gravity);
+    cloth.setSimSpeed(speed);
+    cloth.setSelfCollisions(selfCollision);
+    cloth.setSphereCollisions(sphereCollision);
+    cloth.setSolverMode(mode);
+    cloth.setSolverIterations(iterations);
+    cloth.setSleeping(sleeping);
+    if (wind)
+    {
+        cloth.toggleWind();
+    }
+    if (loadPath && !ClothFile::load(cloth, loadPath))
+    {
+        std::cerr<<"couldn't load a cloth from "<<loadPath<<"\n";
+        return EXIT_FAILURE;
+    }
+
+    cloth.setTimestep(deltaSeconds);
+
+    Replay replay(hashInterval);
+    if (recordPath)
+    {
+        cloth.wakeAll();
+        if (!ClothFile::save(cloth, Replay::getStatePath(recordPath)))
+        {
+            std::cerr<<"couldn't save the replay's starting state to "<<Replay::getStatePath(recordPath)<<"\n";
+            return EXIT_FAILURE;
+        }
+        replay.addCheckpoint(0, cloth, true);
+    }
+
+    //the cache starts with the state before the first step
+    PointCacheWriter cache;
+    if (cachePath)
+    {
+        if (!cache.open(cachePath, cloth.getWidthNum(), cloth.getHeightHum(), cloth.getBlockSize(), cacheEncoding))
+        {
+            std::cerr<<"couldn't create a point cache at "<<cachePath<<"\n";
+            return EXIT_FAILURE;
+        }
+        cache.addFrame(cloth, 0.0);
+    }
+
+    //step exactly as the simulation thread does, just without waiting for the clock in between
+    double time = 0.0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < steps; ++i)
+    {
+        cloth.step();
+        time += deltaSeconds;
+        if (cache.isOpen())
+        {
+            cache.addFrame(cloth, time);
+        }
+        if (recordPath)
+        {
+            replay.addCheckpoint(i + 1, cloth, i + 1 == steps);
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (recordPath && !replay.save(recordPath))
+    {
+        std::cerr<<"couldn't save the replay to "<<recordPath<<"\n";
+        return EXIT_FAILURE;
+    }
+
+    if (cache.isOpen() && !cache.close())
+    {
+        std::cerr<<"couldn't write all of the point cache to "<<cachePath<<"\n";
+        return EXIT_FAILURE;
+    }
+
+    if (savePath && !ClothFile::save(cloth, savePath))
+    {
+        std::cerr<<"couldn't save the cloth to "<<savePath<<"\n";
+        return EXIT_FAILURE;
+    }
+
+    mode = cloth.getSolverMode();
+    std::cout<<cloth.getWidthNum()<<"x"<<cloth.getHeightHum()<<" particles, "
+             <<(mode == Solver::XPBD ? "XPBD, " : mode == Solver::IMPLICIT ? "implicit, " : "force-based, ")
+             <<ThreadPool::instance()->getThreadCount()<<" thread(s)\n"
+             <<steps<<" steps in "<<seconds<<" s: "
+             <<(seconds > 0.0 ? steps / seconds : 0.0)<<" steps/sec, "
+             <<(steps > 0 ? 1000.0 * seconds / steps : 0.0)<<" ms/step\n";
+    if (cloth.isSleeping())
+    {
+        std::cout<<cloth.getSleepingTileNum()<<" of "<<(cloth.getParticles().size() + SLEEP_TILE_SIZE - 1) / SLEEP_TILE_SIZE
+                 <<" tile(s) asleep\n";
+    }
+
+    return EXIT_SUCCESS;
+}
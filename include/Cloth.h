@@ -4,13 +4,17 @@
 #include "Common.h"
 //#include "Spring.h"
 #include "Solver.h"
+#include <algorithm>
 #include <math.h>
 #include <iostream>
 
 //since m_particles is a one-dimensional array representing a two-dimensional grid,
 //this macro is used to return the array index from two "co-ordinates" for readability
 //(this system is faster than having a two-dimensional vector, right?)
-#define PARTICLEINDEX(_x,_y) (_x)+((_y)*m_widthNum)
+#define PARTICLEINDEX(_x,_y) getParticleIndex((_x),(_y),m_widthNum,m_heightNum,m_blockSize)
+//how many consecutive particles updateTileVersions() tracks together; small enough that a still
+//region of the cloth covers whole tiles, large enough that a moving one is a few big copies
+#define CHANGE_TILE_SIZE 256
 
 
 /// @file Cloth.h
@@ -38,7 +42,9 @@ public:
     ~Cloth();
 
     /// @brief The sphere used for demonstrating collision with the cloth. It is treated simply as
-    /// as a particle like those of the cloth itself, but with no connected springs.
+    /// as a particle like those of the cloth itself, but with no connected springs. Its previous
+    /// position is where it was at the start of the step, so moving it between steps sweeps it
+    /// through the cloth rather than teleporting it.
     CS::Particle m_sphere;
 
     /// @brief Advances the simulation to the next frame.
@@ -46,19 +52,77 @@ public:
     /// @param[in] _deltaSeconds The time in seconds since advance() was last called.
     void advance(const double &_time, const float &_deltaSeconds);
 
+    /// @brief Advances the simulation by however many fixed timesteps fit into the time elapsed
+    /// since the last call, plus any left over from before. Each timestep is split into
+    /// getSubsteps() calls to advance(), and at most getMaxStepsPerUpdate() timesteps are run per
+    /// call so that a slow frame can't snowball; any more time than that is dropped.
+    /// @param[in] _frameSeconds The real time in seconds since update() was last called.
+    /// @return How many fixed timesteps were run.
+    unsigned int update(const float &_frameSeconds);
+
+    /// @brief Runs exactly one fixed timestep, split into getSubsteps() calls to advance(), as
+    /// update() does for each timestep it runs; the time update() has left over is untouched.
+    void step();
+
+    /// @brief Returns how far between the last two fixed timesteps the leftover time in update()
+    /// puts us, from 0 (the older one) to 1 (the latest one). getInterpolatedPoints() uses this to
+    /// draw a smooth motion whatever the frame rate.
+    float getInterpolationAlpha() const;
+
+    /// @brief Sets the length of each fixed timestep run by update().
+    /// @param[in] _seconds The timestep in seconds (default is 0.01).
+    void setTimestep(const float &_seconds)             {m_timestep = std::max(_seconds, 1e-6f); m_solver.wakeAll();}
+
+    /// @brief Returns the length of each fixed timestep run by update().
+    float getTimestep() const                           {return m_timestep;}
+
+    /// @brief Sets how many solver steps each fixed timestep is split into; stiffer springs need
+    /// more of these to stay stable.
+    /// @param[in] _substeps The number of substeps (default is 1).
+    void setSubsteps(const unsigned int &_substeps)     {m_substeps = std::max(_substeps, 1u); m_solver.wakeAll();}
+
+    /// @brief Returns how many solver steps each fixed timestep is split into.
+    unsigned int getSubsteps() const                    {return m_substeps;}
+
+    /// @brief Sets the most fixed timesteps update() will run in one call.
+    /// @param[in] _steps The maximum number of timesteps (default is 4).
+    void setMaxStepsPerUpdate(const unsigned int &_steps)   {m_maxStepsPerUpdate = std::max(_steps, 1u);}
+
+    /// @brief Returns the most fixed timesteps update() will run in one call.
+    unsigned int getMaxStepsPerUpdate() const           {return m_maxStepsPerUpdate;}
+
     /// @brief Returns the number of bytes needed to represent all the vertices in a tightly-packed array:
     /// 4 * (number of particles) - three for XYZ and another for index (needed in my implementation
     /// so the shader knows which particle this references).
     unsigned int getPointsArraySizeCopy();
 
-    /// @brief Returns the number of bytes all the cloth's particles take up in total.
-    unsigned int getPointsArraySizeDirect();
-
     /// @brief Fills the specified array with GLfloats representing the positions of the cloth's
-    /// particles and their indices.
+    /// particles and their indices. This is the packing step between the structure-of-arrays
+    /// particle store and the interleaved layout OpenGL expects, and is used for both the vertex
+    /// buffer and the position texture.
     /// @param[out] _array[] A pointer to the first index in the array, i.e. the array itself.
     void getPoints(GLfloat _array[]);
 
+    /// @brief The same as getPoints(), but with each position blended between the last two fixed
+    /// timesteps run by update().
+    /// @param[out] _array[] A pointer to the first index in the array, i.e. the array itself.
+    /// @param[in] _alpha How far to blend from the older timestep to the latest one; usually
+    /// getInterpolationAlpha().
+    void getInterpolatedPoints(GLfloat _array[], const float &_alpha);
+
+    /// @brief Works out which tiles of CHANGE_TILE_SIZE particles have changed since they were last
+    /// marked, so whatever is copying the positions elsewhere can leave the rest alone. A tile has
+    /// changed if any of its particles has moved more than the tolerance since the tile was last
+    /// marked; its version is then set to the one given, and its positions remembered for next
+    /// time. Every tile is marked if the number of particles has changed.
+    /// @param[in] _version The version to give the tiles that have changed; should go up each call.
+    /// @param[in] _tolerance How far a particle can move along any axis without counting.
+    /// @return How many tiles changed.
+    unsigned int updateTileVersions(const uint32_t &_version, const float &_tolerance);
+
+    /// @brief Returns the version each tile last changed at, as set by updateTileVersions().
+    const std::vector<uint32_t>& getTileVersions() const    {return m_tileVersions;}
+
     /// @brief Returns the number of indices of particles.
     unsigned int getIndicesArraySize();
 
@@ -69,9 +133,47 @@ public:
     /// @param[out] _array[] A pointer to the first index in the array, i.e. the array itself.
     void getIndices(GLuint _array[]);
 
-    /// @brief Returns the memory address of the very first entry in the particle vector. Used by
-    /// OpenGL when it copies data to its buffers.
-    float* getFirstIndex()      {return &m_particles[0].m_isAnchored;}
+    /// @brief The same as getIndices(), but for a cloth of the specified resolution; useful when we
+    /// only have a copy of the cloth's positions rather than the cloth itself.
+    /// @param[out] _array[] A pointer to the first index in the array, i.e. the array itself.
+    /// @param[in] _widthNum The number of particles along the cloth's X axis.
+    /// @param[in] _heightNum The number of particles along the cloth's Y axis.
+    /// @param[in] _blockSize The size of the blocks the cloth's particles are stored in.
+    static void getIndices(GLuint _array[], const int &_widthNum, const int &_heightNum, const int &_blockSize);
+
+    /// @brief Returns where in the particle store the particle at the specified grid position is,
+    /// for a cloth of the specified resolution. The grid is cut into bands _blockSize rows tall
+    /// and each band into blocks _blockSize particles wide, stored one after another with the
+    /// particles in each block row by row; the last band and the last block of each band are
+    /// just cut short, so every index up to the particle count is used. The shaders have a copy
+    /// of this, and of getParticleCoords(), which must be kept in step with them.
+    /// @param[in] _x The X index of the particle.
+    /// @param[in] _y The Y index of the particle.
+    /// @param[in] _widthNum The number of particles along the cloth's X axis.
+    /// @param[in] _heightNum The number of particles along the cloth's Y axis.
+    /// @param[in] _blockSize The size of the blocks; 1 gives plain row by row storage.
+    static unsigned int getParticleIndex(const int &_x, const int &_y, const int &_widthNum, const int &_heightNum, const int &_blockSize);
+
+    /// @brief The reverse of getParticleIndex(): works out the grid position of the particle at
+    /// the specified index in the particle store.
+    /// @param[in] _index The index of the particle.
+    /// @param[in] _widthNum The number of particles along the cloth's X axis.
+    /// @param[in] _heightNum The number of particles along the cloth's Y axis.
+    /// @param[in] _blockSize The size of the blocks; 1 gives plain row by row storage.
+    /// @param[out] _x Set to the X index of the particle.
+    /// @param[out] _y Set to the Y index of the particle.
+    static void getParticleCoords(const unsigned int &_index, const int &_widthNum, const int &_heightNum, const int &_blockSize, int &_x, int &_y);
+
+    /// @brief Returns the number of indices of particles for a cloth of the specified resolution.
+    /// @param[in] _widthNum The number of particles along the cloth's X axis.
+    /// @param[in] _heightNum The number of particles along the cloth's Y axis.
+    static unsigned int getIndicesArraySize(const int &_widthNum, const int &_heightNum);
+
+    /// @brief Returns the store holding the cloth's particles.
+    const CS::ParticleStore& getParticles() const   {return m_particles;}
+
+    /// @brief Returns the store holding the cloth's springs.
+    const CS::SpringStore& getSprings() const       {return m_springs;}
 
     /// @brief Returns the number of particles the cloth has along its X axis.
     int getWidthNum() const     {return m_widthNum;}
@@ -79,6 +181,9 @@ public:
     /// @brief Returns the number of particles the cloth has along its Y axis.
     int getHeightHum() const    {return m_heightNum;}
 
+    /// @brief Returns the size of the blocks the cloth's particles are stored in.
+    int getBlockSize() const    {return m_blockSize;}
+
     /// @brief Toggles the application of a turbulent wind-like force to the cloth.
     void toggleWind()           {m_solver.m_applyWind = !m_solver.m_applyWind;}
 
@@ -88,10 +193,20 @@ public:
     /// @brief Toggle whether the simulation is in suspended animation.
     void togglePaused()         {m_isPaused = !m_isPaused;}
 
-    /// @brief Resets the simulation variables without actually re-creating the object.
+    /// @brief Resets the simulation variables without actually re-creating the object. The springs
+    /// are taken from the TopologyCache if a cloth of the same size has been made before.
     /// @param[in] _info A struct containing the values to reset the simulation variables to.
     void reset(const CS::ClothInfo &_info);
 
+    /// @brief Changes the cloth's dimensions and resolution while keeping its current shape. If
+    /// only the dimensions change the springs' rest lengths are rescaled in place, the anchored
+    /// particles moved to match and nothing else touched; if the resolution or block size changes
+    /// the cloth is rebuilt and its particles placed by sampling the old cloth where they fall on
+    /// it. Only the dimensions, resolution and block size are taken from _info.
+    /// @param[in] _info A struct containing the new dimensions and resolution.
+    /// @return Whether the cloth was rebuilt, i.e. its particles and springs have changed.
+    bool resize(const CS::ClothInfo &_info);
+
     /// @brief Returns a vector of Vert structs representing the data needed by OpenGL to draw the
     /// cloth. Now obsolete and replaced by getPoints() and getIndices().
     /// @param[in] _drawType A GL enum (e.g. GL_TRIANGLES) specifying how to format the data
@@ -100,27 +215,66 @@ public:
 
     /// @brief Set whether the cloth's particles should collide with the sphere.
     /// @param[in] _shouldUse Whether the collisions should be applied.
-    void setSphereCollisions(const bool &_shouldUse)    {m_solver.m_applySphereCollision = _shouldUse;}
+    void setSphereCollisions(const bool &_shouldUse)    {m_solver.m_applySphereCollision = _shouldUse; m_solver.wakeAll();}
 
     /// @brief Set whether the cloth's particles should collide with each other.
     /// @param[in] _shouldUse Whether the collisions should be applied.
-    void setSelfCollisions(const bool &_shouldUse)      {m_solver.m_applySelfCollision = _shouldUse;}
+    void setSelfCollisions(const bool &_shouldUse)      {m_solver.m_applySelfCollision = _shouldUse; m_solver.wakeAll();}
 
     /// @brief Set the strength of the gravity that affects the particles.
     /// @param[in] _gravity The gravity strength (default is 32).
-    void setGravity(const float &_gravity)              {m_solver.m_gravity = _gravity;}
+    void setGravity(const float &_gravity)              {m_solver.m_gravity = _gravity; m_solver.wakeAll();}
 
     /// @brief Set the speed of the simulation. DeltaSeconds is multiplied by this during advance().
     /// @param[in] _speed The speed multiplier to use.
-    void setSimSpeed(const float &_speed)               {m_solver.m_speed = _speed;}
+    void setSimSpeed(const float &_speed)               {m_solver.m_speed = _speed; m_solver.wakeAll();}
+
+    /// @brief Set how the springs are solved: as explicit forces, as XPBD distance constraints, or
+    /// as forces integrated implicitly; the last two stay stable at much larger timesteps and
+    /// fewer substeps.
+    /// @param[in] _mode The solver mode to use.
+    void setSolverMode(const Solver::Mode &_mode)       {m_solver.m_mode = _mode; m_solver.wakeAll();}
+
+    /// @brief Returns how the springs are solved.
+    Solver::Mode getSolverMode() const                  {return m_solver.m_mode;}
+
+    /// @brief Set how many times each step the XPBD mode projects every spring; more iterations
+    /// make the cloth stiffer and less stretchy. Has no effect in the force-based mode.
+    /// @param[in] _iterations The number of iterations, at least 1.
+    void setSolverIterations(const unsigned int &_iterations)   {m_solver.m_iterations = std::max(_iterations, 1u); m_solver.wakeAll();}
+
+    /// @brief Returns how many times each step the XPBD mode projects every spring.
+    unsigned int getSolverIterations() const            {return m_solver.m_iterations;}
+
+    /// @brief Returns the velocity change the implicit mode's last solve found, which its next
+    /// solve starts from; empty if the implicit mode hasn't run since the topology changed.
+    const std::vector<float>& getWarmStart() const      {return m_solver.getWarmStart();}
+
+    /// @brief Set whether parts of the cloth that have settled may be put to sleep and skipped
+    /// until something disturbs them; see Solver::m_allowSleeping. Long settling runs spend most
+    /// of their steps on cloth that has stopped moving, but a sleeping tile holds still rather
+    /// than carrying on creeping, so the result isn't quite what an awake cloth would give.
+    /// @param[in] _sleeping Whether to let settled tiles sleep (default is false).
+    void setSleeping(const bool &_sleeping)             {m_solver.m_allowSleeping = _sleeping;}
+
+    /// @brief Returns whether settled tiles may sleep.
+    bool isSleeping() const                             {return m_solver.m_allowSleeping;}
+
+    /// @brief Returns how many tiles of SLEEP_TILE_SIZE particles are currently asleep.
+    unsigned int getSleepingTileNum() const             {return m_solver.getSleepingTileNum();}
+
+    /// @brief Wakes every sleeping part of the cloth, since a new force or anchor isn't something a
+    /// sleeping tile notices. The setters that change the cloth's forces, constraints, step or
+    /// shape do this themselves, and ClothCommand::apply() does it for whatever else it changes.
+    void wakeAll()                                      {m_solver.wakeAll();}
 
     /// @brief Set the spring constant (stiffness) of all the springs in the cloth.
     /// @param[in] _constant The value to set the spring constant to.
-    void setSpringConstant(const float &_constant);
+    void setSpringConstant(const float &_constant)      {m_springs.m_springConstant = _constant; m_solver.wakeAll();}
 
     /// @brief Set the damping constant of all the springs in the cloth.
     /// @param[in] _constant The value to set the damping constant to.
-    void setDampingConstant(const float &_constant);
+    void setDampingConstant(const float &_constant)     {m_springs.m_dampingConstant = _constant; m_solver.wakeAll();}
 
     /// @brief Set the anchored state of the particle at a specified corner of the cloth.
     /// @param[in] _corner Which corner to set the state of:
@@ -132,6 +286,9 @@ public:
     void setAnchoredCorner(const unsigned int &_corner, const bool &_anchored);
 
 private:
+    /// @brief Saves and restores the whole of the cloth's state.
+    friend class ClothFile;
+
     //attributes
     /// @brief Whether the simulation is in suspended animation.
     bool m_isPaused;
@@ -142,15 +299,52 @@ private:
     /// @brief How many particles the cloth has along its Y axis.
     int m_heightNum;
 
-    /// @brief A vector containing all the particles in the cloth.
-    std::vector<CS::Particle> m_particles;
+    /// @brief The size of the blocks the particles are stored in; see getParticleIndex().
+    int m_blockSize;
+
+    /// @brief The width of the cloth at rest.
+    float m_width;
+
+    /// @brief The height of the cloth at rest.
+    float m_height;
 
-    /// @brief A vector containing all the springs that connect the cloth's particles.
-    std::vector<CS::Spring> m_springs;
+    /// @brief The structure-of-arrays store containing all the particles in the cloth.
+    CS::ParticleStore m_particles;
+
+    /// @brief The store containing all the springs that connect the cloth's particles.
+    CS::SpringStore m_springs;
 
     /// @brief An object that handles the particles' and springs' physics and movement.
     Solver m_solver;
 
+    /// @brief The length of each fixed timestep run by update().
+    float m_timestep;
+
+    /// @brief How many solver steps each fixed timestep is split into.
+    unsigned int m_substeps;
+
+    /// @brief The most fixed timesteps update() will run in one call.
+    unsigned int m_maxStepsPerUpdate;
+
+    /// @brief Real time that has been passed to update() but not simulated yet.
+    double m_accumulator;
+
+    /// @brief How much simulated time update() has run since the last reset.
+    double m_simTime;
+
+    /// @brief The particle positions before the latest fixed timestep, for interpolation.
+    std::vector<float> m_lastPosX, m_lastPosY, m_lastPosZ;
+
+    /// @brief The particle positions as they were when each one's tile last changed version.
+    std::vector<float> m_markedPosX, m_markedPosY, m_markedPosZ;
+
+    /// @brief The version each tile of particles last changed at; see updateTileVersions().
+    std::vector<uint32_t> m_tileVersions;
+
+    /// @brief The colour of each spring as generateSprings() makes them, before they are sorted by
+    /// it; empty when reset() found the springs in the TopologyCache.
+    std::vector<uint8_t> m_springColours;
+
     //functions
     /// @brief Calculates the vertex normal for the specified particle. This is now obsolete as we
     /// do this on the shader.
@@ -167,24 +361,44 @@ private:
     int clamp(const int &_x, const int &_min, const int &_max) {return std::min(_max, std::max(_min, _x));}
 
     /// @brief Returns the vector between two particles; used for readability and convenience.
-    /// @param[in] _p1 The first particle.
-    /// @param[in] _p2 The second particle.
-    ngl::Vec3 vectorBetween(CS::Particle _p1, CS::Particle _p2) const {return _p2.m_pos - _p1.m_pos;}
+    /// @param[in] _p1 The index of the first particle.
+    /// @param[in] _p2 The index of the second particle.
+    ngl::Vec3 vectorBetween(const unsigned int &_p1, const unsigned int &_p2) const {return m_particles.getPos(_p2) - m_particles.getPos(_p1);}
 
     /// @brief Constructs a spring between the particles at the specified positions and adds it to
-    /// our vector of springs.
+    /// our store of springs, using their current distance as its rest length.
     /// @param[in] _x1 The X index of the first particle.
     /// @param[in] _y1 The Y index of the first particle.
     /// @param[in] _x2 The X index of the second particle.
     /// @param[in] _y2 The Y index of the second particle.
-    /// @param[in] _springConstant The spring constant of the spring to be created.
-    /// @param[in] _springConstant The damping constant of the spring to be created.
-    void addSpring(const unsigned int &_x1, const unsigned int &_y1, const unsigned int &_x2, const unsigned int &_y2, const float &_springConstant, const float &_dampingConstant);
+    /// @param[in] _colour The spring's colour; generateSprings() gives springs that share a
+    /// particle different colours so that each colour can be solved in parallel.
+    void addSpring(const unsigned int &_x1, const unsigned int &_y1, const unsigned int &_x2, const unsigned int &_y2, const uint8_t &_colour);
+
+    /// @brief Connects the freshly laid out particles with every family of springs, then sorts
+    /// them by colour and builds their incidence table. reset() only needs this for a size the
+    /// TopologyCache doesn't already have.
+    void generateSprings();
 
-    /// @brief Returns a pointer to the particle at the specified position.
+    /// @brief Returns the index into the particle store of the particle at the specified position.
     /// @param[in] _x The X index of the particle.
     /// @param[in] _y The Y index of the particle.
-    CS::Particle* particleAt(const unsigned int &_x, const unsigned int &_y);
+    unsigned int particleAt(const unsigned int &_x, const unsigned int &_y) const;
+
+    /// @brief Returns where the particle at the specified position sits when the cloth is flat and
+    /// at rest, as laid out by reset().
+    /// @param[in] _x The X index of the particle.
+    /// @param[in] _y The Y index of the particle.
+    ngl::Vec3 getRestPos(const int &_x, const int &_y) const;
+
+    /// @brief Returns the radius reset() gives every particle, slightly less than the distance
+    /// between neighbouring particles at rest.
+    float getParticleRadius() const;
+
+    /// @brief Changes the dimensions of the cloth at rest without rebuilding it; see resize().
+    /// @param[in] _width The new width.
+    /// @param[in] _height The new height.
+    void setSize(const float &_width, const float &_height);
 
 };
 
@@ -0,0 +1,77 @@
+#ifndef CLOTHCOMMAND_H
+#define CLOTHCOMMAND_H
+
+#include "Cloth.h"
+
+/// @file ClothCommand.h
+/// @brief Source file for the ClothCommand struct describing one change to a Cloth.
+/// @author Robert Poncelet
+/// @version 1.0
+/// @date 16/10/26
+/// @class ClothCommand
+/// @brief A change to make to a cloth between two of its steps, such as the GUI's controls ask
+/// for. SimulationThread passes these to the cloth it owns, and Replay records and replays them,
+/// so everything that can change a running simulation goes through apply().
+
+struct ClothCommand
+{
+    /// @brief The kinds of change that can be made.
+    enum Type
+    {
+        RESET,
+        RESIZE,
+        TOGGLE_PAUSED,
+        TOGGLE_WIND,
+        SET_SPHERE_COLLISIONS,
+        SET_SELF_COLLISIONS,
+        SET_SPRING_CONSTANT,
+        SET_DAMPING_CONSTANT,
+        SET_GRAVITY,
+        SET_SIM_SPEED,
+        SET_SUBSTEPS,
+        SET_ANCHORED_CORNER,
+        SET_SPHERE_RADIUS,
+        SET_SPHERE_AXIS,
+        MOVE_SPHERE,
+        SET_SLEEPING
+    };
+
+    /// @brief Which change to make.
+    Type m_type;
+    /// @brief The new value for commands that set a float.
+    float m_value;
+    /// @brief The new value for SET_SUBSTEPS, the corner for SET_ANCHORED_CORNER or the axis
+    /// (0, 1 or 2 for X, Y or Z) for SET_SPHERE_AXIS.
+    int m_intValue;
+    /// @brief The new value for commands that set a bool.
+    bool m_flag;
+    /// @brief The offset for MOVE_SPHERE.
+    ngl::Vec3 m_vector;
+    /// @brief The construction info for RESET, or the new dimensions and resolution for RESIZE.
+    CS::ClothInfo m_info;
+
+    /// @brief A default constructor for the struct.
+    ClothCommand() : m_type(TOGGLE_PAUSED), m_value(0.0f), m_intValue(0), m_flag(false) {;}
+    /// @brief Constructor for commands with no value.
+    ClothCommand(const Type &_type) : m_type(_type), m_value(0.0f), m_intValue(0), m_flag(false) {;}
+    /// @brief Constructor for commands that set a float.
+    ClothCommand(const Type &_type, const float &_value) : m_type(_type), m_value(_value), m_intValue(0), m_flag(false) {;}
+    /// @brief Constructor for commands that set an int.
+    ClothCommand(const Type &_type, const int &_value) : m_type(_type), m_value(0.0f), m_intValue(_value), m_flag(false) {;}
+    /// @brief Constructor for commands that set a bool.
+    ClothCommand(const Type &_type, const bool &_flag) : m_type(_type), m_value(0.0f), m_intValue(0), m_flag(_flag) {;}
+    /// @brief Constructor for commands that set an indexed value, e.g. one corner or axis.
+    ClothCommand(const Type &_type, const int &_index, const float &_value, const bool &_flag) : m_type(_type), m_value(_value), m_intValue(_index), m_flag(_flag) {;}
+    /// @brief Constructor for MOVE_SPHERE.
+    ClothCommand(const Type &_type, const ngl::Vec3 &_vector) : m_type(_type), m_value(0.0f), m_intValue(0), m_flag(false), m_vector(_vector) {;}
+    /// @brief Constructor for RESET and RESIZE.
+    ClothCommand(const Type &_type, const CS::ClothInfo &_info) : m_type(_type), m_value(0.0f), m_intValue(0), m_flag(false), m_info(_info) {;}
+
+    /// @brief Makes the change to the specified cloth.
+    /// @param[in,out] _cloth The cloth to change.
+    /// @return Whether the cloth's particles were rebuilt, so anything drawing it needs its mesh
+    /// remaking.
+    bool apply(Cloth &_cloth) const;
+};
+
+#endif // CLOTHCOMMAND_H
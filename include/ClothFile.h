@@ -0,0 +1,43 @@
+#ifndef CLOTHFILE_H
+#define CLOTHFILE_H
+
+#include "Cloth.h"
+#include <string>
+
+/// @file ClothFile.h
+/// @brief Source file for the ClothFile class that saves and restores a Cloth's state.
+/// @author Robert Poncelet
+/// @version 1.0
+/// @date 16/10/26
+/// @class ClothFile
+/// @brief Saves everything needed to carry on simulating a Cloth to a compact binary file, and
+/// restores it again, so a batch run can start from an already-settled drape. A file is a fixed
+/// header (magic, format version, resolution, dimensions, counts, the Solver's settings, the
+/// cloth's clock and the sphere) followed by the raw particle arrays (positions, previous
+/// positions, forces, masses, radii and anchors), the springs with their rest lengths, where each
+/// spring colour starts, any per-spring scales and the implicit mode's warm start if it has one;
+/// every section starts on an 8-byte boundary. Values are stored in the machine's own byte order,
+/// so files are meant to be read back on the same kind of machine that wrote them. Saving streams
+/// each array straight to disk; loading maps the file into memory and copies the arrays out of it.
+/// Every mode carries on exactly as if the run had never stopped. Scratch data the solver rebuilds
+/// every step is not saved, and neither is which tiles are asleep; whether they may sleep is, but
+/// a loaded cloth starts with every tile awake.
+
+class ClothFile
+{
+public:
+    /// @brief Writes the state of the specified cloth to a file, replacing it if it exists.
+    /// @param[in] _cloth The cloth to save.
+    /// @param[in] _path Where to write the file.
+    /// @return Whether the file was written successfully.
+    static bool save(const Cloth &_cloth, const std::string &_path);
+
+    /// @brief Replaces the state of the specified cloth with the one saved in a file. The cloth is
+    /// left untouched if the file can't be read or isn't a valid cloth file of this version.
+    /// @param[out] _cloth The cloth to restore into.
+    /// @param[in] _path The file to read.
+    /// @return Whether the cloth was restored.
+    static bool load(Cloth &_cloth, const std::string &_path);
+};
+
+#endif // CLOTHFILE_H
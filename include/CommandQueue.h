@@ -0,0 +1,75 @@
+#ifndef COMMANDQUEUE_H
+#define COMMANDQUEUE_H
+
+#include <atomic>
+
+/// @file CommandQueue.h
+/// @brief Source file for the CommandQueue class template used to pass commands between threads.
+/// @author Robert Poncelet
+/// @version 1.0
+/// @date 16/10/26
+/// @class CommandQueue
+/// @brief A fixed-size, lock-free queue for exactly one producer thread and one consumer thread.
+/// Neither side ever blocks: push() fails if the queue is full and pop() fails if it is empty.
+/// The two ends live on separate cache lines so the threads don't fight over them.
+/// @tparam T The type of item queued; must be default constructible and copyable.
+/// @tparam CAPACITY How many slots the queue has; it holds at most CAPACITY - 1 items.
+
+template <typename T, unsigned int CAPACITY>
+class CommandQueue
+{
+public:
+    /// @brief Constructor for the CommandQueue class; the queue starts empty.
+    CommandQueue() : m_head(0), m_tail(0) {;}
+
+    /// @brief Adds an item to the back of the queue. Only call this from the producer thread.
+    /// @param[in] _item The item to add.
+    /// @return Whether there was room for the item.
+    bool push(const T &_item)
+    {
+        const unsigned int tail = m_tail.load(std::memory_order_relaxed);
+        const unsigned int next = (tail + 1) % CAPACITY;
+        if (next == m_head.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        m_items[tail] = _item;
+        //publish the item only once it has been written
+        m_tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    /// @brief Removes the item at the front of the queue. Only call this from the consumer thread.
+    /// @param[out] _item Set to the item removed.
+    /// @return Whether there was an item to remove.
+    bool pop(T &_item)
+    {
+        const unsigned int head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        _item = m_items[head];
+        //hand the slot back only once the item has been read out of it
+        m_head.store((head + 1) % CAPACITY, std::memory_order_release);
+        return true;
+    }
+
+private:
+    /// @brief Not copyable.
+    CommandQueue(const CommandQueue &);
+
+    /// @brief Not assignable.
+    CommandQueue& operator=(const CommandQueue &);
+
+    /// @brief The slots holding the queued items.
+    T m_items[CAPACITY];
+    /// @brief The slot of the next item to pop; only written by the consumer.
+    alignas(64) std::atomic<unsigned int> m_head;
+    /// @brief The slot the next item will be pushed into; only written by the producer.
+    alignas(64) std::atomic<unsigned int> m_tail;
+};
+
+#endif // COMMANDQUEUE_H
@@ -3,6 +3,8 @@
 
 #include "ngl/Vec2.h"
 #include "ngl/Vec3.h"
+#include <algorithm>
+#include <stdint.h>
 #include <vector>
 
 /// @file Common.h
@@ -38,9 +40,13 @@ namespace CS
         float dampingConstant;
         /// @brief The radius of the collision-demo sphere.
         float sphereRadius;
+        /// @brief The particles are stored in square blocks this many particles across, so that
+        /// neighbours above and below a particle are close to it in memory as well as those either
+        /// side; 1 stores them row by row.
+        int blockSize;
 
         /// @brief A default constructor for the struct.
-        ClothInfo():widthNum(), heightNum(),width(),height(),springConstant(),dampingConstant(),sphereRadius()
+        ClothInfo():anchoredTopLeft(),anchoredTopRight(),anchoredBottomLeft(),anchoredBottomRight(),widthNum(), heightNum(),width(),height(),springConstant(),dampingConstant(),sphereRadius(),blockSize(1)
         {;}
     };
 
@@ -58,7 +64,8 @@ namespace CS
     Vert;
 
     /// @brief A structure containing all the attributes of a particle; this is used instead of a
-    /// class so its members can be accessed by a memory address and an offset.
+    /// class so its members can be accessed by a memory address and an offset. The cloth itself now
+    /// stores its particles in a ParticleStore; this is still used for the collision sphere.
     struct Particle
     {
         /// @brief Whether this particle is "anchored", i.e. the cloth will hang from this point.
@@ -108,53 +115,329 @@ namespace CS
         {;}
     };
 
-    /// @brief A struct containing all the attributes of a spring; these connect the particles to form
-    /// the cloth surface and apply forces to them depending on their length.
-    struct Spring
+    /// @brief Structure-of-arrays storage for the cloth's particles. Each attribute lives in its own
+    /// tightly-packed array, so a pass that only needs e.g. positions doesn't drag the rest of the
+    /// particle through the cache with it. A particle is referred to by its index into the arrays.
+    struct ParticleStore
     {
-        /// @brief Returns the "restoring force" the spring exerts on its endpoints according to Hooke's
-        /// law, its length and its internal constants.
-        ngl::Vec3 getSpringForce() const
+        /// @brief The X components of the world-space particle positions.
+        std::vector<float> m_posX;
+        /// @brief The Y components of the world-space particle positions.
+        std::vector<float> m_posY;
+        /// @brief The Z components of the world-space particle positions.
+        std::vector<float> m_posZ;
+        /// @brief The X components of the positions at the previous simulation frame. Verlet
+        /// integration uses these rather than a velocity vector.
+        std::vector<float> m_prevPosX;
+        /// @brief The Y components of the positions at the previous simulation frame.
+        std::vector<float> m_prevPosY;
+        /// @brief The Z components of the positions at the previous simulation frame.
+        std::vector<float> m_prevPosZ;
+        /// @brief The X components of the forces accumulated during one simulation step.
+        std::vector<float> m_forceX;
+        /// @brief The Y components of the forces accumulated during one simulation step.
+        std::vector<float> m_forceY;
+        /// @brief The Z components of the forces accumulated during one simulation step.
+        std::vector<float> m_forceZ;
+        /// @brief The mass of each particle.
+        std::vector<float> m_mass;
+        /// @brief The radius of each particle, used for spherical collisions.
+        std::vector<float> m_radius;
+        /// @brief Whether each particle is "anchored" (non-zero), i.e. the cloth will hang from it.
+        std::vector<unsigned char> m_isAnchored;
+
+        /// @brief Returns how many particles are stored.
+        unsigned int size() const                                               {return (unsigned int)m_mass.size();}
+        /// @brief Returns whether there are no particles stored.
+        bool empty() const                                                      {return m_mass.empty();}
+
+        /// @brief Returns the position of the particle at the specified index.
+        ngl::Vec3 getPos(const unsigned int &_i) const                          {return ngl::Vec3(m_posX[_i],m_posY[_i],m_posZ[_i]);}
+        /// @brief Returns the previous position of the particle at the specified index.
+        ngl::Vec3 getPrevPos(const unsigned int &_i) const                      {return ngl::Vec3(m_prevPosX[_i],m_prevPosY[_i],m_prevPosZ[_i]);}
+        /// @brief Returns the accumulated force of the particle at the specified index.
+        ngl::Vec3 getForce(const unsigned int &_i) const                        {return ngl::Vec3(m_forceX[_i],m_forceY[_i],m_forceZ[_i]);}
+        /// @brief Sets the position of the particle at the specified index.
+        void setPos(const unsigned int &_i, const ngl::Vec3 &_pos)              {m_posX[_i]=_pos.m_x; m_posY[_i]=_pos.m_y; m_posZ[_i]=_pos.m_z;}
+        /// @brief Sets the previous position of the particle at the specified index.
+        void setPrevPos(const unsigned int &_i, const ngl::Vec3 &_pos)          {m_prevPosX[_i]=_pos.m_x; m_prevPosY[_i]=_pos.m_y; m_prevPosZ[_i]=_pos.m_z;}
+
+        /// @brief Returns the acceleration of the particle at the specified index. This is used in
+        /// Verlet integration.
+        ngl::Vec3 getAcceleration(const unsigned int &_i) const                 {return m_isAnchored[_i] ? ngl::Vec3(0.0f,0.0f,0.0f) : -getForce(_i)/m_mass[_i];}
+        /// @brief Add to the pending force of the particle at the specified index, which will be
+        /// applied to the particle and cleared once all springs have been updated.
+        void addForce(const unsigned int &_i, const ngl::Vec3 &_force)          {m_forceX[_i]+=_force.m_x; m_forceY[_i]+=_force.m_y; m_forceZ[_i]+=_force.m_z;}
+        /// @brief Apply a relative translation to the particle at the specified index, skipping the
+        /// force step.
+        void move(const unsigned int &_i, const ngl::Vec3 &_pos)                {m_posX[_i]+=_pos.m_x; m_posY[_i]+=_pos.m_y; m_posZ[_i]+=_pos.m_z;}
+        /// @brief Sets the pending force of the particle at the specified index to zero.
+        void resetForce(const unsigned int &_i)                                 {m_forceX[_i]=0.0f; m_forceY[_i]=0.0f; m_forceZ[_i]=0.0f;}
+
+        /// @brief Removes all the particles.
+        void clear()
         {
-            //do Hooke's law stuff here
-            float extension = (getLength()-getRestLength());
-            return -m_springConstant*extension*getSpringVector(); //-kx as a vector
+            m_posX.clear();     m_posY.clear();     m_posZ.clear();
+            m_prevPosX.clear(); m_prevPosY.clear(); m_prevPosZ.clear();
+            m_forceX.clear();   m_forceY.clear();   m_forceZ.clear();
+            m_mass.clear();     m_radius.clear();   m_isAnchored.clear();
         }
 
+        /// @brief Reserves space for the specified number of particles in every array.
+        void reserve(const unsigned int &_num)
+        {
+            m_posX.reserve(_num);     m_posY.reserve(_num);     m_posZ.reserve(_num);
+            m_prevPosX.reserve(_num); m_prevPosY.reserve(_num); m_prevPosZ.reserve(_num);
+            m_forceX.reserve(_num);   m_forceY.reserve(_num);   m_forceZ.reserve(_num);
+            m_mass.reserve(_num);     m_radius.reserve(_num);   m_isAnchored.reserve(_num);
+        }
+
+        /// @brief Appends a new, unanchored particle at rest.
+        /// @param[in] _mass The mass of the particle.
+        /// @param[in] _radius The particle's radius, used for spherical collisions.
+        /// @param[in] _pos The world-space position of the particle.
+        void addParticle(const float &_mass, const float &_radius, const ngl::Vec3 &_pos)
+        {
+            m_posX.push_back(_pos.m_x); m_posY.push_back(_pos.m_y); m_posZ.push_back(_pos.m_z);
+            m_prevPosX.push_back(0.0f); m_prevPosY.push_back(0.0f); m_prevPosZ.push_back(0.0f);
+            m_forceX.push_back(0.0f);   m_forceY.push_back(0.0f);   m_forceZ.push_back(0.0f);
+            m_mass.push_back(_mass);
+            m_radius.push_back(_radius);
+            m_isAnchored.push_back(0);
+        }
+    };
+
+    /// @brief The compact per-spring data the solver needs every step: the indices of the two
+    /// particles a spring connects and the length it "tries" to maintain. Springs refer to particles
+    /// by index rather than pointer, so the particle store can be reallocated, copied or written to
+    /// disk without invalidating them.
+    struct Spring
+    {
         /// @brief Returns the vector between the spring's start and end particles.
-        ngl::Vec3 getSpringVector() const
+        /// @param[in] _particles The particles the spring's indices refer to.
+        ngl::Vec3 getSpringVector(const ParticleStore &_particles) const
         {
-            return ngl::Vec3(m_endParticle->m_pos - m_startParticle->m_pos);
+            return ngl::Vec3(_particles.getPos(m_endParticle) - _particles.getPos(m_startParticle));
+        }
+
+        /// @brief Returns the "restoring force" the spring exerts on its endpoints according to Hooke's
+        /// law, its length and the specified spring constant.
+        /// @param[in] _springVector The vector between the spring's start and end particles.
+        /// @param[in] _springConstant The spring (stiffness) constant to use.
+        ngl::Vec3 getSpringForce(const ngl::Vec3 &_springVector, const float &_springConstant) const
+        {
+            //do Hooke's law stuff here
+            float extension = (_springVector.length()-getRestLength());
+            return -_springConstant*extension*_springVector; //-kx as a vector
         }
 
         /// @brief returns the rest length.
         float getRestLength() const {return m_restLength;}
 
         /// @brief returns the current length.
-        float getLength() const {return getSpringVector().length();}
+        /// @param[in] _particles The particles the spring's indices refer to.
+        float getLength(const ParticleStore &_particles) const {return getSpringVector(_particles).length();}
 
-        /// @brief The first particle this spring connects.
-        Particle* m_startParticle;
-        /// @brief The second particle this spring connects.
-        Particle* m_endParticle;
-        /// @brief The spring (stiffness) constant of the spring.
-        float m_springConstant;
-        /// @brief The damping constant of the spring i.e. how quickly it will come to rest.
-        float m_dampingConstant;
+        /// @brief The index of the first particle this spring connects.
+        uint32_t m_startParticle;
+        /// @brief The index of the second particle this spring connects.
+        uint32_t m_endParticle;
         /// @brief The default length the spring "tries" to maintain with its forces.
         float m_restLength;
 
-        /// @brief The constructor for the Spring class.
-        /// @param _startParticle The first particle to connect.
-        /// @param _endParticle The second particle to connect.
-        /// @param _springConstant The spring (stiffness) constant of the spring.
-        /// @param _dampingConstant The damping constant of the spring i.e. how quickly it will come to
-        /// rest.
-        Spring(Particle* _startParticle, Particle* _endParticle, const float &_springConstant, const float &_dampingConstant):  m_startParticle(_startParticle),
-                                                                                                                                m_endParticle(_endParticle),
-                                                                                                                                m_springConstant(_springConstant),
-                                                                                                                                m_dampingConstant(_dampingConstant),
-                                                                                                                                m_restLength(getLength())
+        /// @brief The constructor for the Spring struct.
+        /// @param _startParticle The index of the first particle to connect.
+        /// @param _endParticle The index of the second particle to connect.
+        /// @param _restLength The length the spring should try to maintain.
+        Spring(const uint32_t &_startParticle, const uint32_t &_endParticle, const float &_restLength):  m_startParticle(_startParticle),
+                                                                                                         m_endParticle(_endParticle),
+                                                                                                         m_restLength(_restLength)
+        {;}
+    };
+
+    /// @brief Storage for all of a cloth's springs. The topology and rest lengths are kept in one
+    /// tightly-packed array of Spring structs; the spring and damping constants are shared by every
+    /// spring, so changing them is a single store however big the cloth is, but each spring can
+    /// optionally scale them by its own factors kept in parallel arrays.
+    struct SpringStore
+    {
+        /// @brief The connectivity and rest length of each spring.
+        std::vector<Spring> m_springs;
+        /// @brief Optional per-spring factors m_springConstant is multiplied by. When this is empty
+        /// every spring uses m_springConstant as it is.
+        std::vector<float> m_springScales;
+        /// @brief Optional per-spring factors m_dampingConstant is multiplied by. When this is empty
+        /// every spring uses m_dampingConstant as it is.
+        std::vector<float> m_dampingScales;
+        /// @brief The spring (stiffness) constant shared by all the springs.
+        float m_springConstant;
+        /// @brief The damping constant shared by all the springs i.e. how quickly they come to rest.
+        float m_dampingConstant;
+        /// @brief For each particle, where its entries in m_incidentSprings begin; the extra last entry
+        /// is the total, so particle p's springs are [m_incidentOffsets[p], m_incidentOffsets[p+1]).
+        /// Empty until buildIncidence() is called, and cleared whenever the springs change.
+        std::vector<uint32_t> m_incidentOffsets;
+        /// @brief The springs attached to each particle in ascending order, encoded as
+        /// (spring index << 1) | 1 if the particle is the spring's end, or | 0 if it is the start.
+        std::vector<uint32_t> m_incidentSprings;
+        /// @brief Where each colour's springs begin once sortByColour() has been called, plus the
+        /// total at the end; no two springs of the same colour share a particle. Empty otherwise,
+        /// and cleared whenever the springs change.
+        std::vector<uint32_t> m_colourOffsets;
+
+        /// @brief Returns how many springs are stored.
+        unsigned int size() const                                       {return (unsigned int)m_springs.size();}
+        /// @brief Returns whether there are no springs stored.
+        bool empty() const                                              {return m_springs.empty();}
+        /// @brief Returns the spring at the specified index.
+        Spring& operator[](const unsigned int &_i)                      {return m_springs[_i];}
+        /// @brief Returns the spring at the specified index.
+        const Spring& operator[](const unsigned int &_i) const          {return m_springs[_i];}
+
+        /// @brief Returns whether the springs scale the shared constants by their own factors.
+        bool hasPerSpringScales() const                                 {return !m_springScales.empty();}
+        /// @brief Returns the spring (stiffness) constant of the spring at the specified index.
+        float getSpringConstant(const unsigned int &_i) const           {return m_springScales.empty() ? m_springConstant : m_springConstant * m_springScales[_i];}
+        /// @brief Returns the damping constant of the spring at the specified index.
+        float getDampingConstant(const unsigned int &_i) const          {return m_dampingScales.empty() ? m_dampingConstant : m_dampingConstant * m_dampingScales[_i];}
+
+        /// @brief Returns whether the particle-to-spring table is up to date for the specified
+        /// number of particles.
+        bool hasIncidence(const unsigned int &_particleNum) const       {return m_incidentOffsets.size() == _particleNum + 1;}
+
+        /// @brief Returns whether the springs have been sorted into colours.
+        bool hasColours() const                                         {return !m_colourOffsets.empty();}
+        /// @brief Returns how many colours the springs have been sorted into.
+        unsigned int getColourNum() const                               {return m_colourOffsets.empty() ? 0 : (unsigned int)m_colourOffsets.size() - 1;}
+
+        /// @brief Removes all the springs, leaving the shared constants as they are.
+        void clear()
+        {
+            m_springs.clear();
+            m_springScales.clear();
+            m_dampingScales.clear();
+            m_incidentOffsets.clear();
+            m_incidentSprings.clear();
+            m_colourOffsets.clear();
+        }
+
+        /// @brief Builds the table of which springs are attached to each particle. This lets a
+        /// particle gather its spring forces itself rather than having springs scatter into it.
+        /// @param[in] _particleNum How many particles the springs' indices refer to.
+        void buildIncidence(const unsigned int &_particleNum)
+        {
+            m_incidentOffsets.assign(_particleNum + 1, 0);
+            for (unsigned int i = 0; i < m_springs.size(); ++i)
+            {
+                ++m_incidentOffsets[m_springs[i].m_startParticle + 1];
+                ++m_incidentOffsets[m_springs[i].m_endParticle + 1];
+            }
+            for (unsigned int p = 0; p < _particleNum; ++p)
+            {
+                m_incidentOffsets[p + 1] += m_incidentOffsets[p];
+            }
+
+            //filling in spring order keeps each particle's list ascending
+            std::vector<uint32_t> fill(m_incidentOffsets.begin(), m_incidentOffsets.end() - 1);
+            m_incidentSprings.resize(m_incidentOffsets[_particleNum]);
+            for (unsigned int i = 0; i < m_springs.size(); ++i)
+            {
+                m_incidentSprings[fill[m_springs[i].m_startParticle]++] = i << 1;
+                m_incidentSprings[fill[m_springs[i].m_endParticle]++] = (i << 1) | 1;
+            }
+        }
+
+        /// @brief Reorders the springs so that each colour's springs are contiguous, and within a
+        /// colour in order of their start particles so that they work through memory in the same
+        /// order the particles are stored in, and records where each colour begins. The caller is responsible
+        /// for the colouring being valid, i.e. no two springs of a colour sharing a particle, which
+        /// lets each colour's springs be worked on in parallel. Invalidates the incidence table.
+        /// @param[in] _colours The colour of each spring, in the current order.
+        void sortByColour(const std::vector<uint8_t> &_colours)
+        {
+            unsigned int colourNum = 0;
+            for (unsigned int i = 0; i < _colours.size(); ++i)
+            {
+                colourNum = std::max(colourNum, (unsigned int)_colours[i] + 1);
+            }
+
+            m_colourOffsets.assign(colourNum + 1, 0);
+            for (unsigned int i = 0; i < m_springs.size(); ++i)
+            {
+                ++m_colourOffsets[_colours[i] + 1];
+            }
+            for (unsigned int c = 0; c < colourNum; ++c)
+            {
+                m_colourOffsets[c + 1] += m_colourOffsets[c];
+            }
+
+            //visit the springs by start particle; distributing them into colours in that order
+            //keeps it within each colour
+            std::vector<uint32_t> order(m_springs.size());
+            for (unsigned int i = 0; i < order.size(); ++i)
+            {
+                order[i] = i;
+            }
+            std::stable_sort(order.begin(), order.end(), [this](const uint32_t &_a, const uint32_t &_b)
+            {
+                return m_springs[_a].m_startParticle < m_springs[_b].m_startParticle;
+            });
+
+            std::vector<uint32_t> fill(m_colourOffsets.begin(), m_colourOffsets.end() - 1);
+            std::vector<Spring> springs(m_springs);
+            std::vector<float> springScales(m_springScales);
+            std::vector<float> dampingScales(m_dampingScales);
+            for (unsigned int k = 0; k < order.size(); ++k)
+            {
+                const uint32_t i = order[k];
+                const uint32_t to = fill[_colours[i]]++;
+                m_springs[to] = springs[i];
+                if (hasPerSpringScales())
+                {
+                    m_springScales[to] = springScales[i];
+                    m_dampingScales[to] = dampingScales[i];
+                }
+            }
+            m_incidentOffsets.clear();
+        }
+
+        /// @brief Reserves space for the specified number of springs.
+        /// @param[in] _num The number of springs to make room for.
+        void reserve(const unsigned int &_num)
+        {
+            m_springs.reserve(_num);
+        }
+
+        /// @brief Appends a spring that uses the shared constants as they are.
+        /// @param[in] _startParticle The index of the first particle to connect.
+        /// @param[in] _endParticle The index of the second particle to connect.
+        /// @param[in] _restLength The length the spring should try to maintain.
+        void addSpring(const uint32_t &_startParticle, const uint32_t &_endParticle, const float &_restLength)
+        {
+            m_springs.push_back(Spring(_startParticle, _endParticle, _restLength));
+            m_incidentOffsets.clear();
+            m_colourOffsets.clear();
+            if (hasPerSpringScales())
+            {
+                m_springScales.push_back(1.0f);
+                m_dampingScales.push_back(1.0f);
+            }
+        }
+
+        /// @brief Gives every spring its own factors for the shared constants, all starting at one,
+        /// so that springs can be made stiffer or softer than the rest individually. Does nothing if
+        /// this has already been done.
+        void makeScalesPerSpring()
+        {
+            if (!hasPerSpringScales())
+            {
+                m_springScales.assign(m_springs.size(), 1.0f);
+                m_dampingScales.assign(m_springs.size(), 1.0f);
+            }
+        }
+
+        /// @brief The default constructor for the struct.
+        SpringStore():m_springConstant(),m_dampingConstant()
         {;}
     };
 }
@@ -0,0 +1,109 @@
+#ifndef FRAMEARENA_H
+#define FRAMEARENA_H
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+/// @file FrameArena.h
+/// @brief Source file for the FrameArena class, which hands out the buffers a step or a frame only
+/// needs until it is over.
+/// @author Robert Poncelet
+/// @version 1.0
+/// @date 16/10/26
+/// @class FrameArena
+/// @brief A bump allocator for scratch buffers: allocate() takes the next aligned piece of a block
+/// it already owns, and reset() at the start of the next step or frame gives every piece back at
+/// once. Nothing is freed individually and nothing is constructed or destroyed, so only trivially
+/// destructible types can be allocated, and what is handed out starts uninitialised. A frame that
+/// needs more than the block holds takes another block from the heap, and the next reset() swaps
+/// them all for a single block big enough for the lot, so once the largest frame has been seen
+/// the heap isn't touched again. It isn't thread safe; whoever owns it has to make sure only one
+/// thread allocates at a time, and that nobody is still using a buffer when it is reset.
+
+class FrameArena
+{
+public:
+    /// @brief Constructor for the FrameArena class; nothing is allocated until it is needed.
+    FrameArena();
+
+    /// @brief Destructor for the FrameArena class.
+    ~FrameArena();
+
+    /// @brief Returns space for the specified number of T, aligned to a cache line, valid until the
+    /// next reset(); the contents are whatever was there before.
+    /// @param[in] _count How many T are needed; zero gives a null pointer.
+    template <typename T>
+    T* allocate(const size_t &_count)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "the arena never destroys what it holds");
+        return static_cast<T*>(allocateBytes(_count * sizeof(T)));
+    }
+
+    /// @brief Gives back everything allocated since the last reset, merging any extra blocks the
+    /// frame needed into one.
+    void reset();
+
+    /// @brief Returns how many allocations have been made since the last reset.
+    unsigned int getAllocationCount() const     {return m_allocations;}
+
+    /// @brief Returns how many allocations have been made over the arena's lifetime.
+    unsigned long long getTotalAllocationCount() const {return m_totalAllocations;}
+
+    /// @brief Returns how many blocks the arena has had to take from the heap over its lifetime;
+    /// this should stop going up once the arena has seen its largest frame.
+    unsigned int getHeapAllocationCount() const {return m_heapAllocations;}
+
+    /// @brief Returns how many bytes have been handed out since the last reset, padding included.
+    size_t getUsedBytes() const                 {return m_used;}
+
+    /// @brief Returns the most bytes any one frame has needed.
+    size_t getPeakBytes() const                 {return m_peak;}
+
+    /// @brief Returns how many bytes the arena's blocks hold between them.
+    size_t getCapacity() const;
+
+private:
+    /// @brief The arena can't be copied; its buffers would be shared.
+    FrameArena(const FrameArena &);
+    FrameArena& operator=(const FrameArena &);
+
+    /// @brief A piece of memory from the heap, handed out from its start onwards.
+    struct Block
+    {
+        /// @brief What was allocated, which may start before the first aligned byte.
+        char *m_memory;
+        /// @brief The first aligned byte.
+        char *m_begin;
+        /// @brief How many bytes there are from m_begin.
+        size_t m_size;
+    };
+
+    /// @brief Returns the specified number of bytes, starting on a cache line.
+    /// @param[in] _bytes How many bytes are needed.
+    void* allocateBytes(const size_t &_bytes);
+
+    /// @brief Takes a new block of at least the specified size from the heap and makes it current.
+    /// @param[in] _bytes How many bytes the block must hold.
+    void addBlock(const size_t &_bytes);
+
+    /// @brief Returns every block to the heap.
+    void freeBlocks();
+
+    /// @brief The blocks in the order they were taken; only the last one is handed out from.
+    std::vector<Block> m_blocks;
+    /// @brief How far into the last block has been handed out.
+    size_t m_offset;
+    /// @brief How many bytes have been handed out since the last reset, across every block.
+    size_t m_used;
+    /// @brief The most m_used has reached in any frame.
+    size_t m_peak;
+    /// @brief How many allocations have been made since the last reset.
+    unsigned int m_allocations;
+    /// @brief How many allocations have been made in total.
+    unsigned long long m_totalAllocations;
+    /// @brief How many blocks have been taken from the heap in total.
+    unsigned int m_heapAllocations;
+};
+
+#endif // FRAMEARENA_H
@@ -9,7 +9,12 @@
 #include <QTimer>
 #include <QResizeEvent>
 #include <QGLWidget>
-#include "Cloth.h"
+#include <chrono>
+#include "FrameArena.h"
+#include "PointCacheReader.h"
+#include "PointCacheWriter.h"
+#include "SimulationThread.h"
+#include "UploadRing.h"
 
 /// @file GLWindow.h
 /// @brief a basic Qt GL window class for ngl demos
@@ -80,6 +85,9 @@ public :
     /// @brief Set whether collisions between cloth particles and the sphere should be used.
     /// @param[in] _shouldUse The value to set.
     void setSphereCollisions(bool _shouldUse);
+    /// @brief Set whether settled parts of the cloth may sleep until something disturbs them.
+    /// @param[in] _sleeping The value to set.
+    void setSleeping(bool _sleeping);
     /// @brief Set the height of the cloth geometry.
     /// @param[in] _height The value to set.
     void setClothHeight(double _height);
@@ -116,6 +124,9 @@ public :
     /// @brief Set the speed of the cloth simulation.
     /// @param[in] _speed The value to set.
     void setSimSpeed(double _speed);
+    /// @brief Set how many solver steps each of the cloth's fixed timesteps is split into.
+    /// @param[in] _substeps The value to set.
+    void setSubsteps(int _substeps);
     /// @brief Call reset() on the cloth.
     void reset();
 
@@ -132,6 +143,30 @@ public :
     /// @param[in] _anchor The value to set.
     void setAnchoredTopRight(bool _anchor);
 
+    /// @brief Start writing each step picked up from the simulation thread to a point cache,
+    /// stopping any recording already going.
+    /// @param[in] _path The file to write.
+    /// @return Whether the file could be created.
+    bool startRecording(const std::string &_path);
+    /// @brief Finish the point cache being recorded, if there is one.
+    /// @return Whether all of it made it to disk.
+    bool stopRecording();
+    /// @brief Draw a point cache instead of the simulation, looping it in real time; the
+    /// simulation carries on underneath.
+    /// @param[in] _path The file to play.
+    /// @return Whether the file could be read and has any frames.
+    bool startPlayback(const std::string &_path);
+    /// @brief Go back to drawing the simulation.
+    void stopPlayback();
+    /// @brief Start logging every change made to the cloth, and the state it reaches, to a Replay
+    /// that cloth_headless --replay can check later, finishing any replay already being recorded.
+    /// @param[in] _path The file to write.
+    /// @return Whether the recording could be started.
+    bool startReplayRecording(const std::string &_path);
+    /// @brief Finish the replay being recorded, if there is one.
+    /// @return Whether all of it made it to disk.
+    bool stopReplayRecording();
+
     signals:
 //    /// @brief Change both the view X rotation and the X rotation spinbox in the UI
 //    /// @param[in] _x The value to set.
@@ -192,6 +227,10 @@ private :
 
     void resetCloth();
 
+    /// @brief Passes the dimensions and resolution in m_clothInfo on to the cloth without
+    /// starting it again.
+    void resizeCloth();
+
 protected:
 
   /// @brief  The following methods must be implimented in the sub class
@@ -213,13 +252,61 @@ protected:
     ngl::Transformation m_sphereTransform;
 
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief Our cloth object.
+    /// @brief Runs our cloth object on its own thread; we only see it through the snapshots it
+    /// publishes and only change it by posting commands.
+    //----------------------------------------------------------------------------------------------------------------------
+    SimulationThread m_simulation;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief How many particles the mesh currently being drawn has along its X axis; this lags
+    /// behind m_clothInfo until the simulation thread has acted on a reset.
+    //----------------------------------------------------------------------------------------------------------------------
+    int m_drawWidthNum;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief How many particles the mesh currently being drawn has along its Y axis.
+    //----------------------------------------------------------------------------------------------------------------------
+    int m_drawHeightNum;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief The size of the blocks the particles of the mesh currently being drawn are stored in.
+    //----------------------------------------------------------------------------------------------------------------------
+    int m_drawBlockSize;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief The reset count of the snapshot the mesh was built from, so we know when to rebuild it.
+    //----------------------------------------------------------------------------------------------------------------------
+    unsigned int m_drawGeneration;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief Set when the mesh has to be rebuilt before the next draw whatever the snapshot says,
+    /// i.e. when switching between playback and the simulation.
+    //----------------------------------------------------------------------------------------------------------------------
+    bool m_rebuildMesh;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief Records the snapshots we draw to a point cache while it is open.
     //----------------------------------------------------------------------------------------------------------------------
-    Cloth m_cloth;
+    PointCacheWriter m_recorder;
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief The time since the simulation began; pretty much just used for the cloth's wind function.
+    /// @brief The point cache being played back instead of the simulation, if it is open.
     //----------------------------------------------------------------------------------------------------------------------
-    double m_time;
+    PointCacheReader m_player;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief The positions of the frame being played back, laid out as in a snapshot.
+    //----------------------------------------------------------------------------------------------------------------------
+    std::vector<GLfloat> m_playbackPoints;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief When playback started, which the cache's frame times are measured from.
+    //----------------------------------------------------------------------------------------------------------------------
+    std::chrono::steady_clock::time_point m_playbackStart;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief The frame in m_playbackPoints, or -1 if none.
+    //----------------------------------------------------------------------------------------------------------------------
+    int m_playbackFrame;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief Reads whichever frame of the point cache is due now into m_playbackPoints.
+    /// @return Whether it is a different frame from last time.
+    //----------------------------------------------------------------------------------------------------------------------
+    bool advancePlayback();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief Returns the positions to draw: the frame being played back, or the latest snapshot.
+    //----------------------------------------------------------------------------------------------------------------------
+    const std::vector<GLfloat>& getDrawPoints() const;
     //----------------------------------------------------------------------------------------------------------------------
     /// @brief mesh data
     //----------------------------------------------------------------------------------------------------------------------
@@ -230,7 +317,10 @@ protected:
     //----------------------------------------------------------------------------------------------------------------------
     void createTextures();
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief Update the position texture with the new values loaded from the Cloth object.
+    /// @brief Update the position texture with the new values loaded from the Cloth object, which
+    /// are written straight into the next slot of m_positionRing. Only the tiles of particles that
+    /// have changed since the slot was last written are sent, unless there are so many that one
+    /// copy of the lot is cheaper.
     //----------------------------------------------------------------------------------------------------------------------
     void updatePositionTexture();
     //----------------------------------------------------------------------------------------------------------------------
@@ -238,13 +328,21 @@ protected:
     //----------------------------------------------------------------------------------------------------------------------
     GLuint m_clothTexture;
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief Handle of the OpenGL buffer storing the particle positions.
+    /// @brief The triple-buffered, mapped buffers storing the particle positions as packed by
+    /// PackedPoints, and the textures the shaders read them through; this is the only copy of the
+    /// positions the GPU gets.
+    //----------------------------------------------------------------------------------------------------------------------
+    UploadRing m_positionRing;
     //----------------------------------------------------------------------------------------------------------------------
-    GLuint m_posBuffer;
+    /// @brief The version of the snapshot each slot of m_positionRing holds, or 0 if it holds
+    /// anything else, so updatePositionTexture() knows which tiles are out of date in it.
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief Handle of the OpenGL texture that stores the data from the position buffer.
+    uint32_t m_slotVersions[UPLOAD_RING_SLOTS];
     //----------------------------------------------------------------------------------------------------------------------
-    GLuint m_posBufferTexture;
+    /// @brief Where buffers that are only needed until they have been handed to OpenGL come from;
+    /// reset at the start of every paintGL().
+    //----------------------------------------------------------------------------------------------------------------------
+    FrameArena m_frameArena;
     //----------------------------------------------------------------------------------------------------------------------
     /// @brief Handle of the OpenGL framebuffer we (should) write the normals to.
     //----------------------------------------------------------------------------------------------------------------------
@@ -262,13 +360,9 @@ protected:
     //----------------------------------------------------------------------------------------------------------------------
     void renderNormals();
     //----------------------------------------------------------------------------------------------------------------------
-    ///@brief create our mesh
+    ///@brief create our mesh from the latest snapshot, or from the point cache being played back
     //----------------------------------------------------------------------------------------------------------------------
     void createVAO();
-    //----------------------------------------------------------------------------------------------------------------------
-    ///@brief Update the mesh with the new vertex positions.
-    //----------------------------------------------------------------------------------------------------------------------
-    void updateVAO();
 
 protected:
     /// Overloaded function to handle keyboard input
@@ -0,0 +1,57 @@
+#ifndef INTEGRATOR_H
+#define INTEGRATOR_H
+
+#include "Common.h"
+
+/// @file Integrator.h
+/// @brief Source file for the Integrator class, which holds the Solver's vectorised Verlet kernels.
+/// @author Robert Poncelet
+/// @version 1.0
+/// @date 16/10/26
+/// @class Integrator
+/// @brief Applies gravity, air resistance and wind to a range of particles and moves them according
+/// to Verlet integration, several particles at a time. There is a plain C++ version of the kernel
+/// plus SSE (4 particles) and AVX (8 particles) versions; the widest one the CPU supports is picked
+/// at runtime. Anchored particles are handled with lane masks rather than branches. Every version
+/// does the same operations in the same order for each particle.
+
+class Integrator
+{
+public:
+    /// @brief The different versions of the kernel.
+    enum InstructionSet
+    {
+        SCALAR,
+        SSE,
+        AVX
+    };
+
+    /// @brief Integrates the particles in [_begin, _end). Each particle's pending force has gravity,
+    /// air resistance and (optionally) wind added to it, then is used to move the particle; the
+    /// force is cleared afterwards. Anchored particles don't move.
+    /// @param[in,out] _particles A pointer to the store containing the particles.
+    /// @param[in] _windZ An array of per-particle wind forces along Z, or null for no wind.
+    /// @param[in] _begin The first particle to integrate.
+    /// @param[in] _end One past the last particle to integrate.
+    /// @param[in] _gravity The strength of the gravity to apply.
+    /// @param[in] _airResistance The air resistance coefficient (multiplied by the velocity).
+    /// @param[in] _deltaSquared The square of the timestep.
+    static void integrate(CS::ParticleStore* _particles, const float* _windZ, const unsigned int &_begin, const unsigned int &_end, const float &_gravity, const float &_airResistance, const float &_deltaSquared);
+
+    /// @brief Returns the kernel version integrate() currently uses.
+    static InstructionSet getInstructionSet();
+
+    /// @brief Forces integrate() to use the specified kernel version, or the best one the CPU
+    /// supports if it can't run that one.
+    /// @param[in] _set The kernel version to use.
+    static void setInstructionSet(const InstructionSet &_set);
+
+    /// @brief Returns the best kernel version the CPU supports.
+    static InstructionSet getBestInstructionSet();
+
+    /// @brief Returns a readable name for the specified kernel version.
+    /// @param[in] _set The kernel version.
+    static const char* getInstructionSetName(const InstructionSet &_set);
+};
+
+#endif // INTEGRATOR_H
@@ -27,6 +27,22 @@ public:
     /// @brief Destructor for MainWindow.
     ~MainWindow();
 
+private slots:
+    /// @brief Ask where to record a point cache and start recording to it, or finish the one
+    /// being recorded.
+    /// @param[in] _record Whether to record.
+    void setRecording(bool _record);
+
+    /// @brief Ask which point cache to play and start playing it in place of the simulation, or go
+    /// back to the simulation.
+    /// @param[in] _play Whether to play a cache.
+    void setPlayback(bool _play);
+
+    /// @brief Ask where to record a replay and start recording to it, or finish the one being
+    /// recorded.
+    /// @param[in] _record Whether to record.
+    void setReplayRecording(bool _record);
+
 private:
 
     /// @brief The UI to display around the simulation.
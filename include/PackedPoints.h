@@ -0,0 +1,41 @@
+#ifndef PACKEDPOINTS_H
+#define PACKEDPOINTS_H
+
+#include <stdint.h>
+
+/// @file PackedPoints.h
+/// @brief Source file for the PackedPoints class, which packs particle positions for the GPU.
+/// @author Robert Poncelet
+/// @version 1.0
+/// @date 16/10/26
+/// @class PackedPoints
+/// @brief Converts positions as laid out by Cloth::getPoints() into the compact form the shaders
+/// read: four half floats per particle, XYZ and a fourth that is never read, half the size of the
+/// floats. The shaders work out each particle's index for themselves, so it doesn't need sending.
+/// Half floats keep about three significant figures, which is plenty to draw with but not to
+/// simulate with, so this is only ever done on the way to the GPU. Where the CPU has F16C the
+/// conversion is done in hardware, otherwise in plain C++; both round to nearest even.
+
+class PackedPoints
+{
+public:
+    /// @brief How many bytes each particle takes once packed.
+    static const unsigned int s_pointSize = 4 * sizeof(uint16_t);
+
+    /// @brief Packs the particles in [_begin, _end).
+    /// @param[in] _points The positions, four floats per particle as laid out by Cloth::getPoints().
+    /// @param[out] _packed Where to write them, four half floats per particle; particle _begin goes
+    /// at _packed[4 * _begin].
+    /// @param[in] _begin The first particle to pack.
+    /// @param[in] _end One past the last particle to pack.
+    static void pack(const float *_points, uint16_t *_packed, const unsigned int &_begin, const unsigned int &_end);
+
+    /// @brief Returns the half float nearest the specified float, with ties going to even.
+    /// @param[in] _value The float to convert.
+    static uint16_t toHalf(const float &_value);
+
+    /// @brief Returns whether pack() is converting in hardware.
+    static bool hasHardwareConversion();
+};
+
+#endif // PACKEDPOINTS_H
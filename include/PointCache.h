@@ -0,0 +1,107 @@
+#ifndef POINTCACHE_H
+#define POINTCACHE_H
+
+#include <cstdint>
+
+/// @file PointCache.h
+/// @brief The layout of the point cache files written by PointCacheWriter and played back by
+/// PointCacheReader.
+/// @author Robert Poncelet
+/// @version 1.0
+/// @date 16/10/26
+/// A point cache is a FileHeader followed by one record per frame, each a FrameHeader and then the
+/// frame's encoded particle positions, in particle store order. Frames are grouped into chunks
+/// that each start with a keyframe, which can be decoded on its own; the rest of a chunk may
+/// depend on the frame before it. Once the writer is closed, a table of where every frame starts
+/// and an IndexFooter are appended so a reader can seek straight to any frame; a file whose writer
+/// never closed it is still readable by walking the frame records from the start. Everything is in
+/// the machine's own byte order.
+
+namespace PointCache
+{
+    /// @brief How a frame's positions are stored.
+    enum Encoding
+    {
+        /// @brief Three floats per particle; every frame is a keyframe.
+        RAW,
+        /// @brief The frame's bounding box as six floats, then three 16-bit fractions of it per
+        /// particle; every frame is a keyframe. Errors are about 1/131070 of the box's size at most.
+        QUANTIZED,
+        /// @brief Each component rounded to a multiple of FileHeader::m_precision, stored as the
+        /// difference from the previous frame's value (or from zero in a keyframe), zigzag-encoded
+        /// as a variable-length integer. Cloth that is settling or moving smoothly mostly needs a
+        /// byte or two per component.
+        DELTA
+    };
+
+    /// @brief Flags in FrameHeader::m_flags.
+    enum FrameFlag
+    {
+        /// @brief The frame can be decoded without the ones before it.
+        KEYFRAME = 1 << 0
+    };
+
+    /// @brief The start of every point cache file.
+    struct FileHeader
+    {
+        /// @brief Always "CLOTHPC" followed by a zero.
+        char m_magic[8];
+        /// @brief The version of this layout the file was written with.
+        uint32_t m_version;
+        /// @brief sizeof(FileHeader) when the file was written.
+        uint32_t m_headerSize;
+        /// @brief One of the Encoding values.
+        uint32_t m_encoding;
+        /// @brief How many particles each frame has.
+        uint32_t m_particleNum;
+        /// @brief How many particles the cloth has along its X axis.
+        int32_t m_widthNum;
+        /// @brief How many particles the cloth has along its Y axis.
+        int32_t m_heightNum;
+        /// @brief The size of the blocks the particles are stored in; see Cloth::getParticleIndex().
+        int32_t m_blockSize;
+        /// @brief The step DELTA rounds positions to.
+        float m_precision;
+        /// @brief The most frames in a chunk, i.e. how often keyframes come.
+        uint32_t m_keyframeInterval;
+        /// @brief Unused; always zero.
+        uint32_t m_reserved;
+    };
+
+    /// @brief The start of each frame record.
+    struct FrameHeader
+    {
+        /// @brief Always FRAME_MAGIC.
+        uint32_t m_magic;
+        /// @brief FrameFlag values.
+        uint32_t m_flags;
+        /// @brief How many bytes of encoded positions follow.
+        uint32_t m_payloadBytes;
+        /// @brief Unused; always zero.
+        uint32_t m_reserved;
+        /// @brief The simulation time of the frame in seconds.
+        double m_time;
+    };
+
+    /// @brief The very end of a file that was closed properly.
+    struct IndexFooter
+    {
+        /// @brief How many frames there are, and so how many offsets are in the table.
+        uint64_t m_frameNum;
+        /// @brief Where the table of 64-bit frame offsets starts.
+        uint64_t m_indexOffset;
+        /// @brief Always "PCINDEX" followed by a zero.
+        char m_magic[8];
+    };
+
+    /// @brief The layout version written by this code.
+    const uint32_t VERSION = 1;
+    /// @brief The first four bytes of every frame record, "FRAM" when read as characters.
+    const uint32_t FRAME_MAGIC = 0x4d415246;
+    /// @brief FileHeader::m_magic.
+    const char FILE_MAGIC[8] = {'C','L','O','T','H','P','C','\0'};
+    /// @brief IndexFooter::m_magic.
+    const char INDEX_MAGIC[8] = {'P','C','I','N','D','E','X','\0'};
+}
+
+#endif // POINTCACHE_H
@@ -0,0 +1,117 @@
+#ifndef POINTCACHEREADER_H
+#define POINTCACHEREADER_H
+
+#include "PointCache.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/// @file PointCacheReader.h
+/// @brief Source file for the PointCacheReader class that plays back recorded cloth motion.
+/// @author Robert Poncelet
+/// @version 1.0
+/// @date 16/10/26
+/// @class PointCacheReader
+/// @brief Reads frames back out of a point cache written by PointCacheWriter, in the same layout
+/// Cloth::getPoints() uses, so they can be drawn exactly as a live cloth would be without running
+/// the Solver. Frames can be read in any order: stepping forward one frame at a time only decodes
+/// that frame, while jumping elsewhere decodes forward from the nearest keyframe before it.
+
+class PointCacheReader
+{
+public:
+    /// @brief Constructor for the PointCacheReader class; no file is open to begin with.
+    PointCacheReader();
+
+    /// @brief Destructor for the PointCacheReader class; closes any open file.
+    ~PointCacheReader();
+
+    /// @brief Opens a point cache and finds its frames, closing any file already open.
+    /// @param[in] _path The file to read.
+    /// @return Whether the file is a point cache this version can read.
+    bool open(const std::string &_path);
+
+    /// @brief Closes the file.
+    void close();
+
+    /// @brief Returns whether a file is open.
+    bool isOpen() const                                 {return m_file != 0;}
+
+    /// @brief Returns how many frames the file has.
+    unsigned int getFrameNum() const                    {return (unsigned int)m_offsets.size();}
+
+    /// @brief Returns the simulation time of the specified frame in seconds.
+    /// @param[in] _frame The index of the frame.
+    double getFrameTime(const unsigned int &_frame) const   {return m_times[_frame];}
+
+    /// @brief Returns the index of the last frame at or before the specified time, or the first
+    /// frame if they are all later.
+    /// @param[in] _time The time in seconds.
+    unsigned int findFrame(const double &_time) const;
+
+    /// @brief Returns how many particles each frame has.
+    unsigned int getParticleNum() const                 {return m_header.m_particleNum;}
+
+    /// @brief Returns the number of particles the recorded cloth had along its X axis.
+    int getWidthNum() const                             {return m_header.m_widthNum;}
+
+    /// @brief Returns the number of particles the recorded cloth had along its Y axis.
+    int getHeightNum() const                            {return m_header.m_heightNum;}
+
+    /// @brief Returns the size of the blocks the recorded cloth's particles were stored in.
+    int getBlockSize() const                            {return m_header.m_blockSize;}
+
+    /// @brief Decodes a frame's positions.
+    /// @param[in] _frame The index of the frame.
+    /// @param[out] _array Where to write the positions, laid out as by Cloth::getPoints(); it must
+    /// have room for four floats per particle.
+    /// @return Whether the frame could be read.
+    bool readFrame(const unsigned int &_frame, float _array[]);
+
+private:
+    /// @brief Not copyable.
+    PointCacheReader(const PointCacheReader &);
+
+    /// @brief Not assignable.
+    PointCacheReader& operator=(const PointCacheReader &);
+
+    /// @brief Fills m_offsets from the index at the end of the file, if there is a valid one.
+    /// @param[in] _fileSize The size of the file in bytes.
+    bool readIndex(const uint64_t &_fileSize);
+
+    /// @brief Fills m_offsets by walking the frame records from the start of the file, stopping
+    /// at the first one that is incomplete.
+    /// @param[in] _fileSize The size of the file in bytes.
+    void scanFrames(const uint64_t &_fileSize);
+
+    /// @brief Reads a frame's header and payload into m_frameHeader and m_payload.
+    /// @param[in] _frame The index of the frame.
+    bool loadFrame(const unsigned int &_frame);
+
+    /// @brief Decodes the frame in m_payload into m_positions; a DELTA frame that isn't a keyframe
+    /// is added to m_deltaValues, which must hold the frame before it.
+    void decode();
+
+    /// @brief The file being read.
+    FILE *m_file;
+    /// @brief The file's header.
+    PointCache::FileHeader m_header;
+    /// @brief Where each frame starts in the file.
+    std::vector<uint64_t> m_offsets;
+    /// @brief The time of each frame.
+    std::vector<double> m_times;
+    /// @brief Whether each frame is a keyframe.
+    std::vector<unsigned char> m_keyframes;
+    /// @brief The header of the frame most recently loaded.
+    PointCache::FrameHeader m_frameHeader;
+    /// @brief The encoded positions of the frame most recently loaded.
+    std::vector<unsigned char> m_payload;
+    /// @brief For DELTA, the rounded values of m_decodedFrame, which the next frame is relative to.
+    std::vector<int32_t> m_deltaValues;
+    /// @brief The decoded positions of m_decodedFrame, three floats per particle.
+    std::vector<float> m_positions;
+    /// @brief The frame m_positions holds, or -1 if none.
+    int m_decodedFrame;
+};
+
+#endif // POINTCACHEREADER_H
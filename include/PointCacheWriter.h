@@ -0,0 +1,134 @@
+#ifndef POINTCACHEWRITER_H
+#define POINTCACHEWRITER_H
+
+#include "PointCache.h"
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Cloth;
+
+/// @file PointCacheWriter.h
+/// @brief Source file for the PointCacheWriter class that records a cloth's motion to disk.
+/// @author Robert Poncelet
+/// @version 1.0
+/// @date 16/10/26
+/// @class PointCacheWriter
+/// @brief Appends a cloth's particle positions, one frame at a time, to a point cache file (see
+/// PointCache.h) for use downstream without simulating again. Adding a frame only copies the
+/// positions into a spare buffer and queues it; encoding and writing happen on the writer's own
+/// thread, so a slow disk never holds up the simulation. Buffers are recycled once written, and
+/// the queue grows rather than dropping frames or blocking if the disk falls behind.
+
+class PointCacheWriter
+{
+public:
+    /// @brief Constructor for the PointCacheWriter class; no file is open to begin with.
+    PointCacheWriter();
+
+    /// @brief Destructor for the PointCacheWriter class; finishes and closes any open file.
+    ~PointCacheWriter();
+
+    /// @brief Creates a point cache file, replacing any that is there, and starts the thread that
+    /// writes to it. Any file already open is closed first.
+    /// @param[in] _path Where to write the file.
+    /// @param[in] _widthNum The number of particles along the cloth's X axis.
+    /// @param[in] _heightNum The number of particles along the cloth's Y axis.
+    /// @param[in] _blockSize The size of the blocks the cloth's particles are stored in.
+    /// @param[in] _encoding How to store each frame's positions.
+    /// @param[in] _precision The step the DELTA encoding rounds positions to.
+    /// @param[in] _keyframeInterval The most frames between keyframes; at least 1.
+    /// @return Whether the file was created.
+    bool open(const std::string &_path, const int &_widthNum, const int &_heightNum, const int &_blockSize,
+              const PointCache::Encoding &_encoding, const float &_precision = 1e-4f, const unsigned int &_keyframeInterval = 32);
+
+    /// @brief Writes out every queued frame and the frame index, then closes the file.
+    /// @return Whether everything written since open() made it to disk.
+    bool close();
+
+    /// @brief Returns whether a file is open.
+    bool isOpen() const                     {return m_file != 0;}
+
+    /// @brief Queues the specified cloth's current positions to be written as the next frame. The
+    /// cloth must have as many particles as the file was opened for.
+    /// @param[in] _cloth The cloth to record; it is only read.
+    /// @param[in] _time The simulation time of the frame in seconds.
+    void addFrame(Cloth &_cloth, const double &_time);
+
+    /// @brief Queues positions already copied out of a cloth to be written as the next frame; they
+    /// are ignored if there aren't as many particles as the file was opened for.
+    /// @param[in] _points The positions as laid out by Cloth::getPoints(), four floats per particle.
+    /// @param[in] _time The simulation time of the frame in seconds.
+    void addFrame(const std::vector<float> &_points, const double &_time);
+
+    /// @brief Returns how many frames have been added since the file was opened.
+    unsigned int getFrameNum() const        {return m_framesAdded;}
+
+private:
+    /// @brief Not copyable.
+    PointCacheWriter(const PointCacheWriter &);
+
+    /// @brief Not assignable.
+    PointCacheWriter& operator=(const PointCacheWriter &);
+
+    /// @brief A frame waiting to be written.
+    struct Frame
+    {
+        /// @brief Four floats per particle, as laid out by Cloth::getPoints().
+        std::vector<float> m_points;
+        /// @brief The simulation time of the frame.
+        double m_time;
+    };
+
+    /// @brief Takes a recycled buffer, or a new one, to copy the next frame into.
+    Frame takeBuffer();
+
+    /// @brief Hands a filled frame to the writer thread.
+    /// @param[in,out] _frame The frame; its buffer is moved out of it.
+    void queue(Frame &_frame);
+
+    /// @brief The loop the writer thread runs until the file is closed.
+    void writerLoop();
+
+    /// @brief Encodes a frame into m_payload.
+    /// @param[in] _frame The frame to encode.
+    /// @param[in] _keyframe Whether to encode it without reference to the previous frame.
+    void encode(const Frame &_frame, const bool &_keyframe);
+
+    /// @brief The file being written; only touched by the writer thread while it runs.
+    FILE *m_file;
+    /// @brief The file's header.
+    PointCache::FileHeader m_header;
+    /// @brief The thread encoding and writing the frames.
+    std::thread m_thread;
+    /// @brief Protects m_queue, m_spare and m_closing.
+    std::mutex m_mutex;
+    /// @brief Signalled when a frame is queued or the file is being closed.
+    std::condition_variable m_wakeCondition;
+    /// @brief The frames waiting to be written, oldest first.
+    std::deque<Frame> m_queue;
+    /// @brief Buffers that have been written and can be filled again.
+    std::vector<std::vector<float> > m_spare;
+    /// @brief Whether the writer thread should finish the queue and stop.
+    bool m_closing;
+    /// @brief How many frames have been added since the file was opened.
+    unsigned int m_framesAdded;
+
+    //the rest is only touched by the writer thread while it runs
+    /// @brief Where each frame written so far starts in the file.
+    std::vector<uint64_t> m_offsets;
+    /// @brief How many bytes have been written to the file.
+    uint64_t m_offset;
+    /// @brief The DELTA encoding's rounded values for the last frame written.
+    std::vector<int32_t> m_previous;
+    /// @brief The encoded positions of the frame being written.
+    std::vector<unsigned char> m_payload;
+    /// @brief Whether a write has failed since the file was opened.
+    bool m_failed;
+};
+
+#endif // POINTCACHEWRITER_H
@@ -0,0 +1,126 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "ClothCommand.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// @file Replay.h
+/// @brief Source file for the Replay class that records a run of the simulation and checks it.
+/// @author Robert Poncelet
+/// @version 1.0
+/// @date 16/10/26
+/// @class Replay
+/// @brief A log of everything that happened to a cloth after a known starting state: every
+/// ClothCommand with the step it was applied before, and a hash of the particles' state every so
+/// many steps. play() runs the same steps and commands on a cloth restored to that starting state
+/// and reports each checkpoint whose hash comes out differently, so a change to the solver, the
+/// thread count or the build can be checked for divergence before it is trusted. Every step gives
+/// bit-for-bit the same result whatever the thread count, so the hashes can be compared across
+/// machines. The starting state is saved with ClothFile next to the log, at getStatePath().
+
+class Replay
+{
+public:
+    /// @brief A command and the step it was applied before.
+    struct Event
+    {
+        /// @brief How many steps had been run since the recording started.
+        uint64_t m_step;
+        /// @brief The command that was applied.
+        ClothCommand m_command;
+    };
+
+    /// @brief The hash of the cloth's state after a number of steps.
+    struct Checkpoint
+    {
+        /// @brief How many steps had been run since the recording started.
+        uint64_t m_step;
+        /// @brief What hashState() returned then.
+        uint64_t m_hash;
+    };
+
+    /// @brief A checkpoint play() didn't reach with the same state.
+    struct Divergence
+    {
+        /// @brief The step of the checkpoint.
+        uint64_t m_step;
+        /// @brief The hash that was recorded.
+        uint64_t m_expected;
+        /// @brief The hash play() got.
+        uint64_t m_actual;
+    };
+
+    /// @brief Constructor for the Replay class; starts with an empty log.
+    /// @param[in] _hashInterval How many steps apart checkpoints should be.
+    Replay(const unsigned int &_hashInterval = 10);
+
+    /// @brief Empties the log ready for a new recording.
+    /// @param[in] _hashInterval How many steps apart checkpoints should be; at least 1.
+    void clear(const unsigned int &_hashInterval);
+
+    /// @brief Logs a command applied before the specified step; commands must be added in the
+    /// order they were applied, and after any checkpoint at the same step.
+    /// @param[in] _step How many steps had been run since the recording started.
+    /// @param[in] _command The command.
+    void addCommand(const uint64_t &_step, const ClothCommand &_command);
+
+    /// @brief Logs the state of the specified cloth after the specified step, if the step is at
+    /// least the hash interval past the last checkpoint or _force is set.
+    /// @param[in] _step How many steps had been run since the recording started.
+    /// @param[in] _cloth The cloth; it is only read.
+    /// @param[in] _force Whether to log it however close the last checkpoint is.
+    void addCheckpoint(const uint64_t &_step, const Cloth &_cloth, const bool &_force = false);
+
+    /// @brief Returns how many steps apart checkpoints are.
+    unsigned int getHashInterval() const            {return m_hashInterval;}
+
+    /// @brief Returns the logged commands in the order they were applied.
+    const std::vector<Event>& getEvents() const     {return m_events;}
+
+    /// @brief Returns the logged checkpoints in step order.
+    const std::vector<Checkpoint>& getCheckpoints() const   {return m_checkpoints;}
+
+    /// @brief Returns how many steps the recording covers, i.e. the step of the last checkpoint.
+    uint64_t getStepNum() const                     {return m_checkpoints.empty() ? 0 : m_checkpoints.back().m_step;}
+
+    /// @brief Writes the log to a file, replacing it if it exists. The starting state isn't part of
+    /// this; it is saved separately with ClothFile::save() at getStatePath().
+    /// @param[in] _path Where to write the log.
+    /// @return Whether the file was written successfully.
+    bool save(const std::string &_path) const;
+
+    /// @brief Replaces the log with one written by save(); it is left untouched if the file can't
+    /// be read.
+    /// @param[in] _path The file to read.
+    /// @return Whether the log was read.
+    bool load(const std::string &_path);
+
+    /// @brief Runs the logged steps and commands on the specified cloth, checking its state at
+    /// every checkpoint.
+    /// @param[in,out] _cloth The cloth, already in the recording's starting state.
+    /// @param[out] _divergences Filled with every checkpoint that didn't match, in step order.
+    /// @return Whether every checkpoint matched.
+    bool play(Cloth &_cloth, std::vector<Divergence> &_divergences) const;
+
+    /// @brief Returns a hash of everything about the specified cloth's particles and sphere that
+    /// the next step depends on, down to the last bit of every float, along with the implicit
+    /// mode's warm start, so a starting state that left it out fails at the first checkpoint.
+    /// @param[in] _cloth The cloth to hash.
+    static uint64_t hashState(const Cloth &_cloth);
+
+    /// @brief Returns where the starting state of the recording logged at _path is kept.
+    /// @param[in] _path The path of the log.
+    static std::string getStatePath(const std::string &_path)  {return _path + ".cloth";}
+
+private:
+    /// @brief How many steps apart checkpoints are.
+    unsigned int m_hashInterval;
+    /// @brief The commands, in the order they were applied.
+    std::vector<Event> m_events;
+    /// @brief The checkpoints, in step order.
+    std::vector<Checkpoint> m_checkpoints;
+};
+
+#endif // REPLAY_H
@@ -0,0 +1,167 @@
+#ifndef SIMULATIONTHREAD_H
+#define SIMULATIONTHREAD_H
+
+#include "ClothCommand.h"
+#include "CommandQueue.h"
+#include "Replay.h"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+//how many commands can be waiting for the simulation thread at once
+#define COMMAND_QUEUE_SIZE 256
+
+/// @file SimulationThread.h
+/// @brief Source file for the SimulationThread class which runs the cloth away from the GUI thread.
+/// @author Robert Poncelet
+/// @version 1.0
+/// @date 16/10/26
+/// @class SimulationThread
+/// @brief Owns a Cloth and steps it on a dedicated thread in real time, using the cloth's fixed
+/// timestep. After each batch of steps the particle positions are copied into a snapshot, which
+/// the GUI thread picks up with acquireSnapshot() without ever waiting; snapshots are triple
+/// buffered, so the simulation always has one to fill while the GUI holds another. Changes to the
+/// cloth are posted as Commands through a lock-free queue and applied between steps, so nothing
+/// outside the simulation thread touches the Cloth once start() has been called.
+
+class SimulationThread
+{
+public:
+    /// @brief A copy of the cloth's state at the end of a step, for drawing.
+    struct Snapshot
+    {
+        /// @brief The particle positions and indices as packed by Cloth::getPoints().
+        std::vector<GLfloat> m_points;
+        /// @brief The version each tile of CHANGE_TILE_SIZE particles last changed at, from
+        /// Cloth::getTileVersions(); a copy of m_points from an earlier snapshot only needs the
+        /// tiles newer than its m_version bringing up to date.
+        std::vector<uint32_t> m_tileVersions;
+        /// @brief Which publish this is, counting from 1; a tile changed in this one has this as
+        /// its version.
+        uint32_t m_version;
+        /// @brief How many particles the cloth had along its X axis.
+        int m_widthNum;
+        /// @brief How many particles the cloth had along its Y axis.
+        int m_heightNum;
+        /// @brief The size of the blocks the cloth's particles were stored in.
+        int m_blockSize;
+        /// @brief Where the collision sphere was.
+        ngl::Vec3 m_spherePos;
+        /// @brief The radius of the collision sphere.
+        float m_sphereRadius;
+        /// @brief How many times the cloth had been reset; when this changes the particle count
+        /// may have too.
+        unsigned int m_generation;
+        /// @brief How many fixed timesteps had been run since the simulation thread started.
+        unsigned long m_stepCount;
+        /// @brief How many seconds had been simulated since the simulation thread started.
+        double m_time;
+
+        /// @brief A default constructor for the struct.
+        Snapshot() : m_version(0), m_widthNum(0), m_heightNum(0), m_blockSize(1), m_sphereRadius(0.0f), m_generation(0), m_stepCount(0), m_time(0.0) {;}
+    };
+
+    /// @brief A change to make to the cloth on the simulation thread.
+    typedef ClothCommand Command;
+
+    /// @brief Constructor for the SimulationThread class; creates a default cloth and publishes
+    /// its first snapshot, but doesn't start the thread.
+    SimulationThread();
+
+    /// @brief Destructor for the SimulationThread class; stops the thread if it is running.
+    ~SimulationThread();
+
+    /// @brief Starts stepping the cloth on its own thread.
+    void start();
+
+    /// @brief Stops the thread and waits for it to finish.
+    void stop();
+
+    /// @brief Queues a change to the cloth, to be made before its next step. Only call this from
+    /// one thread (normally the GUI thread).
+    /// @param[in] _command The change to make.
+    void post(const Command &_command);
+
+    /// @brief Takes the newest finished snapshot if there is one the caller hasn't seen yet;
+    /// never blocks. Only call this from one thread (normally the GUI thread).
+    /// @return Whether getSnapshot() now returns a newer snapshot.
+    bool acquireSnapshot();
+
+    /// @brief Returns the snapshot most recently taken by acquireSnapshot(). It stays valid and
+    /// unchanged until the next call to acquireSnapshot().
+    const Snapshot& getSnapshot() const     {return m_snapshots[m_reading];}
+
+    /// @brief Starts logging every command applied to the cloth, and the state it reaches, to a
+    /// Replay, finishing any recording already going. The thread is paused while the starting
+    /// state is saved. Only call this from the thread that posts commands.
+    /// @param[in] _path Where the log will be written; the starting state is written straight away
+    /// to Replay::getStatePath(_path).
+    /// @param[in] _hashInterval How many steps apart the state is checked.
+    /// @return Whether the starting state could be saved.
+    bool startRecording(const std::string &_path, const unsigned int &_hashInterval);
+
+    /// @brief Finishes the recording and writes its log, pausing the thread while it does.
+    /// Commands posted but not applied yet are left out of it.
+    /// @return Whether the log was written, or true if nothing was being recorded.
+    bool stopRecording();
+
+private:
+    /// @brief Not copyable.
+    SimulationThread(const SimulationThread &);
+
+    /// @brief Not assignable.
+    SimulationThread& operator=(const SimulationThread &);
+
+    /// @brief The loop the thread runs until stop() is called.
+    void run();
+
+    /// @brief Makes the specified change to the cloth, logging it if we are recording.
+    /// @param[in] _command The change to make.
+    void apply(const Command &_command);
+
+    /// @brief Applies every command waiting in the queue.
+    /// @return Whether there were any.
+    bool applyCommands();
+
+    /// @brief Copies the cloth's current state into the spare snapshot and makes it the newest.
+    void publish();
+
+    /// @brief The cloth being simulated; only touched by the simulation thread once it has started.
+    Cloth m_cloth;
+    /// @brief The thread stepping the cloth.
+    std::thread m_thread;
+    /// @brief Whether the thread should exit.
+    std::atomic<bool> m_quit;
+    /// @brief Changes waiting to be made to the cloth.
+    CommandQueue<Command, COMMAND_QUEUE_SIZE> m_commands;
+    /// @brief The three snapshot buffers: one being filled, one held by the reader and the newest
+    /// finished one waiting in between.
+    Snapshot m_snapshots[3];
+    /// @brief The index of the newest finished snapshot, plus a flag set when the reader hasn't
+    /// taken it yet.
+    std::atomic<unsigned int> m_ready;
+    /// @brief The index of the snapshot the simulation thread fills next.
+    unsigned int m_writing;
+    /// @brief The index of the snapshot held by the reader.
+    unsigned int m_reading;
+    /// @brief How many times the cloth has been reset.
+    unsigned int m_generation;
+    /// @brief How many fixed timesteps have been run.
+    unsigned long m_stepCount;
+    /// @brief How many seconds have been simulated; the timestep can change, so this isn't simply
+    /// m_stepCount times it.
+    double m_time;
+    /// @brief How many snapshots have been published.
+    uint32_t m_version;
+    /// @brief Whether commands and checkpoints are being logged to m_replay.
+    bool m_recording;
+    /// @brief The recording; only touched by the simulation thread while it runs.
+    Replay m_replay;
+    /// @brief Where m_replay will be written.
+    std::string m_replayPath;
+    /// @brief The value of m_stepCount when the recording started.
+    unsigned long m_replayStartStep;
+};
+
+#endif // SIMULATIONTHREAD_H
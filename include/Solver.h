@@ -2,6 +2,15 @@
 #define SOLVER_H
 
 #include "Common.h"
+#include "FrameArena.h"
+#include "SparseBlockMatrix.h"
+#include "SpatialHash.h"
+#include "TaskGraph.h"
+
+//how many particles share a sleep state; see Solver::m_allowSleeping
+#define SLEEP_TILE_SIZE 256
+//how many steps in a row a tile has to stay still for before it is put to sleep
+#define SLEEP_STEPS 32
 
 /// @file Solver.h
 /// @brief Source file for the Solver class that works for the Cloth.
@@ -15,30 +24,139 @@
 class Solver
 {
 public:
+    /// @brief The ways advance() can keep the springs together.
+    enum Mode
+    {
+        /// @brief Each spring applies a Hooke's law force which is integrated explicitly; simple,
+        /// but stiff springs need small timesteps to stay stable.
+        FORCE_BASED,
+        /// @brief Each spring is treated as a compliant distance constraint and projected with
+        /// extended position-based dynamics (XPBD); stable at large timesteps whatever the
+        /// stiffness, and converges further with more iterations.
+        XPBD,
+        /// @brief The springs' forces are integrated with backward Euler in the style of Baraff and
+        /// Witkin, solving a sparse linear system with preconditioned conjugate gradients each
+        /// step; stiff springs stay stable at timesteps many times longer than FORCE_BASED needs.
+        IMPLICIT
+    };
+
     /// @brief Constructor for the Solver class.
     Solver();
 
     /// @brief Destructor for the Solver class.
     ~Solver();
 
-    /// @brief Advance the simulation forward a frame according to its current state.
-    /// @param[in,out] _springs A pointer to a vector containing all the springs in the Cloth.
-    /// @param[in,out] _particles A pointer to a vector containing all the particles in the Cloth.
+    /// @brief Advance the simulation forward a frame according to its current state. The step is
+    /// run on the ThreadPool as a graph of tasks: spring forces, then external forces and
+    /// integration for each tile of particles, then whatever the mode needs over the whole cloth
+    /// (constraint projection, the implicit solve, self-collision) and lastly the sphere
+    /// collisions for each tile. A tile's tasks only wait for what they actually depend on, so one
+    /// tile can be colliding with the sphere while another is still being integrated. If sleeping is
+    /// allowed, each tile's motion is measured at the end and those that have settled are put to
+    /// sleep; see m_allowSleeping.
+    /// @param[in] _springs A pointer to the store containing all the springs in the Cloth.
+    /// @param[in,out] _particles A pointer to the store containing all the particles in the Cloth.
     /// @param[in] _time How much time has passed since the simulation began (only really used for
     /// wind).
     /// @param[in] _deltaSeconds The time in seconds since the last call to advance().
-    void advance(std::vector<CS::Spring>* _springs, std::vector<CS::Particle>* _particles, const double &_time, const float &_deltaSeconds);
+    void advance(const CS::SpringStore* _springs, CS::ParticleStore* _particles, const double &_time, const float &_deltaSeconds);
 
     /// @brief Apply forces to the particles the specified spring connects depending on the length
     /// of the spring.
-    /// @param[in] _spring A pointer to the spring in question.
-    void updateSpring(CS::Spring* _spring);
+    /// @param[in,out] _particles A pointer to the store containing the spring's particles.
+    /// @param[in] _springs A pointer to the store containing the spring.
+    /// @param[in] _index The index of the spring in question.
+    void updateSpring(CS::ParticleStore* _particles, const CS::SpringStore* _springs, const unsigned int &_index);
+
+    /// @brief Returns the force the specified spring applies to its start particle, including
+    /// damping; its end particle receives the negation of this.
+    /// @param[in] _particles A pointer to the store containing the spring's particles.
+    /// @param[in] _springs A pointer to the store containing the spring.
+    /// @param[in] _index The index of the spring in question.
+    ngl::Vec3 getSpringForce(const CS::ParticleStore* _particles, const CS::SpringStore* _springs, const unsigned int &_index) const;
+
+    /// @brief Adds every spring's force to the particles it connects. Large cloths are split across
+    /// the ThreadPool: each spring's force is computed independently, then each particle sums its
+    /// own springs' forces in spring order. That is the same order the serial loop adds them in, so
+    /// the result is bit-identical whatever the thread count.
+    /// @param[in,out] _particles A pointer to the store containing all the particles in the Cloth.
+    /// @param[in] _springs A pointer to the store containing all the springs in the Cloth.
+    void accumulateSpringForces(CS::ParticleStore* _particles, const CS::SpringStore* _springs);
+
+    /// @brief Projects every spring as an XPBD distance constraint, iterating over them all
+    /// m_iterations times. The particles must already hold their predicted positions for this
+    /// step, with their positions at the start of the step as their previous positions. If the
+    /// springs have been sorted by colour, large cloths project each colour's springs across the
+    /// ThreadPool; this is still Gauss-Seidel, and bit-identical to the serial loop.
+    /// @param[in,out] _particles A pointer to the store containing all the particles in the Cloth.
+    /// @param[in] _springs A pointer to the store containing all the springs in the Cloth.
+    /// @param[in] _deltaSeconds The length of the step, already scaled by m_speed.
+    void projectDistanceConstraints(CS::ParticleStore* _particles, const CS::SpringStore* _springs, const float &_deltaSeconds);
+
+    /// @brief Moves the particles the specified spring connects so that it is closer to its rest
+    /// length, by as much as its compliance allows, and updates its Lagrange multiplier to match.
+    /// @param[in,out] _particles A pointer to the store containing the spring's particles.
+    /// @param[in] _springs A pointer to the store containing the spring.
+    /// @param[in] _index The index of the spring in question.
+    /// @param[in] _deltaSeconds The length of the step, already scaled by m_speed.
+    void projectSpring(CS::ParticleStore* _particles, const CS::SpringStore* _springs, const unsigned int &_index, const float &_deltaSeconds);
+
+    /// @brief Runs one backward Euler step of the whole cloth: assembles the system
+    /// (M - h*dF/dv - h^2*dF/dx) * dv = h * (F + h*dF/dx * v) from the springs, solves it for the
+    /// change in velocity with solveConjugateGradient() and moves the particles accordingly.
+    /// @param[in,out] _particles A pointer to the store containing all the particles in the Cloth.
+    /// @param[in] _springs A pointer to the store containing all the springs in the Cloth.
+    /// @param[in] _windZ Each particle's wind force along Z, or null for no wind.
+    /// @param[in] _deltaSeconds The length of the step, already scaled by m_speed.
+    void stepImplicit(CS::ParticleStore* _particles, const CS::SpringStore* _springs, const float* _windZ, const float &_deltaSeconds);
+
+    /// @brief Tells the solver the springs have been regenerated, so the implicit mode has to work
+    /// out its matrix's sparsity pattern again and start its solve from nothing, and every tile is
+    /// woken; Cloth::reset() calls this.
+    void invalidateTopology()                   {m_hasPattern = false; m_hasSleepTopology = false; m_deltaV.clear(); wakeAll();}
+
+    /// @brief Returns the implicit mode's last change in velocity, three floats per particle, which
+    /// the next implicit step starts its solve from; empty if there hasn't been one since the cloth
+    /// was last rebuilt.
+    const std::vector<float>& getWarmStart() const {return m_deltaV;}
+
+    /// @brief Sets what the next implicit step starts its solve from, e.g. to carry on a saved run
+    /// exactly; call it after invalidateTopology(), which clears it.
+    /// @param[in] _deltaV Three floats per particle, or empty to start from nothing.
+    void setWarmStart(const std::vector<float> &_deltaV) {m_deltaV = _deltaV;}
+
+    /// @brief Wakes every sleeping tile of particles, e.g. because a force or constraint has
+    /// changed in a way the tiles can't see for themselves.
+    void wakeAll();
+
+    /// @brief Returns how many tiles of SLEEP_TILE_SIZE particles are asleep after the last step.
+    unsigned int getSleepingTileNum() const;
+
+    /// @brief Returns the arena the solver's scratch buffers come from, e.g. to see how much each
+    /// step allocates.
+    const FrameArena& getArena() const          {return m_arena;}
+
+    /// @brief Returns how many conjugate gradient iterations the last implicit step took.
+    unsigned int getLastSolveIterations() const {return m_lastSolveIterations;}
 
     /// @brief Update the particle's position depending on the forces it has accumulated from
-    /// neighbouring springs and according to Verlet integration.
-    /// @param[in,out] _particle A pointer to the particle in question.
+    /// neighbouring springs and according to Verlet integration. advance() doesn't use this; it
+    /// integrates many particles at once with the Integrator kernels instead.
+    /// @param[in,out] _particles A pointer to the store containing the particle.
+    /// @param[in] _index The index of the particle in question.
     /// @param[in] _deltaSeconds The time in seconds since the last call to advance().
-    void updateParticle(CS::Particle* _particle, float _deltaSeconds);
+    void updateParticle(CS::ParticleStore* _particles, const unsigned int &_index, float _deltaSeconds);
+
+    /// @brief Pushes apart any cloth particles that overlap each other; this is the self-collision
+    /// pass of advance().
+    /// @param[in,out] _particles A pointer to the store containing all the particles in the Cloth.
+    void resolveSelfCollisions(CS::ParticleStore* _particles);
+
+    /// @brief Catches any cloth particles that went into or through the specified sphere this step
+    /// with resolveSweptCollision(); this is the sphere collision pass of advance().
+    /// @param[in,out] _particles A pointer to the store containing all the particles in the Cloth.
+    /// @param[in] _sphere The sphere to collide with.
+    void resolveSphereCollisions(CS::ParticleStore* _particles, const CS::Particle* _sphere);
 
     /// @brief Applies a separating force to the specified particles if their radii intersect i.e.
     /// they have collided. Obselete; replaced by resolveCollisionTranslate().
@@ -50,10 +168,31 @@ public:
     /// @brief Similar to resolveCollision() but simply translates the particles away from each other
     /// rather than applying a force; because of the way Verlet integration works, the end result is
     /// the same as neatly applying an impulse.
-    /// @param[in,out] _firstParticle One of the particles involved in the collision test.
-    /// @param[in,out] _secondParticle The other particle involved in the collision test.
+    /// @param[in,out] _particles A pointer to the store containing both particles.
+    /// @param[in] _first The index of one of the particles involved in the collision test.
+    /// @param[in] _second The index of the other particle involved in the collision test.
     /// @return Whether there was a collision; useful for debugging.
-    bool resolveCollisionTranslate(CS::Particle *_firstParticle, CS::Particle *_secondParticle);
+    bool resolveCollisionTranslate(CS::ParticleStore* _particles, const unsigned int &_first, const unsigned int &_second);
+
+    /// @brief The same as the above, but between a cloth particle and a free-standing one such as
+    /// the collision sphere. Only the cloth particle is moved; the other is treated as anchored.
+    /// @param[in,out] _particles A pointer to the store containing the cloth particle.
+    /// @param[in] _index The index of the cloth particle involved in the collision test.
+    /// @param[in] _obstacle The particle to push the cloth particle away from.
+    /// @return Whether there was a collision; useful for debugging.
+    bool resolveCollisionTranslate(CS::ParticleStore* _particles, const unsigned int &_index, const CS::Particle *_obstacle);
+
+    /// @brief Continuous version of the above: sweeps the cloth particle from its previous position
+    /// to its current one against the obstacle moving from its own previous position to its
+    /// current one, so a particle that passed right through the obstacle during the step is still
+    /// caught. It is put back on the obstacle's surface on the side it hit, rather than pushed out
+    /// of whichever side it ended up nearest. A particle already inside at the start of the step
+    /// falls back to resolveCollisionTranslate().
+    /// @param[in,out] _particles A pointer to the store containing the cloth particle.
+    /// @param[in] _index The index of the cloth particle involved in the collision test.
+    /// @param[in] _obstacle The particle to push the cloth particle away from.
+    /// @return Whether there was a collision; useful for debugging.
+    bool resolveSweptCollision(CS::ParticleStore* _particles, const unsigned int &_index, const CS::Particle *_obstacle);
 
     /// @brief Whether to check for and resolve collisions between internal particles.
     bool m_applySelfCollision;
@@ -61,12 +200,188 @@ public:
     bool m_applySphereCollision;
     /// @brief Whether to apply a turbulent wind-like force to the particles.
     bool m_applyWind;
+    /// @brief Whether tiles of particles that have stayed still for SLEEP_STEPS steps may be put to
+    /// sleep, skipping their integration, their springs to other sleeping particles and their
+    /// sphere collisions until something disturbs them: a neighbouring tile moving, the sphere
+    /// passing through them or a self-collision with an awake particle. A sleeping particle has no
+    /// velocity and holds still like an anchored one. Wind keeps every tile awake, and the
+    /// implicit mode solves the whole cloth at once so it never sleeps. Off by default.
+    bool m_allowSleeping;
     /// @brief The strength of the gravity to apply to the particles.
     float m_gravity;
     /// @brief The speed of the simulation. DeltaSeconds is multiplied by this during advance().
     float m_speed;
-    /// @brief A pointer to the collision-demo sphere.
+    /// @brief A pointer to the collision-demo sphere. Its previous position must be where it was at
+    /// the start of the step, which Cloth::advance() takes care of.
     CS::Particle* m_sphere;
+    /// @brief How the springs are solved; FORCE_BASED by default.
+    Mode m_mode;
+    /// @brief How many times each step the XPBD mode projects every spring.
+    unsigned int m_iterations;
+    /// @brief The most conjugate gradient iterations the implicit mode runs each step.
+    unsigned int m_maxSolveIterations;
+    /// @brief The implicit mode stops iterating once the residual is this small relative to the
+    /// right-hand side.
+    float m_solveTolerance;
+
+private:
+    /// @brief Works out the force of each spring in the specified range into m_springForces.
+    /// @param[in] _particles A pointer to the store containing all the particles in the Cloth.
+    /// @param[in] _springs A pointer to the store containing all the springs in the Cloth.
+    /// @param[in] _begin The first spring to work out.
+    /// @param[in] _end One past the last spring to work out.
+    void computeSpringForces(const CS::ParticleStore* _particles, const CS::SpringStore* _springs, const unsigned int &_begin, const unsigned int &_end);
+
+    /// @brief Adds the forces in m_springForces to the particles in the specified range, each
+    /// particle summing its own springs in spring order.
+    /// @param[in,out] _particles A pointer to the store containing all the particles in the Cloth.
+    /// @param[in] _springs A pointer to the store containing all the springs in the Cloth.
+    /// @param[in] _begin The first particle to add forces to.
+    /// @param[in] _end One past the last particle to add forces to.
+    void gatherSpringForces(CS::ParticleStore* _particles, const CS::SpringStore* _springs, const unsigned int &_begin, const unsigned int &_end);
+
+    /// @brief Works out the wind force for the particles in the specified range into m_windForces.
+    /// @param[in] _particles A pointer to the store containing all the particles in the Cloth.
+    /// @param[in] _time How much time has passed since the simulation began.
+    /// @param[in] _begin The first particle to work out.
+    /// @param[in] _end One past the last particle to work out.
+    void computeWind(const CS::ParticleStore* _particles, const double &_time, const unsigned int &_begin, const unsigned int &_end);
+
+    /// @brief Returns whether the specified particle is in a sleeping tile this step.
+    /// @param[in] _index The index of the particle in question.
+    bool isAsleep(const unsigned int &_index) const {return m_isSleeping && m_sleepCounters[_index / SLEEP_TILE_SIZE] >= SLEEP_STEPS;}
+
+    /// @brief Returns whether the specified spring has both its particles asleep, so has nothing to
+    /// do this step.
+    /// @param[in] _springs A pointer to the store containing the spring.
+    /// @param[in] _index The index of the spring in question.
+    bool isSpringAsleep(const CS::SpringStore* _springs, const unsigned int &_index) const;
+
+    /// @brief Integrates the awake particles in the specified range and clears the forces of the
+    /// sleeping ones, which springs to awake particles may have added to.
+    /// @param[in,out] _particles A pointer to the store containing all the particles in the Cloth.
+    /// @param[in] _windZ Each particle's wind force along Z, or null for no wind.
+    /// @param[in] _begin The first particle to integrate.
+    /// @param[in] _end One past the last particle to integrate.
+    /// @param[in] _deltaSquared The length of the step squared.
+    void integrateAwake(CS::ParticleStore* _particles, const float* _windZ, const unsigned int &_begin, const unsigned int &_end, const float &_deltaSquared);
+
+    /// @brief Works out which tiles can sleep this step: wakes them all if sleeping isn't allowed or
+    /// possible, and otherwise wakes the sleeping tiles the sphere has swept into since the last
+    /// step. Sets m_isSleeping.
+    /// @param[in] _springs A pointer to the store containing all the springs in the Cloth.
+    /// @param[in] _particles A pointer to the store containing all the particles in the Cloth.
+    void prepareSleep(const CS::SpringStore* _springs, const CS::ParticleStore* _particles);
+
+    /// @brief Records how far the awake tiles in the specified range moved this step in
+    /// m_tileMotion.
+    /// @param[in] _particles A pointer to the store containing all the particles in the Cloth.
+    /// @param[in] _begin The first particle of the range; must start a tile.
+    /// @param[in] _end One past the last particle of the range.
+    void measureMotion(const CS::ParticleStore* _particles, const unsigned int &_begin, const unsigned int &_end);
+
+    /// @brief Counts how long each tile has been still for, wakes the neighbours of the tiles that
+    /// moved and puts the tiles that have been still long enough to sleep.
+    /// @param[in,out] _particles A pointer to the store containing all the particles in the Cloth.
+    /// @param[in] _threshold How far a tile can move in a step and still count as still.
+    void updateSleep(CS::ParticleStore* _particles, const float &_threshold);
+
+    /// @brief Returns whether the specified tile moved further than the threshold this step; a tile
+    /// that has blown up to NaN counts as moving, rather than being put to sleep like that.
+    /// @param[in] _tile The tile in question.
+    /// @param[in] _threshold How far a tile can move in a step and still count as still.
+    bool isMoving(const unsigned int &_tile, const float &_threshold) const {return !(m_tileMotion[_tile] <= _threshold);}
+
+    /// @brief Makes the specified task wait for the last one to touch the specified tile, or the
+    /// whole cloth, and records it as the last to touch that tile.
+    /// @param[in] _tile The tile the task works on.
+    /// @param[in] _task The task's index in m_graph.
+    void addTileTask(const unsigned int &_tile, const unsigned int &_task);
+
+    /// @brief Makes the specified task wait for every tile to be finished with, and records it as
+    /// the last task to touch the whole cloth.
+    /// @param[in] _task The task's index in m_graph.
+    void addWholeTask(const unsigned int &_task);
+
+    /// @brief The broadphase for self-collision; rebuilt every step so that only particles in
+    /// neighbouring cells are passed to resolveCollisionTranslate().
+    SpatialHash m_broadphase;
+    /// @brief Scratch space for the results of broadphase queries, kept around to avoid
+    /// reallocating it for every particle.
+    std::vector<unsigned int> m_neighbours;
+    /// @brief Where the buffers below, and any other scratch space a step needs, come from. Each
+    /// advance() resets it first; only advance() itself and its whole-cloth tasks allocate from it,
+    /// and those never run at the same time as each other.
+    FrameArena m_arena;
+    /// @brief Whether advance() is running, so the passes it calls don't reset m_arena; called
+    /// on their own they each reset it first. See beginFrame().
+    bool m_isStepping;
+    /// @brief Scratch space for each spring's force during a parallel accumulateSpringForces().
+    ngl::Vec3 *m_springForces;
+    /// @brief Scratch space for each particle's wind force along Z.
+    float *m_windForces;
+    /// @brief Each spring's accumulated Lagrange multiplier (its force times the step squared)
+    /// during the XPBD mode's iterations; cleared at the start of every step.
+    float *m_lambdas;
+
+    /// @brief Resets m_arena unless advance() is running, for the passes that can be called on
+    /// their own as well as part of a step.
+    void beginFrame()                           {if (!m_isStepping) {m_arena.reset();}}
+
+    /// @brief Runs preconditioned conjugate gradients on m_system, solving for m_deltaV starting
+    /// from whatever it already holds. Anchored particles are filtered out so their change in
+    /// velocity stays at zero.
+    /// @param[in] _particles A pointer to the store containing all the particles in the Cloth.
+    /// @return How many iterations it took.
+    unsigned int solveConjugateGradient(const CS::ParticleStore* _particles);
+
+    /// @brief Returns the dot product of two vectors of the implicit mode's size, added up in
+    /// double precision.
+    double dot(const std::vector<float> &_a, const std::vector<float> &_b) const;
+
+    /// @brief The implicit mode's system matrix; its pattern is kept from step to step.
+    SparseBlockMatrix m_system;
+    /// @brief Whether m_system's pattern matches the current springs.
+    bool m_hasPattern;
+    /// @brief The inverse of each diagonal block of m_system, used as the preconditioner.
+    std::vector<float> m_inverseDiagonal;
+    /// @brief Each particle's velocity at the start of the implicit step.
+    std::vector<float> m_velocity;
+    /// @brief The right-hand side of the implicit system.
+    std::vector<float> m_rhs;
+    /// @brief The change in velocity solved for; the last step's answer is the next one's first
+    /// guess.
+    std::vector<float> m_deltaV;
+    /// @brief Conjugate gradient scratch space: the residual, the preconditioned residual, the
+    /// search direction and the matrix times the search direction.
+    std::vector<float> m_residual, m_preconditioned, m_direction, m_product;
+    /// @brief How many iterations the last implicit solve took.
+    unsigned int m_lastSolveIterations;
+
+    /// @brief For each tile of SLEEP_TILE_SIZE particles, how many steps in a row it has been still
+    /// for, up to SLEEP_STEPS which means it is asleep.
+    std::vector<uint16_t> m_sleepCounters;
+    /// @brief How far each tile's particles moved this step, along whichever axis moved furthest.
+    std::vector<float> m_tileMotion;
+    /// @brief The bounds of each sleeping tile's particles, radii included, as min X, Y, Z then max
+    /// X, Y, Z; taken when the tile fell asleep, since it doesn't move until it wakes.
+    std::vector<float> m_tileBounds;
+    /// @brief The tiles each tile shares a spring with, in compressed rows: tile t's are
+    /// m_tileNeighbours[m_tileNeighbourOffsets[t]] up to m_tileNeighbourOffsets[t+1].
+    std::vector<uint32_t> m_tileNeighbourOffsets, m_tileNeighbours;
+    /// @brief Scratch space for the tiles that have just been still for long enough to sleep.
+    std::vector<unsigned int> m_fallingAsleep;
+    /// @brief Whether m_tileNeighbours matches the current springs.
+    bool m_hasSleepTopology;
+    /// @brief Whether any tile may be asleep during this step.
+    bool m_isSleeping;
+
+    /// @brief The tasks making up a step; rebuilt by every advance(), reusing its memory.
+    TaskGraph m_graph;
+    /// @brief While advance() builds m_graph, the last task to touch each tile of particles.
+    std::vector<unsigned int> m_tileTasks;
+    /// @brief While advance() builds m_graph, the last task to touch the whole cloth at once.
+    unsigned int m_wholeTask;
 };
 
 #endif // SOLVER_H
@@ -0,0 +1,89 @@
+#ifndef SPARSEBLOCKMATRIX_H
+#define SPARSEBLOCKMATRIX_H
+
+#include "Common.h"
+#include <vector>
+
+/// @file SparseBlockMatrix.h
+/// @brief Source file for the SparseBlockMatrix class used by the Solver's implicit mode.
+/// @author Robert Poncelet
+/// @version 1.0
+/// @date 16/10/26
+/// @class SparseBlockMatrix
+/// @brief A square, symmetric matrix of 3x3 blocks stored in compressed sparse row form, with one
+/// row of blocks per particle. The sparsity pattern comes from the springs: a particle's row has a
+/// block on the diagonal and one for every particle a spring connects it to. The pattern is built
+/// once and then reused, only the values being cleared and reassembled each step, and each spring
+/// remembers where its off-diagonal blocks are so assembly never has to search for them.
+
+class SparseBlockMatrix
+{
+public:
+    /// @brief Constructor for the SparseBlockMatrix class; the matrix starts with no rows.
+    SparseBlockMatrix();
+
+    /// @brief Destructor for the SparseBlockMatrix class.
+    ~SparseBlockMatrix();
+
+    /// @brief Works out the sparsity pattern for the specified particles and springs, replacing any
+    /// previous one. All the blocks start at zero.
+    /// @param[in] _rowNum How many particles (and so rows and columns of blocks) there are.
+    /// @param[in] _springs The springs connecting the particles.
+    void buildPattern(const unsigned int &_rowNum, const CS::SpringStore* _springs);
+
+    /// @brief Sets every block to zero, keeping the pattern.
+    void clear();
+
+    /// @brief Returns how many rows of blocks the matrix has.
+    unsigned int getRowNum() const                              {return m_rowNum;}
+
+    /// @brief Returns how many blocks (including zero ones) are stored.
+    unsigned int getBlockNum() const                            {return (unsigned int)m_columns.size();}
+
+    /// @brief Returns the 9 values, row by row, of the diagonal block of the specified row.
+    /// @param[in] _row The row in question.
+    float* getDiagonalBlock(const unsigned int &_row)           {return &m_values[9 * m_diagonal[_row]];}
+
+    /// @brief The same as above, but read-only.
+    const float* getDiagonalBlock(const unsigned int &_row) const   {return &m_values[9 * m_diagonal[_row]];}
+
+    /// @brief Returns the block in the start particle's row and end particle's column for the
+    /// specified spring.
+    /// @param[in] _spring The index of the spring in the store the pattern was built from.
+    float* getUpperBlock(const unsigned int &_spring)           {return &m_values[9 * m_springBlocks[2 * _spring]];}
+
+    /// @brief Returns the block in the end particle's row and start particle's column for the
+    /// specified spring; the transpose of getUpperBlock().
+    /// @param[in] _spring The index of the spring in the store the pattern was built from.
+    float* getLowerBlock(const unsigned int &_spring)           {return &m_values[9 * m_springBlocks[2 * _spring + 1]];}
+
+    /// @brief Multiplies a range of the matrix's rows by a vector: _result = A * _vector for those
+    /// rows only, so ranges can be handed out to different threads.
+    /// @param[in] _vector The vector to multiply by, with 3 floats per row.
+    /// @param[out] _result Where to write the product, with 3 floats per row.
+    /// @param[in] _begin The first row to multiply.
+    /// @param[in] _end One past the last row to multiply.
+    void multiply(const float* _vector, float* _result, const unsigned int &_begin, const unsigned int &_end) const;
+
+private:
+    /// @brief Returns the index of the block at the specified row and column, which must be part
+    /// of the pattern.
+    /// @param[in] _row The row of the block.
+    /// @param[in] _column The column of the block.
+    unsigned int findBlock(const unsigned int &_row, const unsigned int &_column) const;
+
+    /// @brief How many rows of blocks there are.
+    unsigned int m_rowNum;
+    /// @brief Where each row's blocks start in m_columns and m_values, plus one past the end.
+    std::vector<unsigned int> m_rowOffsets;
+    /// @brief The column of each block.
+    std::vector<unsigned int> m_columns;
+    /// @brief The 9 values of each block, row by row.
+    std::vector<float> m_values;
+    /// @brief The index of each row's diagonal block.
+    std::vector<unsigned int> m_diagonal;
+    /// @brief The index of each spring's upper and lower off-diagonal blocks, in pairs.
+    std::vector<unsigned int> m_springBlocks;
+};
+
+#endif // SPARSEBLOCKMATRIX_H
@@ -0,0 +1,77 @@
+#ifndef SPATIALHASH_H
+#define SPATIALHASH_H
+
+#include <vector>
+
+class FrameArena;
+
+/// @file SpatialHash.h
+/// @brief Source file for the SpatialHash class used by the Solver's self-collision broadphase.
+/// @author Robert Poncelet
+/// @version 1.0
+/// @date 16/10/26
+/// @class SpatialHash
+/// @brief A uniform grid hashed into a fixed number of buckets. Points are binned into cells the
+/// size of the largest collision distance, so any pair that could be colliding is guaranteed to be
+/// in the same or an adjacent cell. It is rebuilt from scratch every simulation step.
+
+class SpatialHash
+{
+public:
+    /// @brief Constructor for the SpatialHash class.
+    SpatialHash();
+
+    /// @brief Destructor for the SpatialHash class.
+    ~SpatialHash();
+
+    /// @brief Bins a set of points into the hash table, replacing whatever was there before.
+    /// @param[in] _x A pointer to the X component of the first point.
+    /// @param[in] _y A pointer to the Y component of the first point.
+    /// @param[in] _z A pointer to the Z component of the first point.
+    /// @param[in] _stride How many floats apart consecutive points are in memory.
+    /// @param[in] _count How many points there are.
+    /// @param[in] _cellSize The width of a grid cell; should be at least the largest distance at
+    /// which two points can interact.
+    /// @param[in,out] _scratch Where the counters for the sort are taken from; they are only needed
+    /// while this runs.
+    void build(const float *_x, const float *_y, const float *_z, const unsigned int &_stride, const unsigned int &_count, const float &_cellSize, FrameArena &_scratch);
+
+    /// @brief Fills the specified vector with the indices of every point that could be within one
+    /// cell of the specified position, i.e. the contents of the 27 surrounding cells. The point
+    /// itself is included if it was part of the build.
+    /// @param[in] _x The X component of the position to query.
+    /// @param[in] _y The Y component of the position to query.
+    /// @param[in] _z The Z component of the position to query.
+    /// @param[out] _result The vector to fill; it is cleared first.
+    void query(const float &_x, const float &_y, const float &_z, std::vector<unsigned int> &_result) const;
+
+    /// @brief Returns the number of buckets in the table.
+    unsigned int getBucketCount() const     {return (unsigned int)m_bucketStart.size() - 1;}
+
+private:
+    /// @brief Returns the cell co-ordinate along one axis for the specified position component.
+    /// @param[in] _p The position component.
+    int cellCoord(const float &_p) const;
+
+    /// @brief Returns the bucket that the specified cell hashes into.
+    /// @param[in] _x The X co-ordinate of the cell.
+    /// @param[in] _y The Y co-ordinate of the cell.
+    /// @param[in] _z The Z co-ordinate of the cell.
+    unsigned int bucketOf(const int &_x, const int &_y, const int &_z) const;
+
+    /// @brief The width of a single grid cell.
+    float m_cellSize;
+    /// @brief One over the cell width, to save a division per point.
+    float m_inverseCellSize;
+    /// @brief One less than the number of buckets, which is always a power of two.
+    unsigned int m_bucketMask;
+    /// @brief Where each bucket's points begin in m_sortedIndices; the extra last entry is the
+    /// total number of points, so bucket b spans [m_bucketStart[b], m_bucketStart[b+1]).
+    std::vector<unsigned int> m_bucketStart;
+    /// @brief The point indices, grouped by bucket.
+    std::vector<unsigned int> m_sortedIndices;
+    /// @brief The bucket each point was placed in during the last build.
+    std::vector<unsigned int> m_pointBucket;
+};
+
+#endif // SPATIALHASH_H
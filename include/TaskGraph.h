@@ -0,0 +1,142 @@
+#ifndef TASKGRAPH_H
+#define TASKGRAPH_H
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/// @file TaskGraph.h
+/// @brief Source file for the TaskGraph class describing work for the ThreadPool to run.
+/// @author Robert Poncelet
+/// @version 1.0
+/// @date 16/10/26
+/// @class TaskGraph
+/// @brief A set of tasks and the order they have to run in, handed to ThreadPool::run(). Each task
+/// covers a range of indices which the pool splits into chunks, so one task can be a whole phase
+/// of the simulation or just one tile of it; a task only starts once every task it depends on has
+/// finished. Graphs are meant to be rebuilt every step, so clear() keeps the memory already
+/// allocated for the tasks.
+
+class TaskGraph
+{
+public:
+    /// @brief The type of function a task runs; it is given a half-open range of indices.
+    typedef std::function<void(unsigned int, unsigned int)> RangeFunction;
+
+    /// @brief Constructor for the TaskGraph class; the graph starts empty.
+    TaskGraph() : m_nodeNum(0), m_stateSize(0), m_unfinished(0) {;}
+
+    /// @brief Adds a task that calls _function once.
+    /// @param[in] _function The function to run.
+    /// @return The task's index, for use with addDependency().
+    unsigned int addTask(const std::function<void()> &_function)
+    {
+        return addRange(0, 1, 1, [_function](unsigned int, unsigned int) {_function();});
+    }
+
+    /// @brief Adds a task that calls _function on consecutive chunks of [_begin, _end), which may
+    /// run on different threads at once. An empty range still counts as a task, finishing as soon
+    /// as it starts.
+    /// @param[in] _begin The first index to process.
+    /// @param[in] _end One past the last index to process.
+    /// @param[in] _grain How many indices to hand to a thread at once.
+    /// @param[in] _function The function to run on each chunk.
+    /// @return The task's index, for use with addDependency().
+    unsigned int addRange(const unsigned int &_begin, const unsigned int &_end, const unsigned int &_grain, const RangeFunction &_function)
+    {
+        if (m_nodeNum == m_nodes.size())
+        {
+            m_nodes.push_back(Node());
+        }
+
+        Node &node = m_nodes[m_nodeNum];
+        node.m_function = _function;
+        node.m_begin = _begin;
+        node.m_end = std::max(_begin, _end);
+        node.m_grain = std::max(1u, _grain);
+        node.m_dependencyNum = 0;
+        node.m_successors.clear();
+        return m_nodeNum++;
+    }
+
+    /// @brief Makes one task wait for another to finish before it starts.
+    /// @param[in] _before The task that has to finish first.
+    /// @param[in] _after The task that has to wait for it.
+    void addDependency(const unsigned int &_before, const unsigned int &_after)
+    {
+        m_nodes[_before].m_successors.push_back(_after);
+        ++m_nodes[_after].m_dependencyNum;
+    }
+
+    /// @brief Removes all the tasks.
+    void clear()                        {m_nodeNum = 0;}
+
+    /// @brief Returns how many tasks there are.
+    unsigned int size() const           {return m_nodeNum;}
+
+    /// @brief Returns whether there are no tasks.
+    bool empty() const                  {return m_nodeNum == 0;}
+
+private:
+    friend class ThreadPool;
+
+    /// @brief Not copyable.
+    TaskGraph(const TaskGraph &);
+
+    /// @brief Not assignable.
+    TaskGraph& operator=(const TaskGraph &);
+
+    /// @brief One task.
+    struct Node
+    {
+        /// @brief The function run on each chunk.
+        RangeFunction m_function;
+        /// @brief The first index of the task's range.
+        unsigned int m_begin;
+        /// @brief One past the last index of the task's range.
+        unsigned int m_end;
+        /// @brief How many indices make up each chunk.
+        unsigned int m_grain;
+        /// @brief How many tasks this one waits for.
+        unsigned int m_dependencyNum;
+        /// @brief The tasks waiting for this one.
+        std::vector<unsigned int> m_successors;
+
+        /// @brief Returns how many chunks the task is split into; always at least one.
+        unsigned int getChunkNum() const    {return m_end > m_begin ? (m_end - m_begin + m_grain - 1) / m_grain : 1;}
+    };
+
+    /// @brief Sizes and fills in the counters ThreadPool::run() uses while the graph runs.
+    void prepare()
+    {
+        if (m_stateSize < m_nodeNum)
+        {
+            m_waiting.reset(new std::atomic<unsigned int>[m_nodeNum]);
+            m_chunksLeft.reset(new std::atomic<unsigned int>[m_nodeNum]);
+            m_stateSize = m_nodeNum;
+        }
+        for (unsigned int i = 0; i < m_nodeNum; ++i)
+        {
+            m_waiting[i] = m_nodes[i].m_dependencyNum;
+            m_chunksLeft[i] = m_nodes[i].getChunkNum();
+        }
+        m_unfinished = m_nodeNum;
+    }
+
+    /// @brief The tasks; only the first m_nodeNum are in use, the rest are kept for reuse.
+    std::vector<Node> m_nodes;
+    /// @brief How many tasks are in use.
+    unsigned int m_nodeNum;
+    /// @brief For each task while running, how many of the tasks it waits for haven't finished.
+    std::unique_ptr<std::atomic<unsigned int>[]> m_waiting;
+    /// @brief For each task while running, how many of its chunks haven't finished.
+    std::unique_ptr<std::atomic<unsigned int>[]> m_chunksLeft;
+    /// @brief How many tasks m_waiting and m_chunksLeft have room for.
+    unsigned int m_stateSize;
+    /// @brief How many tasks haven't finished while running.
+    std::atomic<unsigned int> m_unfinished;
+};
+
+#endif // TASKGRAPH_H
@@ -0,0 +1,133 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include "TaskGraph.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// @file ThreadPool.h
+/// @brief Source file for the ThreadPool singleton used to spread the Solver's passes across cores.
+/// @author Robert Poncelet
+/// @version 1.0
+/// @date 16/10/26
+/// @class ThreadPool
+/// @brief A fixed set of worker threads that run TaskGraphs by work stealing. Every thread has its
+/// own queue of chunks: it pushes the chunks of tasks it makes ready onto the back of its queue and
+/// takes its next chunk from there too, and when its queue runs dry it steals from the front of
+/// someone else's. A task's successors are queued by whichever thread finishes its last chunk, so
+/// idle threads move on to the next phase of the work without waiting for the rest of the current
+/// one. Workers are created once and sleep while there is nothing queued. The thread that calls
+/// run() or parallelFor() works through the graph too rather than waiting, so a pool with a thread
+/// count of one simply runs everything in place, and jobs can be nested inside each other.
+
+class ThreadPool
+{
+public:
+    /// @brief The type of function run by parallelFor(); it is given a half-open range of indices.
+    typedef TaskGraph::RangeFunction RangeFunction;
+
+    /// @brief Returns the single, shared instance of the pool, creating it on first use.
+    static ThreadPool* instance();
+
+    /// @brief Sets how many threads (including the calling one) run each job. Zero means one per
+    /// hardware core; one means everything runs on the calling thread.
+    /// @param[in] _count The number of threads to use.
+    void setThreadCount(const unsigned int &_count);
+
+    /// @brief Returns how many threads (including the calling one) run each job.
+    unsigned int getThreadCount() const     {return (unsigned int)m_workers.size() + 1;}
+
+    /// @brief Runs every task in the specified graph, each once all the tasks it depends on have
+    /// finished, and returns once they all have. May be called from inside a task.
+    /// @param[in,out] _graph The tasks to run; it can be run again or cleared afterwards.
+    void run(TaskGraph &_graph);
+
+    /// @brief Calls _function on consecutive chunks of [_begin, _end) spread across the pool, and
+    /// returns once they have all been processed. Ranges no bigger than one chunk are run directly
+    /// on the calling thread. May be called from inside a task.
+    /// @param[in] _begin The first index to process.
+    /// @param[in] _end One past the last index to process.
+    /// @param[in] _grain How many indices to hand to a thread at once.
+    /// @param[in] _function The function to run on each chunk.
+    void parallelFor(const unsigned int &_begin, const unsigned int &_end, const unsigned int &_grain, const RangeFunction &_function);
+
+private:
+    /// @brief One chunk of a task, as queued.
+    struct Chunk
+    {
+        /// @brief The graph the task belongs to.
+        TaskGraph *m_graph;
+        /// @brief The index of the task in the graph.
+        unsigned int m_node;
+        /// @brief The first index of the chunk.
+        unsigned int m_begin;
+        /// @brief One past the last index of the chunk.
+        unsigned int m_end;
+    };
+
+    /// @brief A thread's queue of chunks; the owner uses the back and thieves the front.
+    struct Queue
+    {
+        /// @brief Protects the chunks.
+        std::mutex m_mutex;
+        /// @brief The chunks waiting to run.
+        std::deque<Chunk> m_chunks;
+    };
+
+    /// @brief Constructor for the ThreadPool class; starts one worker per hardware core.
+    ThreadPool();
+
+    /// @brief Destructor for the ThreadPool class; stops and joins all the workers.
+    ~ThreadPool();
+
+    /// @brief Not copyable.
+    ThreadPool(const ThreadPool &);
+
+    /// @brief Not assignable.
+    ThreadPool& operator=(const ThreadPool &);
+
+    /// @brief The loop each worker runs until the pool is stopped.
+    /// @param[in] _slot The index of the worker's queue.
+    void workerLoop(unsigned int _slot);
+
+    /// @brief Queues every chunk of the specified task on the specified thread's queue and wakes
+    /// the workers.
+    /// @param[in] _slot The queue to add the chunks to.
+    /// @param[in] _graph The graph the task belongs to.
+    /// @param[in] _node The index of the task.
+    void push(const unsigned int &_slot, TaskGraph *_graph, const unsigned int &_node);
+
+    /// @brief Takes a chunk from the back of the specified thread's queue or, failing that, steals
+    /// one from the front of another's, and runs it.
+    /// @param[in] _slot The queue of the thread doing the work.
+    /// @return Whether there was a chunk to run.
+    bool runOne(const unsigned int &_slot);
+
+    /// @brief Stops and joins all the workers.
+    void stopWorkers();
+
+    /// @brief The worker threads; the thread calling run() is not one of these.
+    std::vector<std::thread> m_workers;
+    /// @brief One queue per thread: the first is shared by threads outside the pool, and worker i
+    /// uses queue i + 1.
+    std::vector<std::unique_ptr<Queue> > m_queues;
+    /// @brief Serialises calls to run() from threads outside the pool, and changes to the thread
+    /// count.
+    std::recursive_mutex m_callMutex;
+    /// @brief Protects sleeping and waking the workers.
+    std::mutex m_mutex;
+    /// @brief Signalled when chunks are queued or the pool is shutting down.
+    std::condition_variable m_wakeCondition;
+    /// @brief How many chunks are queued across all the queues.
+    std::atomic<int> m_queued;
+    /// @brief Whether the workers should exit.
+    bool m_quit;
+};
+
+#endif // THREADPOOL_H
@@ -0,0 +1,131 @@
+#ifndef TOPOLOGYCACHE_H
+#define TOPOLOGYCACHE_H
+
+#include "Common.h"
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/// @file TopologyCache.h
+/// @brief Source file for the TopologyCache singleton that keeps the springs generated for each
+/// size of cloth.
+/// @author Robert Poncelet
+/// @version 1.0
+/// @date 16/10/26
+/// @class TopologyCache
+/// @brief Which particles a cloth's springs join, their rest lengths, their colouring and the mesh
+/// drawn over the particles all depend on nothing but the cloth's resolution, block size and
+/// dimensions, yet Cloth::reset() used to work them all out again every time. The cache keeps the
+/// most recently used ones in memory, and optionally in a directory on disk so that batch jobs at
+/// the same size share them too. Entries are never changed once made, so they are handed out as
+/// shared pointers and stay valid however long the caller holds them, even after being evicted.
+/// The cache is shared between the simulation and drawing threads, so every call locks it.
+
+class TopologyCache
+{
+public:
+    /// @brief Everything about a cloth's springs and mesh that only depends on its size.
+    struct Topology
+    {
+        /// @brief How many particles the cloth has along each axis.
+        int m_widthNum, m_heightNum;
+        /// @brief The size of the blocks the particles are stored in; see Cloth::getParticleIndex().
+        int m_blockSize;
+        /// @brief The dimensions of the cloth at rest, which the springs' rest lengths come from.
+        float m_width, m_height;
+        /// @brief The springs, sorted by colour; see CS::SpringStore::sortByColour().
+        std::vector<CS::Spring> m_springs;
+        /// @brief Where each colour of spring starts, as in CS::SpringStore.
+        std::vector<uint32_t> m_colourOffsets;
+        /// @brief Which springs are attached to each particle, as in CS::SpringStore.
+        std::vector<uint32_t> m_incidentOffsets, m_incidentSprings;
+        /// @brief The triangles drawn over the particles, as Cloth::getIndices() makes them.
+        std::vector<GLuint> m_indices;
+
+        /// @brief Returns whether this is the topology of a cloth of the specified size.
+        bool matches(const int &_widthNum, const int &_heightNum, const int &_blockSize, const float &_width, const float &_height) const
+        {
+            return m_widthNum == _widthNum && m_heightNum == _heightNum && m_blockSize == _blockSize && m_width == _width && m_height == _height;
+        }
+    };
+
+    /// @brief Returns the single, shared instance of the cache, creating it on first use.
+    static TopologyCache* instance();
+
+    /// @brief Returns the topology of a cloth of the specified size, from memory or else from the
+    /// cache's directory, or null if it hasn't been made yet.
+    /// @param[in] _widthNum How many particles the cloth has along its X axis.
+    /// @param[in] _heightNum How many particles the cloth has along its Y axis.
+    /// @param[in] _blockSize The size of the blocks the particles are stored in.
+    /// @param[in] _width The width of the cloth at rest.
+    /// @param[in] _height The height of the cloth at rest.
+    std::shared_ptr<const Topology> find(const int &_widthNum, const int &_heightNum, const int &_blockSize, const float &_width, const float &_height);
+
+    /// @brief Returns a topology in memory for the specified resolution and block size, whatever its
+    /// dimensions, or null if there isn't one; the drawing side only needs its indices, which don't
+    /// depend on the dimensions.
+    /// @param[in] _widthNum How many particles the cloth has along its X axis.
+    /// @param[in] _heightNum How many particles the cloth has along its Y axis.
+    /// @param[in] _blockSize The size of the blocks the particles are stored in.
+    std::shared_ptr<const Topology> findResolution(const int &_widthNum, const int &_heightNum, const int &_blockSize);
+
+    /// @brief Adds a newly made topology as the most recently used, evicting the least recently
+    /// used if the cache is full, and writes it to the cache's directory if there is one.
+    /// @param[in] _topology The topology to add.
+    void insert(const std::shared_ptr<const Topology> &_topology);
+
+    /// @brief Sets how many topologies are kept in memory, evicting any over the new limit.
+    /// @param[in] _capacity The number of topologies to keep, at least 1.
+    void setCapacity(const unsigned int &_capacity);
+
+    /// @brief Sets the directory topologies are saved to and looked for in when they aren't in
+    /// memory; an empty path, the default, keeps them in memory only. The directory must exist.
+    /// @param[in] _directory The directory to use.
+    void setDirectory(const std::string &_directory);
+
+    /// @brief Forgets every topology in memory; those on disk are left alone.
+    void clear();
+
+    /// @brief Returns how many calls to find() have been answered without making a new topology.
+    unsigned int getHitCount() const;
+
+    /// @brief Returns how many calls to find() have come back empty.
+    unsigned int getMissCount() const;
+
+private:
+    /// @brief The constructor is private; use instance().
+    TopologyCache();
+
+    /// @brief Returns the file in the cache's directory for a cloth of the specified size.
+    std::string getPath(const int &_widthNum, const int &_heightNum, const int &_blockSize, const float &_width, const float &_height) const;
+
+    /// @brief Reads a topology written by save(), or returns null if it can't.
+    /// @param[in] _path The file to read.
+    static std::shared_ptr<const Topology> load(const std::string &_path);
+
+    /// @brief Writes a topology to the specified file, via a temporary file of this writer's own so
+    /// that other jobs sharing the directory never read one half-written, even if they are
+    /// writing the same topology at the same time.
+    /// @param[in] _topology The topology to write.
+    /// @param[in] _path Where to write it.
+    /// @return Whether the file was written successfully.
+    static bool save(const Topology &_topology, const std::string &_path);
+
+    /// @brief Adds a topology to the front of m_entries, evicting from the back; the caller must
+    /// hold m_mutex.
+    void push(const std::shared_ptr<const Topology> &_topology);
+
+    /// @brief Protects everything below.
+    mutable std::mutex m_mutex;
+    /// @brief The topologies in memory, most recently used first.
+    std::list<std::shared_ptr<const Topology> > m_entries;
+    /// @brief How many topologies m_entries may hold.
+    unsigned int m_capacity;
+    /// @brief Where topologies are kept on disk, or empty for nowhere.
+    std::string m_directory;
+    /// @brief How many calls to find() have found a topology, and how many haven't.
+    unsigned int m_hits, m_misses;
+};
+
+#endif // TOPOLOGYCACHE_H
@@ -0,0 +1,111 @@
+#ifndef UPLOADRING_H
+#define UPLOADRING_H
+
+#include <ngl/Types.h>
+
+//how many copies of the data are kept, so the CPU can fill one while the GPU still reads the others
+#define UPLOAD_RING_SLOTS 3
+
+/// @file UploadRing.h
+/// @brief Source file for the UploadRing class that streams the particle positions to the GPU.
+/// @author Robert Poncelet
+/// @version 1.0
+/// @date 16/10/26
+/// @class UploadRing
+/// @brief A ring of buffer objects, each wrapped in its own buffer texture, that data is written
+/// into directly without any intermediate copy. Each frame writes into the next slot in the ring
+/// while the GPU may still be drawing from the previous ones; a fence placed after the frame's draw
+/// calls tells us when a slot is free to be written again. Where ARB_buffer_storage is available
+/// the buffers stay mapped for their whole lifetime, otherwise each slot is mapped unsynchronised
+/// just for the write. Requires a current GL context for everything but construction.
+
+class UploadRing
+{
+public:
+    /// @brief Constructor for the UploadRing class; creates no GL objects until create() is called.
+    UploadRing();
+
+    /// @brief Destructor for the UploadRing class. The GL objects must already have been released
+    /// with destroy(), since there may be no context by now.
+    ~UploadRing();
+
+    /// @brief (Re)creates the buffers and their textures, releasing any previous ones first.
+    /// @param[in] _bytes The size of each slot in bytes.
+    /// @param[in] _textureFormat The sized internal format the buffer textures read the data as,
+    /// e.g. GL_RGBA32F.
+    void create(const GLsizeiptr &_bytes, const GLenum &_textureFormat);
+
+    /// @brief Releases all the buffers, textures and fences.
+    void destroy();
+
+    /// @brief Moves on to the next slot, waiting for the GPU to finish with it if need be, and
+    /// returns a pointer to write the new data into. Must be followed by endWrite().
+    /// @param[in] _partial Whether only parts of the slot will be written, each one passed to
+    /// flushRange() afterwards, with the rest keeping whatever the slot held before. Otherwise the
+    /// whole slot must be written and its old contents are thrown away.
+    void* beginWrite(const bool &_partial = false);
+
+    /// @brief Sends one part of a partial write on to the GPU; only these parts are transferred
+    /// when the buffers have to be mapped for each write.
+    /// @param[in] _offset Where the part starts, in bytes from the start of the slot.
+    /// @param[in] _bytes The size of the part.
+    void flushRange(const GLintptr &_offset, const GLsizeiptr &_bytes);
+
+    /// @brief Finishes the write started by beginWrite(); the slot written becomes the current one.
+    void endWrite();
+
+    /// @brief Returns the slot the next beginWrite() will write to, so the caller can work out what
+    /// it holds already.
+    unsigned int getNextSlot() const    {return (m_current + 1) % UPLOAD_RING_SLOTS;}
+
+    /// @brief Marks the point in the command stream after which the GPU no longer needs the current
+    /// slot; call this after the last draw call that reads it each frame.
+    void fence();
+
+    /// @brief Returns the buffer object of the current slot.
+    GLuint getBuffer() const        {return m_buffers[m_current];}
+
+    /// @brief Returns the buffer texture wrapping the current slot.
+    GLuint getTexture() const       {return m_textures[m_current];}
+
+    /// @brief Returns the size of each slot in bytes.
+    GLsizeiptr getSize() const      {return m_bytes;}
+
+    /// @brief Returns whether the buffers are persistently mapped rather than mapped every write.
+    bool isPersistent() const       {return m_isPersistent;}
+
+private:
+    /// @brief Not copyable.
+    UploadRing(const UploadRing &);
+
+    /// @brief Not assignable.
+    UploadRing& operator=(const UploadRing &);
+
+    /// @brief Returns whether the current context can create persistently mapped buffers.
+    static bool supportsPersistentMapping();
+
+    /// @brief Blocks until the GPU has passed the fence on the specified slot, then removes it.
+    /// @param[in] _slot The slot to wait for.
+    void waitForSlot(const unsigned int &_slot);
+
+    /// @brief The buffer object of each slot.
+    GLuint m_buffers[UPLOAD_RING_SLOTS];
+    /// @brief The buffer texture wrapping each slot.
+    GLuint m_textures[UPLOAD_RING_SLOTS];
+    /// @brief The fence placed after the last frame that read each slot, or null if there is none.
+    GLsync m_fences[UPLOAD_RING_SLOTS];
+    /// @brief Where each slot is mapped into our address space when persistent mapping is used.
+    void *m_mapped[UPLOAD_RING_SLOTS];
+    /// @brief The size of each slot in bytes.
+    GLsizeiptr m_bytes;
+    /// @brief The slot holding the most recently written data.
+    unsigned int m_current;
+    /// @brief Whether the buffers are persistently mapped.
+    bool m_isPersistent;
+    /// @brief Whether the write in progress is a partial one.
+    bool m_isPartial;
+    /// @brief Whether the GL objects currently exist.
+    bool m_isCreated;
+};
+
+#endif // UPLOADRING_H
@@ -13,6 +13,8 @@ uniform samplerBuffer vertPositions;
 uniform int widthNum;
 /// @brief[in] The height of the texture.
 uniform int heightNum;
+/// @brief[in] The size of the blocks the particles are stored in; see Cloth::getParticleIndex().
+uniform int blockSize;
 
 /// @brief[out] The final fragment colour.
 layout (location = 0) out vec4 outColour;
@@ -22,7 +24,12 @@ vec3 positionAt(int x, int y)
 {
     x = clamp(x, 0, widthNum-1);
     y = clamp(y, 0, heightNum-1);
-    int index = x + (y * widthNum);
+    int blockX = x / blockSize;
+    int blockY = y / blockSize;
+    int bandHeight = min(blockSize, heightNum - blockY * blockSize);
+    int blockWidth = min(blockSize, widthNum - blockX * blockSize);
+    int index = blockY * blockSize * widthNum + blockX * blockSize * bandHeight
+              + (y - blockY * blockSize) * blockWidth + (x - blockX * blockSize);
     return vec3(texelFetch(vertPositions, index));
 }
 
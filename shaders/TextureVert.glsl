@@ -7,12 +7,8 @@
 
 /// @brief MVP passed from app
 uniform mat4 MVP;
-// first attribute the vertex values from our VAO
-layout (location=0) in vec3 inVert;
-//layout (location=0) in int widthNum;
-// second attribute the UV values from our VAO
-layout (location=1)in float inIndex;
-//layout (location=1)in int heightNum;
+// there are no vertex attributes; each vertex's index is its particle's, and the position comes
+// from vertPositions
 // normals for lighting
 //layout (location = 2) in vec3 inNormal;
 // we use this to pass the UV values to the frag shader
@@ -59,18 +55,26 @@ uniform mat4 M;
 
 uniform int widthNum;
 uniform int heightNum;
+uniform int blockSize;
 
 vec3 positionAt(int x, int y)
 {
     x = clamp(x, 0, widthNum-1);
     y = clamp(y, 0, heightNum-1);
-    int index = x + (y * widthNum);
+    //same as Cloth::getParticleIndex()
+    int blockX = x / blockSize;
+    int blockY = y / blockSize;
+    int bandHeight = min(blockSize, heightNum - blockY * blockSize);
+    int blockWidth = min(blockSize, widthNum - blockX * blockSize);
+    int index = blockY * blockSize * widthNum + blockX * blockSize * bandHeight
+              + (y - blockY * blockSize) * blockWidth + (x - blockX * blockSize);
     return vec3(texelFetch(vertPositions, index));
 }
 
 void main()
 {
-    int index = int(inIndex);
+    //for an indexed draw this is the index itself, i.e. which particle this is
+    int index = gl_VertexID;
 
     vertPos = texelFetch(vertPositions, index).rgb;
 
@@ -94,8 +98,15 @@ void main()
     halfVector = normalize(eyeDirection + lightDir);
 
     //calculate normals here for now because OpenGL is refusing to render to framebuffers
-        int x = index % widthNum;
-        int y = index / widthNum;
+        //same as Cloth::getParticleCoords()
+        int blockY = index / (blockSize * widthNum);
+        int remainder = index - blockY * blockSize * widthNum;
+        int bandHeight = min(blockSize, heightNum - blockY * blockSize);
+        int blockX = remainder / (blockSize * bandHeight);
+        remainder -= blockX * blockSize * bandHeight;
+        int blockWidth = min(blockSize, widthNum - blockX * blockSize);
+        int x = blockX * blockSize + remainder % blockWidth;
+        int y = blockY * blockSize + remainder / blockWidth;
 
         vec3 thisPos        = positionAt(x  ,y  );
 
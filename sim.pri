@@ -0,0 +1,62 @@
+# The simulation core shared by the command-line tools; none of these files need Qt or a GL
+# context, only NGL for its maths types. cloth.pro picks them up through its src/*.cpp glob.
+SOURCES+= $$PWD/src/Cloth.cpp \
+          $$PWD/src/ClothCommand.cpp \
+          $$PWD/src/ClothFile.cpp \
+          $$PWD/src/FrameArena.cpp \
+          $$PWD/src/Integrator.cpp \
+          $$PWD/src/PackedPoints.cpp \
+          $$PWD/src/PointCacheReader.cpp \
+          $$PWD/src/PointCacheWriter.cpp \
+          $$PWD/src/Replay.cpp \
+          $$PWD/src/Solver.cpp \
+          $$PWD/src/SparseBlockMatrix.cpp \
+          $$PWD/src/SpatialHash.cpp \
+          $$PWD/src/ThreadPool.cpp \
+          $$PWD/src/TopologyCache.cpp
+HEADERS+= $$PWD/include/Cloth.h \
+          $$PWD/include/ClothCommand.h \
+          $$PWD/include/ClothFile.h \
+          $$PWD/include/Common.h \
+          $$PWD/include/FrameArena.h \
+          $$PWD/include/Integrator.h \
+          $$PWD/include/PackedPoints.h \
+          $$PWD/include/PointCache.h \
+          $$PWD/include/PointCacheReader.h \
+          $$PWD/include/PointCacheWriter.h \
+          $$PWD/include/Replay.h \
+          $$PWD/include/Solver.h \
+          $$PWD/include/SparseBlockMatrix.h \
+          $$PWD/include/SpatialHash.h \
+          $$PWD/include/TaskGraph.h \
+          $$PWD/include/ThreadPool.h \
+          $$PWD/include/TopologyCache.h
+INCLUDEPATH += $$PWD/include
+DEPENDPATH+= $$PWD/include
+# the solver uses std::thread for its parallel passes
+CONFIG += c++11 thread
+
+QMAKE_CXXFLAGS_WARN_ON += "-Wno-unused-parameter"
+QMAKE_CXXFLAGS+= -msse -msse2 -msse3
+macx:QMAKE_CXXFLAGS+= -arch x86_64
+macx:INCLUDEPATH+=/usr/local/include/
+linux-*{
+                linux-*:QMAKE_CXXFLAGS +=  -march=native
+                DEFINES += LINUX
+}
+macx:DEFINES += DARWIN
+
+# add the ngl lib
+unix:LIBS += -L/usr/local/lib
+unix:LIBS +=  -L/$(HOME)/NGL/lib -l NGL
+INCLUDEPATH += $$(HOME)/NGL/include/
+
+win32: {
+        PRE_TARGETDEPS+=C:/NGL/lib/NGL.lib
+        DEFINES+=GL42
+        DEFINES += WIN32
+        DEFINES+=_WIN32
+        DEFINES+=_USE_MATH_DEFINES
+        LIBS += -LC:/NGL/lib/ -lNGL
+        DEFINES+=NO_DLL
+}
@@ -1,11 +1,14 @@
 #include "Cloth.h"
+#include "TopologyCache.h"
+#include <algorithm>
+#include <cmath>
 #define WIDTH 2.56f
 #define HEIGHT 1.636f
 #define SPRINGCONSTANT 1024.0f
 #define DAMPINGCONSTANT 512.0f
 #define MASS 1.0f
 
-Cloth::Cloth() : m_sphere(0, 1.0f, 1.0f, ngl::Vec3(0.0f, 0.0f, -2.0f)), m_isPaused(false), m_widthNum(16), m_heightNum(16)
+Cloth::Cloth() : m_sphere(0, 1.0f, 1.0f, ngl::Vec3(0.0f, 0.0f, -2.0f)), m_isPaused(false), m_widthNum(16), m_heightNum(16), m_blockSize(1), m_width(WIDTH), m_height(HEIGHT), m_timestep(0.01f), m_substeps(1), m_maxStepsPerUpdate(4), m_accumulator(0.0), m_simTime(0.0)
 {
     CS::ClothInfo info;
     info.dampingConstant = 512.0f;
@@ -23,6 +26,11 @@ Cloth::Cloth() : m_sphere(0, 1.0f, 1.0f, ngl::Vec3(0.0f, 0.0f, -2.0f)), m_isPaus
     reset(info);
 }
 
+Cloth::Cloth(const CS::ClothInfo &_info) : m_sphere(0, 1.0f, 1.0f, ngl::Vec3(0.0f, 0.0f, -2.0f)), m_isPaused(false), m_widthNum(_info.widthNum), m_heightNum(_info.heightNum), m_blockSize(std::max(_info.blockSize, 1)), m_width(_info.width), m_height(_info.height), m_timestep(0.01f), m_substeps(1), m_maxStepsPerUpdate(4), m_accumulator(0.0), m_simTime(0.0)
+{
+    reset(_info);
+}
+
 Cloth::~Cloth()
 {
 
@@ -30,7 +38,56 @@ Cloth::~Cloth()
 
 void Cloth::advance(const double &_time, const float &_deltaSeconds)
 {
+    //point the solver at our own sphere every time, in case this cloth is a copy of another one
+    m_solver.m_sphere = &m_sphere;
     m_solver.advance(&m_springs, &m_particles, _time, _deltaSeconds);
+    //the next advance() sweeps the sphere from here
+    m_sphere.m_prevPos = m_sphere.m_pos;
+}
+
+unsigned int Cloth::update(const float &_frameSeconds)
+{
+    //never take on more work than the step limit allows, otherwise a slow frame makes the next
+    //one slower still
+    m_accumulator = std::min(m_accumulator + std::max(_frameSeconds, 0.0f), double(m_timestep) * m_maxStepsPerUpdate);
+
+    unsigned int steps = 0;
+    while (m_accumulator >= m_timestep)
+    {
+        //only the state before the final timestep is needed for interpolation
+        if (m_accumulator < 2.0 * m_timestep)
+        {
+            m_lastPosX = m_particles.m_posX;
+            m_lastPosY = m_particles.m_posY;
+            m_lastPosZ = m_particles.m_posZ;
+        }
+
+        step();
+        m_accumulator -= m_timestep;
+        ++steps;
+    }
+
+    return steps;
+}
+
+void Cloth::step()
+{
+    const float substepSeconds = m_timestep / m_substeps;
+    //share out any move made to the sphere since the last step between the substeps, so each one
+    //only sweeps the cloth against its part of it
+    const ngl::Vec3 sphereStart = m_sphere.m_prevPos;
+    const ngl::Vec3 sphereEnd = m_sphere.m_pos;
+    for (unsigned int i = 0; i < m_substeps; ++i)
+    {
+        m_sphere.m_pos = i + 1 < m_substeps ? sphereStart + (sphereEnd - sphereStart) * (float(i + 1) / m_substeps) : sphereEnd;
+        m_simTime += substepSeconds;
+        advance(m_simTime, substepSeconds);
+    }
+}
+
+float Cloth::getInterpolationAlpha() const
+{
+    return float(m_accumulator / m_timestep);
 }
 
 //NOTE: Particle "co-ordinates" (indices) are referred to in a similar way to pixels in an image
@@ -49,9 +106,9 @@ std::vector<CS::Vert> Cloth::getDrawData(const GLenum &_drawType)
 
         case GL_POINTS:
         {
-            for (std::vector<CS::Particle>::iterator it = m_particles.begin(); it != m_particles.end(); ++it)
+            for (unsigned int i = 0; i < m_particles.size(); ++i)
             {
-                v.p.set((*it).m_pos);
+                v.p.set(m_particles.getPos(i));
                 vec.push_back(v);
             }
             break;
@@ -61,10 +118,10 @@ std::vector<CS::Vert> Cloth::getDrawData(const GLenum &_drawType)
         {
             for (unsigned int i=0; i<m_springs.size(); ++i)
             {
-                    v.p.set(m_springs[i].m_startParticle->m_pos);
+                    v.p.set(m_particles.getPos(m_springs[i].m_startParticle));
                     vec.push_back(v);
 
-                    v.p.set(m_springs[i].m_endParticle->m_pos);
+                    v.p.set(m_particles.getPos(m_springs[i].m_endParticle));
                     vec.push_back(v);
             }
             break;
@@ -85,19 +142,19 @@ std::vector<CS::Vert> Cloth::getDrawData(const GLenum &_drawType)
 
                     //first triangle
                     //top-left
-                    v.p.set(m_particles[PARTICLEINDEX(x,y)].m_pos);
+                    v.p.set(m_particles.getPos(PARTICLEINDEX(x,y)));
                     v.uv.set(ngl::Vec2((float)x/(float)(m_widthNum-1),(float)y/(float)(m_heightNum-1)));
                     v.n.set(normalTopLeft);
                     vec.push_back(v);
 
                     //top-right
-                    v.p.set(m_particles[PARTICLEINDEX((x+1),y)].m_pos);
+                    v.p.set(m_particles.getPos(PARTICLEINDEX((x+1),y)));
                     v.uv.set(ngl::Vec2((float)(x+1)/(float)(m_widthNum-1),(float)y/(float)(m_heightNum-1)));
                     v.n.set(normalTopRight);
                     vec.push_back(v);
 
                     //bottom-left
-                    v.p.set(m_particles[PARTICLEINDEX(x,(y+1))].m_pos);
+                    v.p.set(m_particles.getPos(PARTICLEINDEX(x,(y+1))));
                     v.uv.set(ngl::Vec2((float)x/(float)(m_widthNum-1),(float)(y+1)/(float)(m_heightNum-1)));
                     v.n.set(normalBottomLeft);
                     vec.push_back(v);
@@ -107,13 +164,13 @@ std::vector<CS::Vert> Cloth::getDrawData(const GLenum &_drawType)
                     vec.push_back(v);
 
                     //bottom-right
-                    v.p.set(m_particles[PARTICLEINDEX(x+1,(y+1))].m_pos);
+                    v.p.set(m_particles.getPos(PARTICLEINDEX(x+1,(y+1))));
                     v.uv.set(ngl::Vec2((float)(x+1)/(float)(m_widthNum-1),(float)(y+1)/(float)(m_heightNum-1)));
                     v.n.set(normalBottomRight);
                     vec.push_back(v);
 
                     //top-right
-                    v.p.set(m_particles[PARTICLEINDEX(x+1,y)].m_pos);
+                    v.p.set(m_particles.getPos(PARTICLEINDEX(x+1,y)));
                     v.uv.set(ngl::Vec2((float)(x+1)/(float)(m_widthNum-1),(float)y/(float)(m_heightNum-1)));
                     v.n.set(normalTopRight);
                     vec.push_back(v);
@@ -135,51 +192,162 @@ std::vector<CS::Vert> Cloth::getDrawData(const GLenum &_drawType)
 //should be called every frame
 void Cloth::getPoints(GLfloat _array[])
 {
+    const float *posX = &m_particles.m_posX[0];
+    const float *posY = &m_particles.m_posY[0];
+    const float *posZ = &m_particles.m_posZ[0];
+    const unsigned int particleNum = m_particles.size();
     unsigned int arrayIndex = 0;
-    unsigned int vertIndex = 0;
-    for(std::vector<CS::Particle>::iterator it = m_particles.begin(); it != m_particles.end(); ++it)
+    for(unsigned int i = 0; i < particleNum; ++i)
     {
-        _array[arrayIndex++] = (*it).m_pos.m_x;
-        _array[arrayIndex++] = (*it).m_pos.m_y;
-        _array[arrayIndex++] = (*it).m_pos.m_z;
-        _array[arrayIndex++] = GLfloat(vertIndex++);
+        _array[arrayIndex++] = posX[i];
+        _array[arrayIndex++] = posY[i];
+        _array[arrayIndex++] = posZ[i];
+        _array[arrayIndex++] = GLfloat(i);
     }
 }
 
-unsigned int Cloth::getPointsArraySizeCopy()
+void Cloth::getInterpolatedPoints(GLfloat _array[], const float &_alpha)
 {
-    return (unsigned int)m_particles.size() * 16;
+    const unsigned int particleNum = m_particles.size();
+    if (m_lastPosX.size() != particleNum)
+    {
+        getPoints(_array);
+        return;
+    }
+
+    const float *posX = &m_particles.m_posX[0];
+    const float *posY = &m_particles.m_posY[0];
+    const float *posZ = &m_particles.m_posZ[0];
+    const float *lastX = &m_lastPosX[0];
+    const float *lastY = &m_lastPosY[0];
+    const float *lastZ = &m_lastPosZ[0];
+    unsigned int arrayIndex = 0;
+    for(unsigned int i = 0; i < particleNum; ++i)
+    {
+        _array[arrayIndex++] = lastX[i] + (posX[i] - lastX[i]) * _alpha;
+        _array[arrayIndex++] = lastY[i] + (posY[i] - lastY[i]) * _alpha;
+        _array[arrayIndex++] = lastZ[i] + (posZ[i] - lastZ[i]) * _alpha;
+        _array[arrayIndex++] = GLfloat(i);
+    }
+}
+
+unsigned int Cloth::updateTileVersions(const uint32_t &_version, const float &_tolerance)
+{
+    const unsigned int particleNum = m_particles.size();
+    const unsigned int tileNum = (particleNum + CHANGE_TILE_SIZE - 1) / CHANGE_TILE_SIZE;
+
+    //a different set of particles has nothing to compare against
+    if (m_markedPosX.size() != particleNum)
+    {
+        m_markedPosX = m_particles.m_posX;
+        m_markedPosY = m_particles.m_posY;
+        m_markedPosZ = m_particles.m_posZ;
+        m_tileVersions.assign(tileNum, _version);
+        return tileNum;
+    }
+
+    unsigned int changed = 0;
+    for (unsigned int t = 0; t < tileNum; ++t)
+    {
+        const unsigned int begin = t * CHANGE_TILE_SIZE;
+        const unsigned int end = std::min(begin + CHANGE_TILE_SIZE, particleNum);
+        unsigned int i = begin;
+        for (; i < end; ++i)
+        {
+            if (fabsf(m_particles.m_posX[i] - m_markedPosX[i]) > _tolerance ||
+                fabsf(m_particles.m_posY[i] - m_markedPosY[i]) > _tolerance ||
+                fabsf(m_particles.m_posZ[i] - m_markedPosZ[i]) > _tolerance)
+            {
+                break;
+            }
+        }
+        if (i == end)
+        {
+            continue;
+        }
+
+        //the whole tile is copied on, so remember all of it rather than just what moved
+        std::copy(m_particles.m_posX.begin() + begin, m_particles.m_posX.begin() + end, m_markedPosX.begin() + begin);
+        std::copy(m_particles.m_posY.begin() + begin, m_particles.m_posY.begin() + end, m_markedPosY.begin() + begin);
+        std::copy(m_particles.m_posZ.begin() + begin, m_particles.m_posZ.begin() + end, m_markedPosZ.begin() + begin);
+        m_tileVersions[t] = _version;
+        ++changed;
+    }
+    return changed;
 }
 
-unsigned int Cloth::getPointsArraySizeDirect()
+unsigned int Cloth::getPointsArraySizeCopy()
 {
-    return (unsigned int)m_particles.size() * sizeof(CS::Particle);
+    return (unsigned int)m_particles.size() * 16;
 }
 
 //before calling this function, make sure you have enough memory allocated; getIndicesArraySize() will tell you how many GLuints you need
 //should be called once for each reset()
 void Cloth::getIndices(GLuint _array[])
+{
+    getIndices(_array, m_widthNum, m_heightNum, m_blockSize);
+}
+
+void Cloth::getIndices(GLuint _array[], const int &_widthNum, const int &_heightNum, const int &_blockSize)
 {
     unsigned int index = 0;
-    for(GLuint y = 0; y < (GLuint)m_heightNum - 1; ++y)
+    for(int y = 0; y < _heightNum - 1; ++y)
     {
-        for(GLuint x = 0; x < (GLuint)m_widthNum - 1; ++x)
+        for(int x = 0; x < _widthNum - 1; ++x)
         {
+            const GLuint topLeft = getParticleIndex(x, y, _widthNum, _heightNum, _blockSize);
+            const GLuint topRight = getParticleIndex(x+1, y, _widthNum, _heightNum, _blockSize);
+            const GLuint bottomLeft = getParticleIndex(x, y+1, _widthNum, _heightNum, _blockSize);
+            const GLuint bottomRight = getParticleIndex(x+1, y+1, _widthNum, _heightNum, _blockSize);
             //===== TRIANGLE 1 =====
-            _array[index++] = PARTICLEINDEX(x,y);     //top-left
-            _array[index++] = PARTICLEINDEX(x+1,y);   //top-right
-            _array[index++] = PARTICLEINDEX(x,y+1);   //bottom-left
+            _array[index++] = topLeft;
+            _array[index++] = topRight;
+            _array[index++] = bottomLeft;
             //===== TRIANGLE 2 =====
-            _array[index++] = PARTICLEINDEX(x,y+1);   //bottom-left
-            _array[index++] = PARTICLEINDEX(x+1,y+1); //bottom-right
-            _array[index++] = PARTICLEINDEX(x+1,y);   //top-right
+            _array[index++] = bottomLeft;
+            _array[index++] = bottomRight;
+            _array[index++] = topRight;
         }
     }
 }
 
+unsigned int Cloth::getParticleIndex(const int &_x, const int &_y, const int &_widthNum, const int &_heightNum, const int &_blockSize)
+{
+    const int blockX = _x / _blockSize;
+    const int blockY = _y / _blockSize;
+    //the last band and the last block in each band can be smaller than the rest
+    const int bandHeight = std::min(_blockSize, _heightNum - blockY * _blockSize);
+    const int blockWidth = std::min(_blockSize, _widthNum - blockX * _blockSize);
+
+    return (unsigned int)(blockY * _blockSize * _widthNum       //the bands above
+                        + blockX * _blockSize * bandHeight      //the blocks to the left in this band
+                        + (_y - blockY * _blockSize) * blockWidth
+                        + (_x - blockX * _blockSize));
+}
+
+void Cloth::getParticleCoords(const unsigned int &_index, const int &_widthNum, const int &_heightNum, const int &_blockSize, int &_x, int &_y)
+{
+    int remainder = (int)_index;
+    const int blockY = remainder / (_blockSize * _widthNum);
+    remainder -= blockY * _blockSize * _widthNum;
+    const int bandHeight = std::min(_blockSize, _heightNum - blockY * _blockSize);
+
+    const int blockX = remainder / (_blockSize * bandHeight);
+    remainder -= blockX * _blockSize * bandHeight;
+    const int blockWidth = std::min(_blockSize, _widthNum - blockX * _blockSize);
+
+    _x = blockX * _blockSize + remainder % blockWidth;
+    _y = blockY * _blockSize + remainder / blockWidth;
+}
+
 unsigned int Cloth::getIndicesArraySize()
 {
-    return 6 * (m_widthNum - 1) * (m_heightNum - 1);
+    return getIndicesArraySize(m_widthNum, m_heightNum);
+}
+
+unsigned int Cloth::getIndicesArraySize(const int &_widthNum, const int &_heightNum)
+{
+    return 6 * (_widthNum - 1) * (_heightNum - 1);
 }
 
 unsigned int Cloth::getIndicesArraySizeBytes()
@@ -190,15 +358,15 @@ unsigned int Cloth::getIndicesArraySizeBytes()
 //==================== OBSOLETE ====================
 ngl::Vec3 Cloth::makeNormal(const int &_x, const int &_y)
 {
-    CS::Particle* particle = particleAt(_x, _y);
+    unsigned int particle = particleAt(_x, _y);
 
     int clampedX = clamp(_x,1,m_widthNum-2);
     int clampedY = clamp(_y,1,m_heightNum-2);
 
-    ngl::Vec3 upVector = particle->m_pos - particleAt(clampedX,clampedY+1)->m_pos;
-    ngl::Vec3 downVector = particleAt(clampedX,clampedY-1)->m_pos - particle->m_pos;
-    ngl::Vec3 leftVector = particle->m_pos - particleAt(clampedX-1,clampedY)->m_pos;
-    ngl::Vec3 rightVector = particleAt(clampedX+1,clampedY)->m_pos - particle->m_pos;
+    ngl::Vec3 upVector = vectorBetween(particleAt(clampedX,clampedY+1), particle);
+    ngl::Vec3 downVector = vectorBetween(particle, particleAt(clampedX,clampedY-1));
+    ngl::Vec3 leftVector = vectorBetween(particleAt(clampedX-1,clampedY), particle);
+    ngl::Vec3 rightVector = vectorBetween(particle, particleAt(clampedX+1,clampedY));
 
     ngl::Vec3 NEnormal = upVector.cross(rightVector);
     ngl::Vec3 NWnormal = upVector.cross(leftVector);
@@ -212,100 +380,173 @@ ngl::Vec3 Cloth::makeNormal(const int &_x, const int &_y)
     return normal;
 }
 
-void Cloth::addSpring(const unsigned int &_x1, const unsigned int &_y1, const unsigned int &_x2, const unsigned int &_y2, const float &_springConstant, const float &_dampingConstant)
+void Cloth::addSpring(const unsigned int &_x1, const unsigned int &_y1, const unsigned int &_x2, const unsigned int &_y2, const uint8_t &_colour)
 {
-    m_springs.push_back( CS::Spring( particleAt(_x1, _y1), particleAt(_x2, _y2), _springConstant, _dampingConstant ) );
-}
-
-CS::Particle* Cloth::particleAt(const unsigned int &_x, const unsigned int &_y)
-{
-    if (_x < (const unsigned int)m_widthNum && _y < (const unsigned int)m_heightNum)
-    {
-        return &m_particles[_x+(_y*m_widthNum)];
-    }
-    return NULL;
+    unsigned int start = particleAt(_x1, _y1);
+    unsigned int end = particleAt(_x2, _y2);
+    m_springs.addSpring(start, end, vectorBetween(start, end).length());
+    m_springColours.push_back(_colour);
 }
 
-void Cloth::reset(const CS::ClothInfo &_info)
+void Cloth::generateSprings()
 {
-    m_widthNum = _info.widthNum;
-    m_heightNum = _info.heightNum;
-
-    //make radius slightly shorter than the minimum distance between particles
-    float radius = _info.width/_info.widthNum > _info.height/_info.heightNum ? _info.height/_info.heightNum : _info.width/_info.widthNum;
-    radius*=0.5f;
-
-    m_particles.clear();
-
-    //generate particles
-    int count = 0;
-    for (int y=0; y<_info.heightNum; ++y)
-    {
-        for (int x=0; x<_info.widthNum; ++x)
-        {
-            float xPos = x * (_info.width/_info.widthNum) - _info.width/2.0f;
-            float yPos = y * (_info.height/_info.heightNum) - _info.height/2.0f;
-            ngl::Vec3 pos = ngl::Vec3(xPos, yPos, 0.0f);
-            CS::Particle part = CS::Particle(count++,MASS,radius,pos);
-            m_particles.push_back(part);
-        }
-    }
-
-    m_springs.clear();
+    //one spring per pair of neighbours in each family; see below
+    const unsigned int w = (unsigned int)std::max(m_widthNum, 1);
+    const unsigned int h = (unsigned int)std::max(m_heightNum, 1);
+    const unsigned int structural = (w - 1) * h + w * (h - 1);
+    const unsigned int bend = (w > 3 ? (w - 3) * h : 0) + (h > 3 ? w * (h - 3) : 0);
+    const unsigned int shear = 2 * (w - 1) * (h - 1);
+    m_springs.reserve(structural + bend + shear);
+    m_springColours.reserve(structural + bend + shear);
+
+    //each family of springs below is a regular grid, so it can be coloured without searching: two
+    //springs of a family only share a particle when one starts where the other ends, i.e. one
+    //spring further along, so alternating between two colours along the family's direction is
+    //enough. Each family then gets its own pair of colours, twelve in all; every interior
+    //particle has twelve springs, so this is as few as possible
 
     //generate horizontal structural springs
-    for (int x=0; x<_info.widthNum-1; ++x)
+    for (int x=0; x<m_widthNum-1; ++x)
     {
-        for (int y=0; y<_info.heightNum; ++y)
+        for (int y=0; y<m_heightNum; ++y)
         {
-            addSpring(x,y,x+1,y,_info.springConstant,_info.dampingConstant);
+            addSpring(x,y,x+1,y,0+x%2);
         }
     }
 
     //generate vertical structural springs
-    for (int x=0; x<_info.widthNum; ++x)
+    for (int x=0; x<m_widthNum; ++x)
     {
-        for (int y=0; y<_info.heightNum-1; ++y)
+        for (int y=0; y<m_heightNum-1; ++y)
         {
-            addSpring(x,y,x,y+1,_info.springConstant,_info.dampingConstant);
+            addSpring(x,y,x,y+1,2+y%2);
         }
     }
 
     //generate horizontal bend springs
-    for (int x=0; x<_info.widthNum-3; ++x)
+    for (int x=0; x<m_widthNum-3; ++x)
     {
-        for (int y=0; y<_info.heightNum; ++y)
+        for (int y=0; y<m_heightNum; ++y)
         {
-            addSpring(x,y,x+3,y,_info.springConstant,_info.dampingConstant);
+            addSpring(x,y,x+3,y,4+(x/3)%2);
         }
     }
 
     //generate vertical bend springs
-    for (int x=0; x<_info.widthNum; ++x)
+    for (int x=0; x<m_widthNum; ++x)
     {
-        for (int y=0; y<_info.heightNum-3; ++y)
+        for (int y=0; y<m_heightNum-3; ++y)
         {
-            addSpring(x,y,x,y+3,_info.springConstant,_info.dampingConstant);
+            addSpring(x,y,x,y+3,6+(y/3)%2);
         }
     }
 
     //generate top-left to bottom-right shear springs
-    for (int x=0; x<_info.widthNum-1; ++x)
+    for (int x=0; x<m_widthNum-1; ++x)
     {
-        for (int y=0; y<_info.heightNum-1; ++y)
+        for (int y=0; y<m_heightNum-1; ++y)
         {
-            addSpring(x,y,x+1,y+1,_info.springConstant,_info.dampingConstant);
+            addSpring(x,y,x+1,y+1,8+y%2);
         }
     }
 
     //generate top-right to bottom-left shear springs
-    for (int x=1; x<_info.widthNum; ++x)//start from 1 as these springs extend backwards in the x axis
+    for (int x=1; x<m_widthNum; ++x)//start from 1 as these springs extend backwards in the x axis
+    {
+        for (int y=0; y<m_heightNum-1; ++y)
+        {
+            addSpring(x,y,x-1,y+1,10+y%2);
+        }
+    }
+
+    //lets the solver project each colour's springs in parallel
+    m_springs.sortByColour(m_springColours);
+
+    //lets the solver gather spring forces per particle when it runs the pass on several threads
+    m_springs.buildIncidence(m_particles.size());
+}
+
+ngl::Vec3 Cloth::getRestPos(const int &_x, const int &_y) const
+{
+    float xPos = _x * (m_width/m_widthNum) - m_width/2.0f;
+    float yPos = _y * (m_height/m_heightNum) - m_height/2.0f;
+    return ngl::Vec3(xPos, yPos, 0.0f);
+}
+
+float Cloth::getParticleRadius() const
+{
+    //make radius slightly shorter than the minimum distance between particles
+    return 0.5f * std::min(m_width/m_widthNum, m_height/m_heightNum);
+}
+
+unsigned int Cloth::particleAt(const unsigned int &_x, const unsigned int &_y) const
+{
+    //clamp rather than fail so callers always get a valid particle
+    unsigned int x = std::min(_x, (unsigned int)m_widthNum - 1);
+    unsigned int y = std::min(_y, (unsigned int)m_heightNum - 1);
+    return PARTICLEINDEX(x,y);
+}
+
+void Cloth::reset(const CS::ClothInfo &_info)
+{
+    m_widthNum = _info.widthNum;
+    m_heightNum = _info.heightNum;
+    m_blockSize = std::max(_info.blockSize, 1);
+    m_width = _info.width;
+    m_height = _info.height;
+
+    const float radius = getParticleRadius();
+
+    m_particles.clear();
+    m_particles.reserve(_info.widthNum * _info.heightNum);
+
+    //generate particles in the order they are stored in
+    const unsigned int particleNum = _info.widthNum * _info.heightNum;
+    for (unsigned int i=0; i<particleNum; ++i)
     {
-        for (int y=0; y<_info.heightNum-1; ++y)
+        int x, y;
+        getParticleCoords(i, m_widthNum, m_heightNum, m_blockSize, x, y);
+        m_particles.addParticle(MASS,radius,getRestPos(x, y));
+    }
+
+    m_springs.clear();
+    m_springs.m_springConstant = _info.springConstant;
+    m_springs.m_dampingConstant = _info.dampingConstant;
+    m_springColours.clear();
+
+    //the springs and the mesh only depend on the cloth's size, so a size that has been made
+    //before, by this cloth or another, is just copied
+    TopologyCache *cache = TopologyCache::instance();
+    std::shared_ptr<const TopologyCache::Topology> topology = cache->find(m_widthNum, m_heightNum, m_blockSize, m_width, m_height);
+    if (topology)
+    {
+        m_springs.m_springs = topology->m_springs;
+        m_springs.m_colourOffsets = topology->m_colourOffsets;
+        m_springs.m_incidentOffsets = topology->m_incidentOffsets;
+        m_springs.m_incidentSprings = topology->m_incidentSprings;
+    }
+    else
+    {
+        generateSprings();
+
+        std::shared_ptr<TopologyCache::Topology> made(new TopologyCache::Topology);
+        made->m_widthNum = m_widthNum;
+        made->m_heightNum = m_heightNum;
+        made->m_blockSize = m_blockSize;
+        made->m_width = m_width;
+        made->m_height = m_height;
+        made->m_springs = m_springs.m_springs;
+        made->m_colourOffsets = m_springs.m_colourOffsets;
+        made->m_incidentOffsets = m_springs.m_incidentOffsets;
+        made->m_incidentSprings = m_springs.m_incidentSprings;
+        made->m_indices.resize(getIndicesArraySize());
+        if (!made->m_indices.empty())
         {
-            addSpring(x,y,x-1,y+1,_info.springConstant,_info.dampingConstant);
+            getIndices(&made->m_indices[0]);
         }
+        cache->insert(made);
     }
+    m_solver.invalidateTopology();
 
     if (_info.anchoredTopLeft)
     {
@@ -325,36 +566,142 @@ void Cloth::reset(const CS::ClothInfo &_info)
     }
 
     //do an arbitrary force on a particle so not all initial movement is in the XY plane
-    particleAt(m_widthNum/2,m_heightNum/2)->addForce(ngl::Vec3(-0.5f,-0.5f,-0.5f));
+    m_particles.addForce(particleAt(m_widthNum/2,m_heightNum/2), ngl::Vec3(-0.5f,-0.5f,-0.5f));
 
     m_sphere.m_isAnchored = true;
+    m_sphere.m_prevPos = m_sphere.m_pos;
     m_solver.m_sphere = &m_sphere;
+
+    //start the fixed timestep clock again, with nothing to interpolate from yet
+    m_accumulator = 0.0;
+    m_simTime = 0.0;
+    m_lastPosX = m_particles.m_posX;
+    m_lastPosY = m_particles.m_posY;
+    m_lastPosZ = m_particles.m_posZ;
 }
 
-void Cloth::setSpringConstant(const float &_constant)
+bool Cloth::resize(const CS::ClothInfo &_info)
 {
-    for (std::vector<CS::Spring>::iterator it = m_springs.begin(); it != m_springs.end(); ++it)
+    if (_info.widthNum == m_widthNum && _info.heightNum == m_heightNum && std::max(_info.blockSize, 1) == m_blockSize)
     {
-        (*it).m_springConstant = _constant;
+        setSize(_info.width, _info.height);
+        return false;
     }
+
+    //keep what we need of the old cloth to sample it
+    const int oldWidthNum = m_widthNum;
+    const int oldHeightNum = m_heightNum;
+    const int oldBlockSize = m_blockSize;
+    const CS::ParticleStore oldParticles = m_particles;
+    std::vector<unsigned char> anchored(4);
+    anchored[0] = m_particles.m_isAnchored[particleAt(0,m_heightNum-1)];
+    anchored[1] = m_particles.m_isAnchored[particleAt(m_widthNum-1,m_heightNum-1)];
+    anchored[2] = m_particles.m_isAnchored[particleAt(0,0)];
+    anchored[3] = m_particles.m_isAnchored[particleAt(m_widthNum-1,0)];
+
+    //rebuild with the current constants and anchors rather than whatever _info has
+    CS::ClothInfo info = _info;
+    info.springConstant = m_springs.m_springConstant;
+    info.dampingConstant = m_springs.m_dampingConstant;
+    info.anchoredTopLeft = anchored[0] != 0;
+    info.anchoredTopRight = anchored[1] != 0;
+    info.anchoredBottomLeft = anchored[2] != 0;
+    info.anchoredBottomRight = anchored[3] != 0;
+    reset(info);
+
+    //place every particle at the same fraction of the way across the old cloth, blending the four
+    //old particles around it; the corners land exactly on the old corners, so anchors stay put
+    const unsigned int particleNum = m_particles.size();
+    for (unsigned int i=0; i<particleNum; ++i)
+    {
+        int x, y;
+        getParticleCoords(i, m_widthNum, m_heightNum, m_blockSize, x, y);
+        const float u = (float)x * (oldWidthNum - 1) / (float)(m_widthNum - 1);
+        const float v = (float)y * (oldHeightNum - 1) / (float)(m_heightNum - 1);
+        const int x0 = std::min((int)u, oldWidthNum - 2);
+        const int y0 = std::min((int)v, oldHeightNum - 2);
+        const float s = u - x0;
+        const float t = v - y0;
+
+        const unsigned int corners[4] = {getParticleIndex(x0, y0, oldWidthNum, oldHeightNum, oldBlockSize),
+                                         getParticleIndex(x0+1, y0, oldWidthNum, oldHeightNum, oldBlockSize),
+                                         getParticleIndex(x0, y0+1, oldWidthNum, oldHeightNum, oldBlockSize),
+                                         getParticleIndex(x0+1, y0+1, oldWidthNum, oldHeightNum, oldBlockSize)};
+        const float weights[4] = {(1.0f-s)*(1.0f-t), s*(1.0f-t), (1.0f-s)*t, s*t};
+
+        ngl::Vec3 pos(0.0f, 0.0f, 0.0f);
+        ngl::Vec3 prevPos(0.0f, 0.0f, 0.0f);
+        for (int c=0; c<4; ++c)
+        {
+            pos += oldParticles.getPos(corners[c]) * weights[c];
+            prevPos += oldParticles.getPrevPos(corners[c]) * weights[c];
+        }
+        m_particles.setPos(i, pos);
+        m_particles.setPrevPos(i, prevPos);
+    }
+
+    m_lastPosX = m_particles.m_posX;
+    m_lastPosY = m_particles.m_posY;
+    m_lastPosZ = m_particles.m_posZ;
+    return true;
 }
 
-void Cloth::setDampingConstant(const float &_constant)
+void Cloth::setSize(const float &_width, const float &_height)
 {
-    for (std::vector<CS::Spring>::iterator it = m_springs.begin(); it != m_springs.end(); ++it)
+    if (_width == m_width && _height == m_height)
+    {
+        return;
+    }
+
+    const float oldSpacingX = m_width / m_widthNum;
+    const float oldSpacingY = m_height / m_heightNum;
+    m_width = _width;
+    m_height = _height;
+    const float spacingX = m_width / m_widthNum;
+    const float spacingY = m_height / m_heightNum;
+
+    //scale each spring's rest length by how much its own direction has stretched, leaving the
+    //particles wherever they have draped to
+    for (unsigned int i=0; i<m_springs.size(); ++i)
+    {
+        CS::Spring &spring = m_springs[i];
+        int x1, y1, x2, y2;
+        getParticleCoords(spring.m_startParticle, m_widthNum, m_heightNum, m_blockSize, x1, y1);
+        getParticleCoords(spring.m_endParticle, m_widthNum, m_heightNum, m_blockSize, x2, y2);
+        const float oldLength = std::hypot((x2-x1) * oldSpacingX, (y2-y1) * oldSpacingY);
+        const float length = std::hypot((x2-x1) * spacingX, (y2-y1) * spacingY);
+        spring.m_restLength *= oldLength > 0.0f ? length / oldLength : 1.0f;
+    }
+
+    const float radius = getParticleRadius();
+    std::fill(m_particles.m_radius.begin(), m_particles.m_radius.end(), radius);
+
+    //the anchors are what hold the cloth open, so they move to the new rest shape; the previous
+    //position moves with them so the jump doesn't look like a velocity to the damping
+    for (unsigned int i=0; i<m_particles.size(); ++i)
     {
-        (*it).m_dampingConstant = _constant;
+        if (m_particles.m_isAnchored[i])
+        {
+            int x, y;
+            getParticleCoords(i, m_widthNum, m_heightNum, m_blockSize, x, y);
+            ngl::Vec3 pos = getRestPos(x, y);
+            pos.m_z = m_particles.m_posZ[i];
+            m_particles.setPrevPos(i, m_particles.getPrevPos(i) + (pos - m_particles.getPos(i)));
+            m_particles.setPos(i, pos);
+        }
     }
+    m_solver.wakeAll();
 }
 
 void Cloth::setAnchoredCorner(const unsigned int &_corner, const bool &_anchored)
 {
     switch(_corner)
     {
-        case 0 : particleAt(0,m_heightNum-1)->m_isAnchored = _anchored;            break;
-        case 1 : particleAt(m_widthNum-1,m_heightNum-1)->m_isAnchored = _anchored; break;
-        case 2 : particleAt(0,0)->m_isAnchored = _anchored;                        break;
-        case 3 : particleAt(m_widthNum-1,0)->m_isAnchored = _anchored;             break;
+        case 0 : m_particles.m_isAnchored[particleAt(0,m_heightNum-1)] = _anchored;            break;
+        case 1 : m_particles.m_isAnchored[particleAt(m_widthNum-1,m_heightNum-1)] = _anchored; break;
+        case 2 : m_particles.m_isAnchored[particleAt(0,0)] = _anchored;                        break;
+        case 3 : m_particles.m_isAnchored[particleAt(m_widthNum-1,0)] = _anchored;             break;
         default: break;
     }
+    m_solver.wakeAll();
 }
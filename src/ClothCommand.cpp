@@ -0,0 +1,53 @@
+#include "ClothCommand.h"
+
+bool ClothCommand::apply(Cloth &_cloth) const
+{
+    switch (m_type)
+    {
+        case RESET :
+        {
+            _cloth.reset(m_info);
+            return true;
+        }
+        case RESIZE :
+        {
+            //only a new resolution changes what there is to draw
+            const bool rebuilt = _cloth.resize(m_info);
+            _cloth.wakeAll();
+            return rebuilt;
+        }
+        case TOGGLE_PAUSED :            _cloth.togglePaused();                                  break;
+        case TOGGLE_WIND :              _cloth.toggleWind();                                    break;
+        case SET_SPHERE_COLLISIONS :    _cloth.setSphereCollisions(m_flag);                     break;
+        case SET_SELF_COLLISIONS :      _cloth.setSelfCollisions(m_flag);                       break;
+        case SET_SPRING_CONSTANT :      _cloth.setSpringConstant(m_value);                      break;
+        case SET_DAMPING_CONSTANT :     _cloth.setDampingConstant(m_value);                     break;
+        case SET_GRAVITY :              _cloth.setGravity(m_value);                             break;
+        case SET_SIM_SPEED :            _cloth.setSimSpeed(m_value);                            break;
+        case SET_SUBSTEPS :             _cloth.setSubsteps((unsigned int)m_intValue);           break;
+        case SET_ANCHORED_CORNER :      _cloth.setAnchoredCorner(m_intValue, m_flag);           break;
+        case SET_SPHERE_RADIUS :        _cloth.m_sphere.m_radius = m_value;                     break;
+        case SET_SPHERE_AXIS :
+        {
+            switch (m_intValue)
+            {
+                case 0 : _cloth.m_sphere.m_pos.m_x = m_value; break;
+                case 1 : _cloth.m_sphere.m_pos.m_y = m_value; break;
+                case 2 : _cloth.m_sphere.m_pos.m_z = m_value; break;
+                default : break;
+            }
+            break;
+        }
+        case MOVE_SPHERE :              _cloth.m_sphere.move(m_vector);                         break;
+        case SET_SLEEPING :             _cloth.setSleeping(m_flag);                             break;
+        default : break;
+    }
+
+    //sleeping tiles only notice their neighbours and the sphere's path, so anything else that
+    //changes the simulation has to wake them; a moved sphere is caught by its path
+    if (m_type != TOGGLE_PAUSED && m_type != MOVE_SPHERE)
+    {
+        _cloth.wakeAll();
+    }
+    return false;
+}
@@ -0,0 +1,402 @@
+#include "ClothFile.h"
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//bump this whenever the layout below changes; older files are then refused rather than misread
+#define CLOTH_FILE_VERSION 2u
+//every section of the file starts on a multiple of this
+#define CLOTH_FILE_ALIGNMENT 8u
+
+namespace
+{
+    const char MAGIC[8] = {'C','L','O','T','H','S','I','M'};
+
+    //bits of Header::m_flags
+    enum Flag
+    {
+        PAUSED = 1 << 0,
+        SELF_COLLISION = 1 << 1,
+        SPHERE_COLLISION = 1 << 2,
+        WIND = 1 << 3,
+        SPHERE_ANCHORED = 1 << 4,
+        SPRING_SCALES = 1 << 5,
+        //1 << 6 used to mark a deterministic solver, which every solver now is; it is ignored
+        SLEEPING = 1 << 7,
+        WARM_START = 1 << 8
+    };
+
+    //the start of every file; every field is a fixed size and the doubles come first, so there is
+    //no padding to worry about
+    struct Header
+    {
+        char m_magic[8];
+        uint32_t m_version;
+        uint32_t m_headerSize;
+        double m_accumulator;
+        double m_simTime;
+        int32_t m_widthNum, m_heightNum, m_blockSize;
+        float m_width, m_height;
+        uint32_t m_particleNum, m_springNum, m_colourNum, m_flags;
+        float m_springConstant, m_dampingConstant;
+        uint32_t m_mode, m_iterations, m_maxSolveIterations;
+        float m_gravity, m_speed, m_solveTolerance;
+        float m_timestep;
+        uint32_t m_substeps, m_maxStepsPerUpdate;
+        float m_spherePos[3], m_spherePrevPos[3];
+        float m_sphereRadius, m_sphereMass;
+    };
+
+    static_assert(sizeof(Header) % CLOTH_FILE_ALIGNMENT == 0, "the sections after the header must stay aligned");
+    static_assert(sizeof(CS::Spring) == 12, "springs are written as they are stored");
+
+    uint64_t padded(const uint64_t &_bytes)
+    {
+        return (_bytes + CLOTH_FILE_ALIGNMENT - 1) / CLOTH_FILE_ALIGNMENT * CLOTH_FILE_ALIGNMENT;
+    }
+
+    //the size of each section in file order, for both writing and checking a file we have read
+    std::vector<uint64_t> getSectionSizes(const Header &_header)
+    {
+        std::vector<uint64_t> sizes;
+        //positions, previous positions, forces, masses and radii
+        sizes.insert(sizes.end(), 11, uint64_t(_header.m_particleNum) * sizeof(float));
+        sizes.push_back(_header.m_particleNum);
+        sizes.push_back(uint64_t(_header.m_springNum) * sizeof(CS::Spring));
+        sizes.push_back(_header.m_colourNum ? (uint64_t(_header.m_colourNum) + 1) * sizeof(uint32_t) : 0);
+        if (_header.m_flags & SPRING_SCALES)
+        {
+            sizes.insert(sizes.end(), 2, uint64_t(_header.m_springNum) * sizeof(float));
+        }
+        //the implicit mode's last change in velocity, three floats per particle
+        if (_header.m_flags & WARM_START)
+        {
+            sizes.push_back(3 * uint64_t(_header.m_particleNum) * sizeof(float));
+        }
+        return sizes;
+    }
+
+    //writes one section followed by however many zeros it needs to keep the next one aligned
+    void writeSection(std::ofstream &_stream, const void *_data, const uint64_t &_bytes)
+    {
+        static const char zeros[CLOTH_FILE_ALIGNMENT] = {0};
+        if (_bytes > 0)
+        {
+            _stream.write(static_cast<const char*>(_data), (std::streamsize)_bytes);
+        }
+        _stream.write(zeros, (std::streamsize)(padded(_bytes) - _bytes));
+    }
+
+    //fills a vector from a section of the mapped file
+    template <typename T>
+    void readSection(const char *_data, const uint64_t &_offset, const unsigned int &_num, std::vector<T> &_vector)
+    {
+        const T *begin = reinterpret_cast<const T*>(_data + _offset);
+        _vector.assign(begin, begin + _num);
+    }
+
+    //a read-only view of a whole file: mapped where we can, otherwise just read into memory
+    class MappedFile
+    {
+    public:
+        explicit MappedFile(const std::string &_path) : m_data(0), m_size(0)
+        {
+#ifndef _WIN32
+            m_mapping = 0;
+            const int descriptor = open(_path.c_str(), O_RDONLY);
+            if (descriptor < 0)
+            {
+                return;
+            }
+            struct stat info;
+            if (fstat(descriptor, &info) == 0 && info.st_size > 0)
+            {
+                void *mapping = mmap(0, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+                if (mapping != MAP_FAILED)
+                {
+                    //the whole file is read straight through once
+                    madvise(mapping, (size_t)info.st_size, MADV_SEQUENTIAL);
+                    m_mapping = mapping;
+                    m_data = static_cast<const char*>(mapping);
+                    m_size = (uint64_t)info.st_size;
+                }
+            }
+            close(descriptor);
+#else
+            std::ifstream stream(_path.c_str(), std::ios::binary | std::ios::ate);
+            if (stream)
+            {
+                m_buffer.resize((size_t)stream.tellg());
+                stream.seekg(0);
+                if (!m_buffer.empty() && stream.read(&m_buffer[0], (std::streamsize)m_buffer.size()))
+                {
+                    m_data = &m_buffer[0];
+                    m_size = m_buffer.size();
+                }
+            }
+#endif
+        }
+
+        ~MappedFile()
+        {
+#ifndef _WIN32
+            if (m_mapping)
+            {
+                munmap(m_mapping, (size_t)m_size);
+            }
+#endif
+        }
+
+        const char* data() const    {return m_data;}
+        uint64_t size() const       {return m_size;}
+
+    private:
+        MappedFile(const MappedFile &);
+        MappedFile& operator=(const MappedFile &);
+
+        const char *m_data;
+        uint64_t m_size;
+#ifndef _WIN32
+        void *m_mapping;
+#else
+        std::vector<char> m_buffer;
+#endif
+    };
+}
+
+bool ClothFile::save(const Cloth &_cloth, const std::string &_path)
+{
+    const CS::ParticleStore &particles = _cloth.m_particles;
+    const CS::SpringStore &springs = _cloth.m_springs;
+    const Solver &solver = _cloth.m_solver;
+    const CS::Particle &sphere = _cloth.m_sphere;
+    //only a warm start that fits the particles is worth keeping
+    const std::vector<float> &warmStart = solver.getWarmStart();
+    const bool hasWarmStart = !warmStart.empty() && warmStart.size() == 3 * (size_t)particles.size();
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.m_magic, MAGIC, sizeof(MAGIC));
+    header.m_version = CLOTH_FILE_VERSION;
+    header.m_headerSize = sizeof(Header);
+    header.m_accumulator = _cloth.m_accumulator;
+    header.m_simTime = _cloth.m_simTime;
+    header.m_widthNum = _cloth.m_widthNum;
+    header.m_heightNum = _cloth.m_heightNum;
+    header.m_blockSize = _cloth.m_blockSize;
+    header.m_width = _cloth.m_width;
+    header.m_height = _cloth.m_height;
+    header.m_particleNum = particles.size();
+    header.m_springNum = springs.size();
+    header.m_colourNum = springs.getColourNum();
+    header.m_flags = (_cloth.m_isPaused ? PAUSED : 0) |
+                     (solver.m_applySelfCollision ? SELF_COLLISION : 0) |
+                     (solver.m_applySphereCollision ? SPHERE_COLLISION : 0) |
+                     (solver.m_applyWind ? WIND : 0) |
+                     (sphere.m_isAnchored ? SPHERE_ANCHORED : 0) |
+                     (springs.hasPerSpringScales() ? SPRING_SCALES : 0) |
+                     (solver.m_allowSleeping ? SLEEPING : 0) |
+                     (hasWarmStart ? WARM_START : 0);
+    header.m_springConstant = springs.m_springConstant;
+    header.m_dampingConstant = springs.m_dampingConstant;
+    header.m_mode = (uint32_t)solver.m_mode;
+    header.m_iterations = solver.m_iterations;
+    header.m_maxSolveIterations = solver.m_maxSolveIterations;
+    header.m_gravity = solver.m_gravity;
+    header.m_speed = solver.m_speed;
+    header.m_solveTolerance = solver.m_solveTolerance;
+    header.m_timestep = _cloth.m_timestep;
+    header.m_substeps = _cloth.m_substeps;
+    header.m_maxStepsPerUpdate = _cloth.m_maxStepsPerUpdate;
+    header.m_spherePos[0] = sphere.m_pos.m_x;
+    header.m_spherePos[1] = sphere.m_pos.m_y;
+    header.m_spherePos[2] = sphere.m_pos.m_z;
+    header.m_spherePrevPos[0] = sphere.m_prevPos.m_x;
+    header.m_spherePrevPos[1] = sphere.m_prevPos.m_y;
+    header.m_spherePrevPos[2] = sphere.m_prevPos.m_z;
+    header.m_sphereRadius = sphere.m_radius;
+    header.m_sphereMass = sphere.m_mass;
+
+    std::ofstream stream(_path.c_str(), std::ios::binary | std::ios::trunc);
+    if (!stream)
+    {
+        return false;
+    }
+
+    //stream each array straight out of the stores in the same order getSectionSizes() lists them;
+    //the optional sections are skipped over when they aren't there
+    const std::vector<uint64_t> sizes = getSectionSizes(header);
+    std::vector<const void*> sections = {&particles.m_posX[0], &particles.m_posY[0], &particles.m_posZ[0],
+                              &particles.m_prevPosX[0], &particles.m_prevPosY[0], &particles.m_prevPosZ[0],
+                              &particles.m_forceX[0], &particles.m_forceY[0], &particles.m_forceZ[0],
+                              &particles.m_mass[0], &particles.m_radius[0], &particles.m_isAnchored[0],
+                              springs.empty() ? 0 : &springs.m_springs[0],
+                              springs.hasColours() ? &springs.m_colourOffsets[0] : 0,
+                              springs.hasPerSpringScales() ? &springs.m_springScales[0] : 0,
+                              springs.hasPerSpringScales() ? &springs.m_dampingScales[0] : 0};
+    if (!springs.hasPerSpringScales())
+    {
+        sections.resize(14);
+    }
+    if (hasWarmStart)
+    {
+        sections.push_back(&warmStart[0]);
+    }
+
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (unsigned int i = 0; i < sizes.size(); ++i)
+    {
+        writeSection(stream, sections[i], sizes[i]);
+    }
+
+    stream.close();
+    return !stream.fail();
+}
+
+bool ClothFile::load(Cloth &_cloth, const std::string &_path)
+{
+    MappedFile file(_path);
+    if (!file.data() || file.size() < sizeof(Header))
+    {
+        return false;
+    }
+
+    Header header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.m_magic, MAGIC, sizeof(MAGIC)) != 0 || header.m_version != CLOTH_FILE_VERSION || header.m_headerSize != sizeof(Header))
+    {
+        return false;
+    }
+
+    //check everything hangs together before touching the cloth
+    if (header.m_widthNum < 2 || header.m_heightNum < 2 || header.m_blockSize < 1 ||
+        uint64_t(header.m_widthNum) * uint64_t(header.m_heightNum) != header.m_particleNum ||
+        header.m_mode > (uint32_t)Solver::IMPLICIT)
+    {
+        return false;
+    }
+    //update() steps until the accumulator runs out, which it never would with a step like these
+    if (!(header.m_timestep > 0.0f) || !std::isfinite(header.m_timestep))
+    {
+        return false;
+    }
+
+    const std::vector<uint64_t> sizes = getSectionSizes(header);
+    std::vector<uint64_t> offsets(sizes.size());
+    uint64_t offset = sizeof(Header);
+    for (unsigned int i = 0; i < sizes.size(); ++i)
+    {
+        offsets[i] = offset;
+        offset += padded(sizes[i]);
+    }
+    if (offset != file.size())
+    {
+        return false;
+    }
+
+    const char *data = file.data();
+    const CS::Spring *springData = reinterpret_cast<const CS::Spring*>(data + offsets[12]);
+    for (unsigned int i = 0; i < header.m_springNum; ++i)
+    {
+        if (springData[i].m_startParticle >= header.m_particleNum || springData[i].m_endParticle >= header.m_particleNum)
+        {
+            return false;
+        }
+    }
+    const uint32_t *colourData = reinterpret_cast<const uint32_t*>(data + offsets[13]);
+    for (unsigned int c = 0; c < header.m_colourNum; ++c)
+    {
+        if (colourData[c] > colourData[c + 1])
+        {
+            return false;
+        }
+    }
+    if (header.m_colourNum && (colourData[0] != 0 || colourData[header.m_colourNum] != header.m_springNum))
+    {
+        return false;
+    }
+
+    const unsigned int particleNum = header.m_particleNum;
+    CS::ParticleStore &particles = _cloth.m_particles;
+    readSection(data, offsets[0], particleNum, particles.m_posX);
+    readSection(data, offsets[1], particleNum, particles.m_posY);
+    readSection(data, offsets[2], particleNum, particles.m_posZ);
+    readSection(data, offsets[3], particleNum, particles.m_prevPosX);
+    readSection(data, offsets[4], particleNum, particles.m_prevPosY);
+    readSection(data, offsets[5], particleNum, particles.m_prevPosZ);
+    readSection(data, offsets[6], particleNum, particles.m_forceX);
+    readSection(data, offsets[7], particleNum, particles.m_forceY);
+    readSection(data, offsets[8], particleNum, particles.m_forceZ);
+    readSection(data, offsets[9], particleNum, particles.m_mass);
+    readSection(data, offsets[10], particleNum, particles.m_radius);
+    readSection(data, offsets[11], particleNum, particles.m_isAnchored);
+
+    CS::SpringStore &springs = _cloth.m_springs;
+    springs.clear();
+    readSection(data, offsets[12], header.m_springNum, springs.m_springs);
+    if (header.m_colourNum)
+    {
+        readSection(data, offsets[13], header.m_colourNum + 1, springs.m_colourOffsets);
+    }
+    if (header.m_flags & SPRING_SCALES)
+    {
+        readSection(data, offsets[14], header.m_springNum, springs.m_springScales);
+        readSection(data, offsets[15], header.m_springNum, springs.m_dampingScales);
+    }
+    springs.m_springConstant = header.m_springConstant;
+    springs.m_dampingConstant = header.m_dampingConstant;
+    springs.buildIncidence(particleNum);
+    //the springs are already in colour order, so reset()'s colours wouldn't mean anything any more
+    _cloth.m_springColours.clear();
+
+    _cloth.m_widthNum = header.m_widthNum;
+    _cloth.m_heightNum = header.m_heightNum;
+    _cloth.m_blockSize = header.m_blockSize;
+    _cloth.m_width = header.m_width;
+    _cloth.m_height = header.m_height;
+    _cloth.m_isPaused = (header.m_flags & PAUSED) != 0;
+    _cloth.m_timestep = std::max(header.m_timestep, 1e-6f);
+    _cloth.m_substeps = std::max(header.m_substeps, 1u);
+    _cloth.m_maxStepsPerUpdate = std::max(header.m_maxStepsPerUpdate, 1u);
+    _cloth.m_accumulator = header.m_accumulator;
+    _cloth.m_simTime = header.m_simTime;
+    _cloth.m_lastPosX = particles.m_posX;
+    _cloth.m_lastPosY = particles.m_posY;
+    _cloth.m_lastPosZ = particles.m_posZ;
+
+    Solver &solver = _cloth.m_solver;
+    solver.m_applySelfCollision = (header.m_flags & SELF_COLLISION) != 0;
+    solver.m_applySphereCollision = (header.m_flags & SPHERE_COLLISION) != 0;
+    solver.m_applyWind = (header.m_flags & WIND) != 0;
+    solver.m_allowSleeping = (header.m_flags & SLEEPING) != 0;
+    solver.m_mode = (Solver::Mode)header.m_mode;
+    solver.m_iterations = std::max(header.m_iterations, 1u);
+    solver.m_maxSolveIterations = header.m_maxSolveIterations;
+    solver.m_gravity = header.m_gravity;
+    solver.m_speed = header.m_speed;
+    solver.m_solveTolerance = header.m_solveTolerance;
+    solver.invalidateTopology();
+    if (header.m_flags & WARM_START)
+    {
+        std::vector<float> warmStart;
+        readSection(data, offsets.back(), 3 * particleNum, warmStart);
+        solver.setWarmStart(warmStart);
+    }
+
+    CS::Particle &sphere = _cloth.m_sphere;
+    sphere.m_pos = ngl::Vec3(header.m_spherePos[0], header.m_spherePos[1], header.m_spherePos[2]);
+    sphere.m_prevPos = ngl::Vec3(header.m_spherePrevPos[0], header.m_spherePrevPos[1], header.m_spherePrevPos[2]);
+    sphere.m_radius = header.m_sphereRadius;
+    sphere.m_mass = header.m_sphereMass;
+    sphere.m_isAnchored = (header.m_flags & SPHERE_ANCHORED) ? 1.0f : 0.0f;
+    solver.m_sphere = &sphere;
+
+    return true;
+}
@@ -0,0 +1,95 @@
+#include "FrameArena.h"
+#include <algorithm>
+#include <stdint.h>
+
+//every allocation starts on its own cache line, so buffers handed to different threads never
+//share one and the integration kernels always get aligned loads
+#define ARENA_ALIGNMENT 64
+//the smallest block worth asking the heap for
+#define MIN_BLOCK_SIZE (64 * 1024)
+
+namespace
+{
+    size_t alignUp(const size_t &_bytes)
+    {
+        return (_bytes + ARENA_ALIGNMENT - 1) & ~size_t(ARENA_ALIGNMENT - 1);
+    }
+}
+
+FrameArena::FrameArena() : m_offset(0), m_used(0), m_peak(0), m_allocations(0), m_totalAllocations(0), m_heapAllocations(0)
+{
+}
+
+FrameArena::~FrameArena()
+{
+    freeBlocks();
+}
+
+void* FrameArena::allocateBytes(const size_t &_bytes)
+{
+    if (_bytes == 0)
+    {
+        return 0;
+    }
+
+    const size_t size = alignUp(_bytes);
+    if (m_blocks.empty() || m_offset + size > m_blocks.back().m_size)
+    {
+        //the rest of the current block is wasted for this frame; reset() makes sure the next
+        //one fits in a single block
+        addBlock(std::max(size, m_blocks.empty() ? size_t(0) : 2 * m_blocks.back().m_size));
+    }
+
+    void *result = m_blocks.back().m_begin + m_offset;
+    m_offset += size;
+    m_used += size;
+    m_peak = std::max(m_peak, m_used);
+    ++m_allocations;
+    ++m_totalAllocations;
+    return result;
+}
+
+void FrameArena::reset()
+{
+    //a frame that spilled into more blocks than one gets a single block big enough for all of it,
+    //so it never has to spill again
+    if (m_blocks.size() > 1)
+    {
+        size_t capacity = getCapacity();
+        freeBlocks();
+        addBlock(capacity);
+    }
+    m_offset = 0;
+    m_used = 0;
+    m_allocations = 0;
+}
+
+size_t FrameArena::getCapacity() const
+{
+    size_t capacity = 0;
+    for (std::vector<Block>::const_iterator it=m_blocks.begin(); it!=m_blocks.end(); ++it)
+    {
+        capacity += (*it).m_size;
+    }
+    return capacity;
+}
+
+void FrameArena::addBlock(const size_t &_bytes)
+{
+    Block block;
+    block.m_size = alignUp(std::max(_bytes, size_t(MIN_BLOCK_SIZE)));
+    block.m_memory = new char[block.m_size + ARENA_ALIGNMENT - 1];
+    block.m_begin = reinterpret_cast<char*>(alignUp(reinterpret_cast<uintptr_t>(block.m_memory)));
+    m_blocks.push_back(block);
+    m_offset = 0;
+    ++m_heapAllocations;
+}
+
+void FrameArena::freeBlocks()
+{
+    for (std::vector<Block>::iterator it=m_blocks.begin(); it!=m_blocks.end(); ++it)
+    {
+        delete[] (*it).m_memory;
+    }
+    m_blocks.clear();
+}
@@ -1,5 +1,11 @@
 #include "GLWindow.h"
+#include "PackedPoints.h"
+#include "TopologyCache.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <vector>
 #include <ngl/Vec3.h>
 #include <ngl/Light.h>
 #include <ngl/NGLInit.h>
@@ -9,9 +15,13 @@
 #include <QColorDialog>
 
 #define INCREMENT 0.01f
+//how many steps apart a replay recorded from the window checks the cloth's state
+#define REPLAY_HASH_INTERVAL 10
+//above this fraction of the particles' tiles changing, the whole position buffer is sent at once
+#define SPARSE_UPLOAD_LIMIT 0.5f
 
 //----------------------------------------------------------------------------------------------------------------------
-GLWindow::GLWindow(const QGLFormat _format, QWidget *_parent ) : QGLWidget( _format, _parent ), m_clothInfo(), m_cloth()
+GLWindow::GLWindow(const QGLFormat _format, QWidget *_parent ) : QGLWidget( _format, _parent ), m_clothInfo(), m_simulation(), m_drawWidthNum(0), m_drawHeightNum(0), m_drawBlockSize(1), m_drawGeneration(0), m_rebuildMesh(false), m_playbackFrame(-1)
 {
 
     // set this widget to have the initial keyboard focus
@@ -23,9 +33,8 @@ GLWindow::GLWindow(const QGLFormat _format, QWidget *_parent ) : QGLWidget( _for
 	m_scale=1.0;
 	m_position=0.0;
 
-    m_time = 0.0f;
-
     m_drawType=GL_TRIANGLES;
+    std::fill(m_slotVersions, m_slotVersions + UPLOAD_RING_SLOTS, 0u);
 
     m_clothInfo.anchoredTopLeft = true;
     m_clothInfo.anchoredTopRight = true;
@@ -37,11 +46,15 @@ GLWindow::GLWindow(const QGLFormat _format, QWidget *_parent ) : QGLWidget( _for
     m_clothInfo.springConstant = 1024.0f;
     m_clothInfo.width = 2.56f;
     m_clothInfo.widthNum = 16;
+    m_clothInfo.blockSize = 8;
 
     m_shouldRotate = false;
     m_shouldTranslateSphere = false;
     m_spinXFace = 0;
     m_spinYFace = 0;
+
+    //from here on the cloth is stepped on its own thread and only talked to through commands
+    m_simulation.start();
 }
 
 // This virtual function is called once before the first call to paintGL() or resizeGL(),
@@ -132,13 +145,7 @@ void GLWindow::initializeGL()
   // add them to the program
   shader->attachShaderToProgram("Texture","TextureVert");
   shader->attachShaderToProgram("Texture","TextureFrag");
-  // now bind the shader attributes for most NGL primitives we use the following
-  // layout attribute 0 is the vertex data (x,y,z)
-  shader->bindAttribute("Texture",0,"inVert");
-  // attribute 1 is the UV data u,v (if present)
-  shader->bindAttribute("Texture",1,"inUV");
-  // attribute 2 are the normals x,y,z
-  //shader->bindAttribute("Texture",2,"vertNormals");
+  // the cloth shader has no vertex attributes to bind; it reads everything from vertPositions
 
   // now we have associated this data we can link the shader
   shader->linkProgramObject("Texture");
@@ -152,8 +159,10 @@ void GLWindow::initializeGL()
   //shader->setShaderParam4f("Colour",0.23125f,0.23125f,0.23125f,1);
   shader->registerUniform("Texture","widthNum");
   shader->registerUniform("Texture","heightNum");
+  shader->registerUniform("Texture","blockSize");
   shader->setUniform("widthNum", (GLint)m_clothInfo.widthNum);
   shader->setUniform("heightNum", (GLint)m_clothInfo.heightNum);
+  shader->setUniform("blockSize", (GLint)m_clothInfo.blockSize);
 
   // load these values to the shader as well
   light.loadToShader("light");
@@ -183,8 +192,10 @@ void GLWindow::initializeGL()
   shader->use("NormalGeneration");
   shader->registerUniform("NormalGeneration","widthNum");
   shader->registerUniform("NormalGeneration","heightNum");
+  shader->registerUniform("NormalGeneration","blockSize");
   shader->setUniform("widthNum", (GLint)m_clothInfo.widthNum);
   shader->setUniform("heightNum", (GLint)m_clothInfo.heightNum);
+  shader->setUniform("blockSize", (GLint)m_clothInfo.blockSize);
 
   shader->use("Texture");
   shader->registerUniform("Texture","MVP");
@@ -193,7 +204,7 @@ void GLWindow::initializeGL()
   createVAO();
 
   ngl::VAOPrimitives *prim=ngl::VAOPrimitives::instance();
-  prim->createSphere("sphere",m_cloth.m_sphere.m_radius,40);
+  prim->createSphere("sphere",m_simulation.getSnapshot().m_sphereRadius,40);
 
   CS::Vert viewportVerts[6];
 
@@ -260,55 +271,52 @@ void GLWindow::createVAO()
     m_vao=ngl::VertexArrayObject::createVOA(m_drawType);
     m_vao->bind();
 
-    const unsigned int size = m_cloth.getPointsArraySizeCopy();
-    GLfloat *data = new GLfloat[size];
-    m_cloth.getPoints(data);
-    const unsigned int indexSize = m_cloth.getIndicesArraySize();
-    GLuint *indexData = new GLuint[indexSize];
-    m_cloth.getIndices(indexData);
-
-    //demoing grabbing the data directly from the cloth
-    //(we have to make a copy for the texture anyway so sadly there's no performance increase)
-    m_vao->setIndexedData(m_cloth.getPointsArraySizeDirect(), (*m_cloth.getFirstIndex()), m_cloth.getIndicesArraySizeBytes(), indexData, GL_UNSIGNED_INT, GL_STREAM_DRAW);
-    m_vao->setNumIndices(m_cloth.getIndicesArraySize());
-    //set vert to be input 0
-    m_vao->setVertexAttributePointer(0,3,GL_FLOAT,sizeof(CS::Particle),4);
-    //same for input 1
-    m_vao->setVertexAttributePointer(1,1,GL_FLOAT,sizeof(CS::Particle),1);
-    m_vao->unbind();
-
-    //might as well create the position texture while we have the data
-    glActiveTexture(GL_TEXTURE1);
-    glBindBuffer(GL_TEXTURE_BUFFER, m_posBuffer);
-    glBufferData(GL_TEXTURE_BUFFER, size, NULL, GL_STREAM_DRAW);  // Alloc
-    glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);              // Fill
-
-    // Generate texture "wrapper" around buffer object
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_BUFFER, m_posBufferTexture);
-    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_posBuffer);
-
-    delete[] data;
-    delete[] indexData;
-}
-
-void GLWindow::updateVAO()
-{
-    m_vao->bind();
-
-    const unsigned int size = m_cloth.getPointsArraySizeCopy();
-    GLfloat *data = new GLfloat[size];
-    m_cloth.getPoints(data);  
-    m_vao->updateIndexedData(m_cloth.getPointsArraySizeDirect(), (*m_cloth.getFirstIndex()), GL_STREAM_DRAW);
+    //build the mesh from the latest snapshot rather than the cloth itself, which belongs to the
+    //simulation thread, unless we are playing a recording back
+    const SimulationThread::Snapshot &snapshot = m_simulation.getSnapshot();
+    if (m_player.isOpen())
+    {
+        m_drawWidthNum = m_player.getWidthNum();
+        m_drawHeightNum = m_player.getHeightNum();
+        m_drawBlockSize = m_player.getBlockSize();
+    }
+    else
+    {
+        m_drawWidthNum = snapshot.m_widthNum;
+        m_drawHeightNum = snapshot.m_heightNum;
+        m_drawBlockSize = snapshot.m_blockSize;
+    }
+    m_drawGeneration = snapshot.m_generation;
+    m_rebuildMesh = false;
+
+    const unsigned int particleNum = (unsigned int)(getDrawPoints().size() / 4);
+    const unsigned int indexSize = Cloth::getIndicesArraySize(m_drawWidthNum, m_drawHeightNum);
+    //the simulation thread has usually just made this size of cloth, and its mesh along with it
+    std::shared_ptr<const TopologyCache::Topology> topology = TopologyCache::instance()->findResolution(m_drawWidthNum, m_drawHeightNum, m_drawBlockSize);
+    const GLuint *indices = 0;
+    if (topology)
+    {
+        indices = topology->m_indices.data();
+    }
+    else
+    {
+        GLuint *indexData = m_frameArena.allocate<GLuint>(indexSize);
+        Cloth::getIndices(indexData, m_drawWidthNum, m_drawHeightNum, m_drawBlockSize);
+        indices = indexData;
+    }
 
+    //the shader takes each vertex's particle from gl_VertexID, which for an indexed draw is the
+    //index itself, and fetches its position from the position texture; so only the indices are
+    //needed here, and the vertex buffer is just a placeholder the VAO insists on
+    const GLfloat placeholder = 0.0f;
+    m_vao->setIndexedData(sizeof(GLfloat), placeholder, indexSize * sizeof(GLuint), indices, GL_UNSIGNED_INT, GL_STATIC_DRAW);
+    m_vao->setNumIndices(indexSize);
     m_vao->unbind();
 
-    //might as well update the position texture while we have the data
-    glActiveTexture(GL_TEXTURE1);
-    glBindBuffer(GL_TEXTURE_BUFFER, m_posBuffer);
-    glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);              // Fill
-
-    delete[] data;
+    //the number of particles may have changed, so make the position ring fit and fill it
+    m_positionRing.create(particleNum * PackedPoints::s_pointSize, GL_RGBA16F);
+    std::fill(m_slotVersions, m_slotVersions + UPLOAD_RING_SLOTS, 0u);
+    updatePositionTexture();
 }
 
 void GLWindow::loadMatricesToShader(ngl::Transformation &_transform, std::string _shaderName)
@@ -335,6 +343,8 @@ void GLWindow::loadMatricesToShader(ngl::Transformation &_transform, std::string
 // this is our main drawing routine
 void GLWindow::paintGL()
 {
+    //whatever the last frame handed to OpenGL has been copied by now
+    m_frameArena.reset();
 
     if(m_wireframe)
     {
@@ -356,42 +366,78 @@ void GLWindow::paintGL()
     ngl::ShaderLib *shader=ngl::ShaderLib::instance();
     (*shader)["Texture"]->use();
 
-    //run the simulation
-    if(!m_cloth.isPaused())
+    //the simulation runs on its own thread; just pick up the latest step it has finished, if
+    //there's a new one, and otherwise draw the same positions again
+    bool isNewSnapshot = m_simulation.acquireSnapshot();
+    const SimulationThread::Snapshot &snapshot = m_simulation.getSnapshot();
+    if(isNewSnapshot && m_recorder.isOpen())
+    {
+        m_recorder.addFrame(snapshot.m_points, snapshot.m_time);
+    }
+
+    //while a recording is played back its frames replace the simulation's on screen
+    if(m_player.isOpen())
+    {
+        isNewSnapshot = advancePlayback();
+    }
+    else if(isNewSnapshot && snapshot.m_generation != m_drawGeneration)
+    {
+        //the cloth has been reset, maybe with a different number of particles
+        m_rebuildMesh = true;
+    }
+
+    if(m_rebuildMesh)
+    {
+        createVAO();
+        isNewSnapshot = true;
+    }
+    else if(isNewSnapshot)
     {
-        m_time += 0.01f;
-        m_cloth.advance(m_time,0.01f);
         updatePositionTexture();
+    }
+
+    //the shaders read the positions from whichever slot of the ring was written last
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_BUFFER, m_positionRing.getTexture());
+
+    if(isNewSnapshot)
+    {
         renderNormals();
-        updateVAO();
     }
 
     loadMatricesToShader(m_transform, "Texture");
     glViewport(0, 0, width(), height());
 
     shader->use("Texture");
-    glUniform1i(glGetUniformLocation(shader->getProgramID("Texture"), "widthNum"), (GLint)m_clothInfo.widthNum);
-    glUniform1i(glGetUniformLocation(shader->getProgramID("Texture"), "heightNum"), (GLint)m_clothInfo.heightNum);
+    glUniform1i(glGetUniformLocation(shader->getProgramID("Texture"), "widthNum"), (GLint)m_drawWidthNum);
+    glUniform1i(glGetUniformLocation(shader->getProgramID("Texture"), "heightNum"), (GLint)m_drawHeightNum);
+    glUniform1i(glGetUniformLocation(shader->getProgramID("Texture"), "blockSize"), (GLint)m_drawBlockSize);
 
     m_vao->bind();
     m_vao->draw();
     m_vao->unbind();
 
-    // get the VBO instance and draw the sphere
-    ngl::VAOPrimitives *prim=ngl::VAOPrimitives::instance();
-    shader->use("Phong");
-    m_sphereTransform.setPosition(m_cloth.m_sphere.m_pos);
-    m_sphereTransform.setScale(m_scale);
-    m_sphereTransform.setRotation(m_rotation);
-    m_sphereTransform = m_sphereTransform * m_transform;
-    loadMatricesToShader(m_sphereTransform, "Phong");
-    prim->draw("sphere");
-
-    glViewport(0, 0, m_clothInfo.widthNum * 4, m_clothInfo.heightNum * 4);
+    // get the VBO instance and draw the sphere, which isn't part of a recording
+    if(!m_player.isOpen())
+    {
+        ngl::VAOPrimitives *prim=ngl::VAOPrimitives::instance();
+        shader->use("Phong");
+        m_sphereTransform.setPosition(snapshot.m_spherePos);
+        m_sphereTransform.setScale(m_scale);
+        m_sphereTransform.setRotation(m_rotation);
+        m_sphereTransform = m_sphereTransform * m_transform;
+        loadMatricesToShader(m_sphereTransform, "Phong");
+        prim->draw("sphere");
+    }
+
+    glViewport(0, 0, m_drawWidthNum * 4, m_drawHeightNum * 4);
     (*shader)["NormalGeneration"]->use();
     m_viewportVAO->bind();
     m_viewportVAO->draw();
     m_viewportVAO->unbind();
+
+    //nothing else this frame reads the positions, so the slot can be reused once the GPU gets here
+    m_positionRing.fence();
 }
 
 
@@ -445,7 +491,7 @@ void GLWindow::mouseMoveEvent ( QMouseEvent * _event )
 //      ngl::Vec3 yDir = eye.cross(xDir);
 //      ngl::Vec3 translation = (xDir * diffX * -INCREMENT) + (yDir * diffY * INCREMENT);
 
-      m_cloth.m_sphere.move(ngl::Vec3(0.f, -diffY * INCREMENT, -diffX * INCREMENT));
+      m_simulation.post(SimulationThread::Command(SimulationThread::Command::MOVE_SPHERE, ngl::Vec3(0.f, -diffY * INCREMENT, -diffX * INCREMENT)));
       //m_cloth.m_sphere.move(translation);
     }
 }
@@ -522,7 +568,8 @@ void GLWindow::createTextures()
         int width=image->width();
         int height=image->height();
 
-        unsigned char *data = new unsigned char[width*height*4];
+        //a one-off upload, so it isn't worth growing the frame arena for
+        std::vector<unsigned char> data(width*height*4);
         unsigned int index=0;
         QRgb colour;
         for( int y=0; y<height; ++y)
@@ -541,15 +588,13 @@ void GLWindow::createTextures()
         glGenTextures(1,&m_clothTexture);
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D,m_clothTexture);
-        glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,width,height,0,GL_RGBA,GL_UNSIGNED_BYTE,data);
+        glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,width,height,0,GL_RGBA,GL_UNSIGNED_BYTE,&data[0]);
 
         glUniform1i(glGetUniformLocation(shader->getProgramID("Texture"), "tex"), 0);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
         glGenerateMipmap(GL_TEXTURE_2D); //  Allocate the mipmaps
-
-        delete[] data;
     }
     else
     {
@@ -558,25 +603,11 @@ void GLWindow::createTextures()
 
     //==================== Positions Texture ====================
 
-    const unsigned int size = m_cloth.getPointsArraySizeCopy();
-    GLfloat *data2 = new GLfloat[size];
-    m_cloth.getPoints(data2);
-
-    glGenBuffers(1, &m_posBuffer);
-    //glActiveTexture(GL_TEXTURE1);
-    glBindBuffer(GL_TEXTURE_BUFFER, m_posBuffer);
-    glBufferData(GL_TEXTURE_BUFFER, size, NULL, GL_STATIC_DRAW);  // Alloc
-    glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data2);              // Fill
-
-    // Generate texture "wrapper" around buffer object
-    glGenTextures(1, &m_posBufferTexture);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_BUFFER, m_posBufferTexture);
-    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_posBuffer);
+    //the buffers themselves are made by createVAO(), since they need remaking whenever the
+    //cloth is reset; here we just point the shaders at texture unit 1
     glUniform1i(glGetUniformLocation(shader->getProgramID("Texture"), "vertPositions"), 1);
     shader->use("NormalGeneration");
     glUniform1i(glGetUniformLocation(shader->getProgramID("NormalGeneration"), "vertPositions"), 1);
-    delete[] data2;
 
     //==================== Normals Texture ====================
     // I'd really appreciate knowing where I'm going wrong here
@@ -653,16 +684,131 @@ void GLWindow::createTextures()
 
 void GLWindow::updatePositionTexture()
 {
-    const unsigned int size = m_cloth.getPointsArraySizeCopy();
-    GLfloat *data = new GLfloat[size];
-    m_cloth.getPoints(data);
+    const std::vector<GLfloat> &points = getDrawPoints();
+    const unsigned int particleNum = (unsigned int)(points.size() / 4);
+    const bool fits = particleNum * PackedPoints::s_pointSize == (size_t)m_positionRing.getSize();
+
+    //the slot we are about to write still holds an older snapshot of the same cloth, unless it was
+    //last filled by a recording, so only the tiles changed since then need sending
+    const SimulationThread::Snapshot &snapshot = m_simulation.getSnapshot();
+    const unsigned int slot = m_positionRing.getNextSlot();
+    const uint32_t since = m_slotVersions[slot];
+    const std::vector<uint32_t> &tileVersions = snapshot.m_tileVersions;
+    const unsigned int tileNum = (unsigned int)tileVersions.size();
+    bool partial = !m_player.isOpen() && fits && since != 0 && tileNum * CHANGE_TILE_SIZE >= particleNum;
+    if (partial)
+    {
+        unsigned int changed = 0;
+        for (unsigned int t = 0; t < tileNum; ++t)
+        {
+            changed += tileVersions[t] > since ? 1 : 0;
+        }
+        partial = changed < SPARSE_UPLOAD_LIMIT * tileNum;
+    }
 
-    // Create buffer
-    glActiveTexture(GL_TEXTURE1);
-    glBindBuffer(GL_TEXTURE_BUFFER, m_posBuffer);
-    glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);              // Fill
+    //pack the snapshot straight into memory the GPU reads from, with no allocation in between
+    uint16_t *data = (uint16_t*)m_positionRing.beginWrite(partial);
+    if (data && partial)
+    {
+        //neighbouring changed tiles go as one range
+        unsigned int t = 0;
+        while (t < tileNum)
+        {
+            if (tileVersions[t] <= since)
+            {
+                ++t;
+                continue;
+            }
+            const unsigned int first = t;
+            while (t < tileNum && tileVersions[t] > since)
+            {
+                ++t;
+            }
+            const unsigned int begin = first * CHANGE_TILE_SIZE;
+            const unsigned int end = std::min(t * CHANGE_TILE_SIZE, particleNum);
+            PackedPoints::pack(&points[0], data, begin, end);
+            m_positionRing.flushRange((GLintptr)begin * PackedPoints::s_pointSize, (GLsizeiptr)(end - begin) * PackedPoints::s_pointSize);
+        }
+    }
+    else if (data && fits)
+    {
+        PackedPoints::pack(&points[0], data, 0, particleNum);
+    }
+    m_positionRing.endWrite();
+    m_slotVersions[slot] = (data && fits && !m_player.isOpen()) ? snapshot.m_version : 0;
+}
+
+const std::vector<GLfloat>& GLWindow::getDrawPoints() const
+{
+    return m_player.isOpen() ? m_playbackPoints : m_simulation.getSnapshot().m_points;
+}
+
+bool GLWindow::advancePlayback()
+{
+    //loop over the recorded time span, at the speed it was simulated
+    const double first = m_player.getFrameTime(0);
+    const double length = m_player.getFrameTime(m_player.getFrameNum() - 1) - first;
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_playbackStart).count();
+    const unsigned int frame = m_player.findFrame(first + (length > 0.0 ? std::fmod(elapsed, length) : 0.0));
+    if ((int)frame == m_playbackFrame)
+    {
+        return false;
+    }
+
+    m_playbackPoints.resize(4 * (size_t)m_player.getParticleNum());
+    if (!m_player.readFrame(frame, &m_playbackPoints[0]))
+    {
+        //a damaged frame just leaves the last one on screen
+        return false;
+    }
+    m_playbackFrame = (int)frame;
+    return true;
+}
+
+bool GLWindow::startRecording(const std::string &_path)
+{
+    //record at the resolution of the cloth now, as the simulation thread last published it
+    const SimulationThread::Snapshot &snapshot = m_simulation.getSnapshot();
+    return m_recorder.open(_path, snapshot.m_widthNum, snapshot.m_heightNum, snapshot.m_blockSize, PointCache::DELTA);
+}
+
+bool GLWindow::stopRecording()
+{
+    return m_recorder.close();
+}
+
+bool GLWindow::startPlayback(const std::string &_path)
+{
+    if (!m_player.open(_path) || m_player.getFrameNum() == 0)
+    {
+        m_player.close();
+        return false;
+    }
+    m_playbackStart = std::chrono::steady_clock::now();
+    m_playbackFrame = -1;
+    advancePlayback();
+    m_rebuildMesh = true;
+    return true;
+}
+
+void GLWindow::stopPlayback()
+{
+    if (m_player.isOpen())
+    {
+        m_player.close();
+        m_playbackPoints.clear();
+        m_rebuildMesh = true;
+    }
+}
+
+bool GLWindow::startReplayRecording(const std::string &_path)
+{
+    return m_simulation.startRecording(_path, REPLAY_HASH_INTERVAL);
+}
 
-    delete[] data;
+bool GLWindow::stopReplayRecording()
+{
+    return m_simulation.stopRecording();
 }
 
 void GLWindow::renderNormals()
@@ -762,8 +908,9 @@ void GLWindow::renderNormals()
         // grab an instance of the shader manager
         ngl::ShaderLib *shader=ngl::ShaderLib::instance();
         (*shader)["NormalGeneration"]->use();
-        glUniform1i(glGetUniformLocation(shader->getProgramID("NormalGeneration"), "widthNum"), (GLint)m_clothInfo.widthNum);
-        glUniform1i(glGetUniformLocation(shader->getProgramID("NormalGeneration"), "heightNum"), (GLint)m_clothInfo.heightNum);
+        glUniform1i(glGetUniformLocation(shader->getProgramID("NormalGeneration"), "widthNum"), (GLint)m_drawWidthNum);
+        glUniform1i(glGetUniformLocation(shader->getProgramID("NormalGeneration"), "heightNum"), (GLint)m_drawHeightNum);
+        glUniform1i(glGetUniformLocation(shader->getProgramID("NormalGeneration"), "blockSize"), (GLint)m_drawBlockSize);
 
         // we are now going to draw to our FBO
         // set the rendering destination to FBO
@@ -773,7 +920,7 @@ void GLWindow::renderNormals()
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         // set our viewport to the size of the texture
         // if we want a different camera we wouldset this here
-        glViewport(0, 0, (GLsizei)m_clothInfo.widthNum, (GLsizei)m_clothInfo.heightNum);
+        glViewport(0, 0, (GLsizei)m_drawWidthNum, (GLsizei)m_drawHeightNum);
 
         m_viewportVAO->bind();
         m_viewportVAO->draw();
@@ -801,11 +948,10 @@ GLWindow::~GLWindow()
     //delete m_light;
     Init->NGLQuit();
     // clear out our buffers
-    glDeleteTextures(1,&m_posBufferTexture);
+    m_positionRing.destroy();
     glDeleteTextures(1,&m_clothTexture);
     glDeleteTextures(1,&m_normalsFramebufferTexture);
     glDeleteFramebuffers(1,&m_normalsFramebuffer);
-    glDeleteBuffers(1,&m_posBuffer);
 }
 
 void GLWindow::toggleWireframe(bool _mode)
@@ -869,124 +1015,141 @@ void GLWindow::setDrawType(int _i)
 
 void GLWindow::togglePaused()
 {
-    m_cloth.togglePaused();
+    m_simulation.post(SimulationThread::Command(SimulationThread::Command::TOGGLE_PAUSED));
 }
 
 void GLWindow::toggleWind()
 {
-    m_cloth.toggleWind();
+    m_simulation.post(SimulationThread::Command(SimulationThread::Command::TOGGLE_WIND));
 }
 
 void GLWindow::setSphereCollisions(bool _shouldUse)
 {
-    m_cloth.setSphereCollisions(_shouldUse);
+    m_simulation.post(SimulationThread::Command(SimulationThread::Command::SET_SPHERE_COLLISIONS, _shouldUse));
 }
 
 void GLWindow::setSelfCollisions(bool _shouldUse)
 {
-    m_cloth.setSelfCollisions(_shouldUse);
+    m_simulation.post(SimulationThread::Command(SimulationThread::Command::SET_SELF_COLLISIONS, _shouldUse));
+}
+
+void GLWindow::setSleeping(bool _sleeping)
+{
+    m_simulation.post(SimulationThread::Command(SimulationThread::Command::SET_SLEEPING, _sleeping));
 }
 
 void GLWindow::resetCloth()
 {
-    m_cloth.reset(m_clothInfo);
+    //the VAO is rebuilt once the simulation thread has reset the cloth and we get the snapshot
+    m_simulation.post(SimulationThread::Command(SimulationThread::Command::RESET, m_clothInfo));
     m_rotation=0.0;
     m_scale=1.0;
     m_position=0.0;
-    createVAO();
+}
+
+void GLWindow::resizeCloth()
+{
+    //the cloth keeps its shape rather than starting again; the VAO is only rebuilt if the
+    //resolution changed
+    m_simulation.post(SimulationThread::Command(SimulationThread::Command::RESIZE, m_clothInfo));
 }
 
 void GLWindow::setClothHeight(double _height)
 {
     m_clothInfo.height = (float)_height;
-    resetCloth();
+    resizeCloth();
 }
 
 void GLWindow::setClothWidth(double _width)
 {
     m_clothInfo.width = (float)_width;
-    resetCloth();
+    resizeCloth();
 }
 
 void GLWindow::setClothHeightRes(int _num)
 {
     m_clothInfo.heightNum = _num;
-    resetCloth();
+    resizeCloth();
 }
 
 void GLWindow::setClothWidthRes(int _num)
 {
     m_clothInfo.widthNum = _num;
-    resetCloth();
+    resizeCloth();
 }
 
 void GLWindow::setSpringConstant(double _constant)
 {
     m_clothInfo.springConstant = (float)_constant;
-    m_cloth.setSpringConstant(_constant);
+    m_simulation.post(SimulationThread::Command(SimulationThread::Command::SET_SPRING_CONSTANT, (float)_constant));
 }
 
 void GLWindow::setDampingConstant(double _constant)
 {
     m_clothInfo.dampingConstant = (float)_constant;
-    m_cloth.setDampingConstant(_constant);
+    m_simulation.post(SimulationThread::Command(SimulationThread::Command::SET_DAMPING_CONSTANT, (float)_constant));
 }
 
 void GLWindow::setSphereRadius(double _radius)
 {
-    m_cloth.m_sphere.m_radius = _radius;
+    m_simulation.post(SimulationThread::Command(SimulationThread::Command::SET_SPHERE_RADIUS, (float)_radius));
 }
 
 void GLWindow::setSphereX(double _x)
 {
-    m_cloth.m_sphere.m_pos.m_x = _x;
+    m_simulation.post(SimulationThread::Command(SimulationThread::Command::SET_SPHERE_AXIS, 0, (float)_x, false));
 }
 
 void GLWindow::setSphereY(double _y)
 {
-    m_cloth.m_sphere.m_pos.m_y = _y;
+    m_simulation.post(SimulationThread::Command(SimulationThread::Command::SET_SPHERE_AXIS, 1, (float)_y, false));
 }
 
 void GLWindow::setSphereZ(double _z)
 {
-    m_cloth.m_sphere.m_pos.m_z = _z;
+    m_simulation.post(SimulationThread::Command(SimulationThread::Command::SET_SPHERE_AXIS, 2, (float)_z, false));
 }
 
 void GLWindow::setGravity(double _gravity)
 {
-    m_cloth.setGravity(_gravity);
+    m_simulation.post(SimulationThread::Command(SimulationThread::Command::SET_GRAVITY, (float)_gravity));
 }
 
 void GLWindow::setSimSpeed(double _speed)
 {
-    m_cloth.setSimSpeed(_speed);
+    m_simulation.post(SimulationThread::Command(SimulationThread::Command::SET_SIM_SPEED, (float)_speed));
+}
+
+void GLWindow::setSubsteps(int _substeps)
+{
+    m_simulation.post(SimulationThread::Command(SimulationThread::Command::SET_SUBSTEPS, _substeps));
 }
 
 void GLWindow::reset()
 {
-    m_cloth.reset(m_clothInfo);
+    m_simulation.post(SimulationThread::Command(SimulationThread::Command::RESET, m_clothInfo));
 }
 
 void GLWindow::setAnchoredBottomLeft(bool _anchor)
 {
-    m_cloth.setAnchoredCorner(2, _anchor);
+    m_simulation.post(SimulationThread::Command(SimulationThread::Command::SET_ANCHORED_CORNER, 2, 0.0f, _anchor));
     m_clothInfo.anchoredBottomLeft = _anchor;
 }
 
 void GLWindow::setAnchoredBottomRight(bool _anchor)
 {
-    m_cloth.setAnchoredCorner(3, _anchor);
+    m_simulation.post(SimulationThread::Command(SimulationThread::Command::SET_ANCHORED_CORNER, 3, 0.0f, _anchor));
     m_clothInfo.anchoredBottomRight = _anchor;
 }
 
 void GLWindow::setAnchoredTopLeft(bool _anchor)
 {
-    m_cloth.setAnchoredCorner(0, _anchor);
+    m_simulation.post(SimulationThread::Command(SimulationThread::Command::SET_ANCHORED_CORNER, 0, 0.0f, _anchor));
     m_clothInfo.anchoredTopLeft = _anchor;
 }
 
 void GLWindow::setAnchoredTopRight(bool _anchor)
 {
-    m_cloth.setAnchoredCorner(1, _anchor);
+    m_simulation.post(SimulationThread::Command(SimulationThread::Command::SET_ANCHORED_CORNER, 1, 0.0f, _anchor));
     m_clothInfo.anchoredTopRight = _anchor;
 }
@@ -0,0 +1,235 @@
+#include "Integrator.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+    #define INTEGRATOR_HAS_SSE
+    #include <emmintrin.h>
+#endif
+
+//the AVX kernel is compiled with a function-level target so the rest of the program doesn't need
+//AVX to run; only GCC and Clang support that, so other compilers just get the SSE kernel
+#if defined(INTEGRATOR_HAS_SSE) && defined(__GNUC__)
+    #define INTEGRATOR_HAS_AVX
+    #include <immintrin.h>
+    #define AVX_TARGET __attribute__((target("avx")))
+#endif
+
+namespace
+{
+    //the plain version of the kernel; also used for the leftover particles at the end of a range
+    void integrateScalar(CS::ParticleStore* _particles, const float* _windZ, const unsigned int &_begin, const unsigned int &_end, const float &_gravity, const float &_airResistance, const float &_deltaSquared)
+    {
+        float *posX = &_particles->m_posX[0],          *posY = &_particles->m_posY[0],          *posZ = &_particles->m_posZ[0];
+        float *prevX = &_particles->m_prevPosX[0],     *prevY = &_particles->m_prevPosY[0],     *prevZ = &_particles->m_prevPosZ[0];
+        float *forceX = &_particles->m_forceX[0],      *forceY = &_particles->m_forceY[0],      *forceZ = &_particles->m_forceZ[0];
+        const float *mass = &_particles->m_mass[0];
+        const unsigned char *anchored = &_particles->m_isAnchored[0];
+
+        for (unsigned int i = _begin; i < _end; ++i)
+        {
+            if (!anchored[i])
+            {
+                //gravity, air resistance and wind; gravity is added to every axis, as a vector, to
+                //match the vector kernels exactly
+                float fx = (forceX[i] + 0.0f) + _airResistance * (prevX[i] - posX[i]);
+                float fy = (forceY[i] + _gravity) + _airResistance * (prevY[i] - posY[i]);
+                float fz = (forceZ[i] + 0.0f) + _airResistance * (prevZ[i] - posZ[i]);
+                if (_windZ)
+                {
+                    fz = fz + _windZ[i];
+                }
+
+                //Verlet integration
+                float moveX = (posX[i] - prevX[i]) + _deltaSquared * (-fx / mass[i]);
+                float moveY = (posY[i] - prevY[i]) + _deltaSquared * (-fy / mass[i]);
+                float moveZ = (posZ[i] - prevZ[i]) + _deltaSquared * (-fz / mass[i]);
+
+                prevX[i] = posX[i];
+                prevY[i] = posY[i];
+                prevZ[i] = posZ[i];
+                posX[i] += moveX;
+                posY[i] += moveY;
+                posZ[i] += moveZ;
+            }
+            forceX[i] = 0.0f;
+            forceY[i] = 0.0f;
+            forceZ[i] = 0.0f;
+        }
+    }
+
+#ifdef INTEGRATOR_HAS_SSE
+    //returns a mask with all bits set in the lanes whose particle is not anchored
+    inline __m128 freeMaskSSE(const unsigned char* _anchored)
+    {
+        int bytes;
+        memcpy(&bytes, _anchored, sizeof(int));
+        const __m128i zero = _mm_setzero_si128();
+        __m128i lanes = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero);
+        return _mm_castsi128_ps(_mm_cmpeq_epi32(lanes, zero));
+    }
+
+    //picks _new in the lanes set in _mask and _old everywhere else
+    inline __m128 selectSSE(const __m128 &_mask, const __m128 &_new, const __m128 &_old)
+    {
+        return _mm_or_ps(_mm_and_ps(_mask, _new), _mm_andnot_ps(_mask, _old));
+    }
+
+    //one axis of the kernel for four particles
+    inline void integrateAxisSSE(float* _pos, float* _prev, float* _force, const float* _wind, const __m128 &_constantForce, const __m128 &_mass, const __m128 &_free, const __m128 &_airResistance, const __m128 &_deltaSquared)
+    {
+        const __m128 signBit = _mm_set1_ps(-0.0f);
+        __m128 pos = _mm_loadu_ps(_pos);
+        __m128 prev = _mm_loadu_ps(_prev);
+
+        __m128 force = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(_force), _constantForce), _mm_mul_ps(_airResistance, _mm_sub_ps(prev, pos)));
+        if (_wind)
+        {
+            force = _mm_add_ps(force, _mm_loadu_ps(_wind));
+        }
+
+        __m128 acceleration = _mm_div_ps(_mm_xor_ps(force, signBit), _mass);
+        __m128 move = _mm_add_ps(_mm_sub_ps(pos, prev), _mm_mul_ps(_deltaSquared, acceleration));
+
+        _mm_storeu_ps(_prev, selectSSE(_free, pos, prev));
+        _mm_storeu_ps(_pos, selectSSE(_free, _mm_add_ps(pos, move), pos));
+        _mm_storeu_ps(_force, _mm_setzero_ps());
+    }
+
+    void integrateSSE(CS::ParticleStore* _particles, const float* _windZ, const unsigned int &_begin, const unsigned int &_end, const float &_gravity, const float &_airResistance, const float &_deltaSquared)
+    {
+        const __m128 airResistance = _mm_set1_ps(_airResistance);
+        const __m128 deltaSquared = _mm_set1_ps(_deltaSquared);
+        const __m128 gravity = _mm_set1_ps(_gravity);
+        const __m128 noForce = _mm_setzero_ps();
+
+        unsigned int i = _begin;
+        for (; i + 4 <= _end; i += 4)
+        {
+            const __m128 free = freeMaskSSE(&_particles->m_isAnchored[i]);
+            const __m128 mass = _mm_loadu_ps(&_particles->m_mass[i]);
+            integrateAxisSSE(&_particles->m_posX[i], &_particles->m_prevPosX[i], &_particles->m_forceX[i], 0, noForce, mass, free, airResistance, deltaSquared);
+            integrateAxisSSE(&_particles->m_posY[i], &_particles->m_prevPosY[i], &_particles->m_forceY[i], 0, gravity, mass, free, airResistance, deltaSquared);
+            integrateAxisSSE(&_particles->m_posZ[i], &_particles->m_prevPosZ[i], &_particles->m_forceZ[i], _windZ ? _windZ + i : 0, noForce, mass, free, airResistance, deltaSquared);
+        }
+        integrateScalar(_particles, _windZ, i, _end, _gravity, _airResistance, _deltaSquared);
+    }
+#endif
+
+#ifdef INTEGRATOR_HAS_AVX
+    AVX_TARGET inline __m256 freeMaskAVX(const unsigned char* _anchored)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i shorts = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)_anchored), zero);
+        __m128 low = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_unpacklo_epi16(shorts, zero), zero));
+        __m128 high = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_unpackhi_epi16(shorts, zero), zero));
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(low), high, 1);
+    }
+
+    AVX_TARGET inline void integrateAxisAVX(float* _pos, float* _prev, float* _force, const float* _wind, const __m256 &_constantForce, const __m256 &_mass, const __m256 &_free, const __m256 &_airResistance, const __m256 &_deltaSquared)
+    {
+        const __m256 signBit = _mm256_set1_ps(-0.0f);
+        __m256 pos = _mm256_loadu_ps(_pos);
+        __m256 prev = _mm256_loadu_ps(_prev);
+
+        __m256 force = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(_force), _constantForce), _mm256_mul_ps(_airResistance, _mm256_sub_ps(prev, pos)));
+        if (_wind)
+        {
+            force = _mm256_add_ps(force, _mm256_loadu_ps(_wind));
+        }
+
+        __m256 acceleration = _mm256_div_ps(_mm256_xor_ps(force, signBit), _mass);
+        __m256 move = _mm256_add_ps(_mm256_sub_ps(pos, prev), _mm256_mul_ps(_deltaSquared, acceleration));
+
+        _mm256_storeu_ps(_prev, _mm256_blendv_ps(prev, pos, _free));
+        _mm256_storeu_ps(_pos, _mm256_blendv_ps(pos, _mm256_add_ps(pos, move), _free));
+        _mm256_storeu_ps(_force, _mm256_setzero_ps());
+    }
+
+    AVX_TARGET void integrateAVX(CS::ParticleStore* _particles, const float* _windZ, const unsigned int &_begin, const unsigned int &_end, const float &_gravity, const float &_airResistance, const float &_deltaSquared)
+    {
+        const __m256 airResistance = _mm256_set1_ps(_airResistance);
+        const __m256 deltaSquared = _mm256_set1_ps(_deltaSquared);
+        const __m256 gravity = _mm256_set1_ps(_gravity);
+        const __m256 noForce = _mm256_setzero_ps();
+
+        unsigned int i = _begin;
+        for (; i + 8 <= _end; i += 8)
+        {
+            const __m256 free = freeMaskAVX(&_particles->m_isAnchored[i]);
+            const __m256 mass = _mm256_loadu_ps(&_particles->m_mass[i]);
+            integrateAxisAVX(&_particles->m_posX[i], &_particles->m_prevPosX[i], &_particles->m_forceX[i], 0, noForce, mass, free, airResistance, deltaSquared);
+            integrateAxisAVX(&_particles->m_posY[i], &_particles->m_prevPosY[i], &_particles->m_forceY[i], 0, gravity, mass, free, airResistance, deltaSquared);
+            integrateAxisAVX(&_particles->m_posZ[i], &_particles->m_prevPosZ[i], &_particles->m_forceZ[i], _windZ ? _windZ + i : 0, noForce, mass, free, airResistance, deltaSquared);
+        }
+        integrateScalar(_particles, _windZ, i, _end, _gravity, _airResistance, _deltaSquared);
+    }
+#endif
+
+    Integrator::InstructionSet detectBestInstructionSet()
+    {
+#ifdef INTEGRATOR_HAS_AVX
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx"))
+        {
+            return Integrator::AVX;
+        }
+#endif
+#ifdef INTEGRATOR_HAS_SSE
+        return Integrator::SSE;
+#else
+        return Integrator::SCALAR;
+#endif
+    }
+
+    Integrator::InstructionSet& currentInstructionSet()
+    {
+        static Integrator::InstructionSet set = Integrator::getBestInstructionSet();
+        return set;
+    }
+}
+
+void Integrator::integrate(CS::ParticleStore* _particles, const float* _windZ, const unsigned int &_begin, const unsigned int &_end, const float &_gravity, const float &_airResistance, const float &_deltaSquared)
+{
+    if (_end <= _begin)
+    {
+        return;
+    }
+
+    switch (currentInstructionSet())
+    {
+#ifdef INTEGRATOR_HAS_AVX
+        case AVX : integrateAVX(_particles, _windZ, _begin, _end, _gravity, _airResistance, _deltaSquared);    break;
+#endif
+#ifdef INTEGRATOR_HAS_SSE
+        case SSE : integrateSSE(_particles, _windZ, _begin, _end, _gravity, _airResistance, _deltaSquared);    break;
+#endif
+        default  : integrateScalar(_particles, _windZ, _begin, _end, _gravity, _airResistance, _deltaSquared); break;
+    }
+}
+
+Integrator::InstructionSet Integrator::getInstructionSet()
+{
+    return currentInstructionSet();
+}
+
+void Integrator::setInstructionSet(const InstructionSet &_set)
+{
+    InstructionSet best = getBestInstructionSet();
+    currentInstructionSet() = _set > best ? best : _set;
+}
+
+Integrator::InstructionSet Integrator::getBestInstructionSet()
+{
+    static InstructionSet best = detectBestInstructionSet();
+    return best;
+}
+
+const char* Integrator::getInstructionSetName(const InstructionSet &_set)
+{
+    switch (_set)
+    {
+        case AVX : return "AVX";
+        case SSE : return "SSE";
+        default  : return "scalar";
+    }
+}
@@ -1,5 +1,7 @@
 #include "MainWindow.h"
 #include "ui_MainWindow.h"
+#include <QFileDialog>
+#include <QMessageBox>
 
 MainWindow::MainWindow(QWidget *parent) :QMainWindow(parent), m_ui(new Ui::MainWindow)
 {
@@ -16,11 +18,15 @@ MainWindow::MainWindow(QWidget *parent) :QMainWindow(parent), m_ui(new Ui::MainW
 
   /// set the combo box index change signal
   connect(m_ui->m_drawType,SIGNAL(currentIndexChanged(int)),m_gl,SLOT(setDrawType(int)));
+  connect(m_ui->m_recordCache,SIGNAL(toggled(bool)),this,SLOT(setRecording(bool)));
+  connect(m_ui->m_playCache,SIGNAL(toggled(bool)),this,SLOT(setPlayback(bool)));
+  connect(m_ui->m_recordReplay,SIGNAL(toggled(bool)),this,SLOT(setReplayRecording(bool)));
 
   connect(m_ui->m_paused,SIGNAL(clicked(bool)),m_gl,SLOT(togglePaused()));
   connect(m_ui->m_applyWind,SIGNAL(clicked(bool)),m_gl,SLOT(toggleWind()));
   connect(m_ui->m_applySphereCollision,SIGNAL(clicked(bool)),m_gl,SLOT(setSphereCollisions(bool)));
   connect(m_ui->m_applySelfCollision,SIGNAL(clicked(bool)),m_gl,SLOT(setSelfCollisions(bool)));
+  connect(m_ui->m_sleep,SIGNAL(clicked(bool)),m_gl,SLOT(setSleeping(bool)));
 
   connect(m_ui->m_anchorBottomLeft,SIGNAL(clicked(bool)),m_gl,SLOT(setAnchoredBottomLeft(bool)));
   connect(m_ui->m_anchorBottomRight,SIGNAL(clicked(bool)),m_gl,SLOT(setAnchoredBottomRight(bool)));
@@ -35,6 +41,7 @@ MainWindow::MainWindow(QWidget *parent) :QMainWindow(parent), m_ui(new Ui::MainW
   connect(m_ui->m_dampingConstant,SIGNAL(valueChanged(double)),m_gl,SLOT(setDampingConstant(double)));
   connect(m_ui->m_gravity, SIGNAL(valueChanged(double)),m_gl,SLOT(setGravity(double)));
   connect(m_ui->m_simSpeed, SIGNAL(valueChanged(double)),m_gl,SLOT(setSimSpeed(double)));
+  connect(m_ui->m_substeps, SIGNAL(valueChanged(int)),m_gl,SLOT(setSubsteps(int)));
 
   connect(m_ui->m_resetButton,SIGNAL(clicked()),m_gl,SLOT(reset()));
 }
@@ -43,3 +50,73 @@ MainWindow::~MainWindow()
 {
     delete m_ui;
 }
+
+void MainWindow::setRecording(bool _record)
+{
+    if (!_record)
+    {
+        if (!m_gl->stopRecording())
+        {
+            QMessageBox::warning(this, "Record Cache", "Not all of the point cache could be written.");
+        }
+        return;
+    }
+
+    QString path = QFileDialog::getSaveFileName(this, "Record Cache", QString(), "Point caches (*.pc)");
+    if (path.isEmpty() || !m_gl->startRecording(path.toStdString()))
+    {
+        if (!path.isEmpty())
+        {
+            QMessageBox::warning(this, "Record Cache", "The point cache couldn't be created.");
+        }
+        //put the box back without coming round here again
+        m_ui->m_recordCache->blockSignals(true);
+        m_ui->m_recordCache->setChecked(false);
+        m_ui->m_recordCache->blockSignals(false);
+    }
+}
+
+void MainWindow::setPlayback(bool _play)
+{
+    if (!_play)
+    {
+        m_gl->stopPlayback();
+        return;
+    }
+
+    QString path = QFileDialog::getOpenFileName(this, "Play Cache", QString(), "Point caches (*.pc)");
+    if (path.isEmpty() || !m_gl->startPlayback(path.toStdString()))
+    {
+        if (!path.isEmpty())
+        {
+            QMessageBox::warning(this, "Play Cache", "That file isn't a point cache with any frames in it.");
+        }
+        m_ui->m_playCache->blockSignals(true);
+        m_ui->m_playCache->setChecked(false);
+        m_ui->m_playCache->blockSignals(false);
+    }
+}
+
+void MainWindow::setReplayRecording(bool _record)
+{
+    if (!_record)
+    {
+        if (!m_gl->stopReplayRecording())
+        {
+            QMessageBox::warning(this, "Record Replay", "The replay couldn't be written.");
+        }
+        return;
+    }
+
+    QString path = QFileDialog::getSaveFileName(this, "Record Replay", QString(), "Replays (*.replay)");
+    if (path.isEmpty() || !m_gl->startReplayRecording(path.toStdString()))
+    {
+        if (!path.isEmpty())
+        {
+            QMessageBox::warning(this, "Record Replay", "The replay's starting state couldn't be saved.");
+        }
+        m_ui->m_recordReplay->blockSignals(true);
+        m_ui->m_recordReplay->setChecked(false);
+        m_ui->m_recordReplay->blockSignals(false);
+    }
+}
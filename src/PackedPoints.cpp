@@ -0,0 +1,111 @@
+#include "PackedPoints.h"
+#include <string.h>
+
+//like Integrator's AVX kernel, the F16C one is compiled with a function-level target so the rest of
+//the program doesn't need F16C to run
+#if (defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)) && defined(__GNUC__)
+    #define PACKEDPOINTS_HAS_F16C
+    #include <immintrin.h>
+    #define F16C_TARGET __attribute__((target("avx,f16c")))
+#endif
+
+namespace
+{
+#ifdef PACKEDPOINTS_HAS_F16C
+    F16C_TARGET void packF16C(const float *_points, uint16_t *_packed, const unsigned int &_begin, const unsigned int &_end)
+    {
+        //each particle is four floats in and four halves out, so two go at a time
+        unsigned int i = _begin;
+        for (; i + 2 <= _end; i += 2)
+        {
+            const __m256 points = _mm256_loadu_ps(_points + 4 * i);
+            _mm_storeu_si128((__m128i*)(_packed + 4 * i), _mm256_cvtps_ph(points, _MM_FROUND_TO_NEAREST_INT));
+        }
+        if (i < _end)
+        {
+            const __m128 point = _mm_loadu_ps(_points + 4 * i);
+            _mm_storel_epi64((__m128i*)(_packed + 4 * i), _mm_cvtps_ph(point, _MM_FROUND_TO_NEAREST_INT));
+        }
+    }
+
+    bool detectHardwareConversion()
+    {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+    }
+#endif
+}
+
+void PackedPoints::pack(const float *_points, uint16_t *_packed, const unsigned int &_begin, const unsigned int &_end)
+{
+#ifdef PACKEDPOINTS_HAS_F16C
+    if (hasHardwareConversion())
+    {
+        packF16C(_points, _packed, _begin, _end);
+        return;
+    }
+#endif
+    for (unsigned int i = 4 * _begin; i < 4 * _end; ++i)
+    {
+        _packed[i] = toHalf(_points[i]);
+    }
+}
+
+uint16_t PackedPoints::toHalf(const float &_value)
+{
+    uint32_t bits;
+    memcpy(&bits, &_value, sizeof(bits));
+    const uint32_t sign = (bits >> 16) & 0x8000u;
+    const int biasedExponent = (int)((bits >> 23) & 0xffu);
+    uint32_t mantissa = bits & 0x7fffffu;
+
+    //infinity stays infinity and NaN stays NaN
+    if (biasedExponent == 0xff)
+    {
+        return (uint16_t)(sign | 0x7c00u | (mantissa ? 0x200u : 0u));
+    }
+
+    const int exponent = biasedExponent - 127 + 15;
+    if (exponent >= 31)
+    {
+        return (uint16_t)(sign | 0x7c00u);
+    }
+
+    //too small for a normal half, so it becomes a denormal one, or zero
+    if (exponent <= 0)
+    {
+        if (exponent < -10)
+        {
+            return (uint16_t)sign;
+        }
+        mantissa |= 0x800000u;
+        const unsigned int shift = (unsigned int)(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        const uint32_t remainder = mantissa & ((1u << shift) - 1u);
+        const uint32_t midpoint = 1u << (shift - 1u);
+        if (remainder > midpoint || (remainder == midpoint && (half & 1u)))
+        {
+            ++half;
+        }
+        return (uint16_t)(sign | half);
+    }
+
+    //rounding up can carry into the exponent, which is still the right answer, even up to infinity
+    uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+    const uint32_t remainder = mantissa & 0x1fffu;
+    if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u)))
+    {
+        ++half;
+    }
+    return (uint16_t)(sign | half);
+}
+
+bool PackedPoints::hasHardwareConversion()
+{
+#ifdef PACKEDPOINTS_HAS_F16C
+    static bool hasF16C = detectHardwareConversion();
+    return hasF16C;
+#else
+    return false;
+#endif
+}
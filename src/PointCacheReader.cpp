@@ -0,0 +1,267 @@
+#include "PointCacheReader.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    //moves to an absolute position in the file, which may be beyond what a long can hold
+    bool seek(FILE *_file, const uint64_t &_offset)
+    {
+#ifdef _WIN32
+        return _fseeki64(_file, (__int64)_offset, SEEK_SET) == 0;
+#else
+        return fseeko(_file, (off_t)_offset, SEEK_SET) == 0;
+#endif
+    }
+
+    uint64_t getFileSize(FILE *_file)
+    {
+#ifdef _WIN32
+        _fseeki64(_file, 0, SEEK_END);
+        return (uint64_t)_ftelli64(_file);
+#else
+        fseeko(_file, 0, SEEK_END);
+        return (uint64_t)ftello(_file);
+#endif
+    }
+}
+
+PointCacheReader::PointCacheReader() : m_file(0), m_decodedFrame(-1)
+{
+    std::memset(&m_header, 0, sizeof(m_header));
+}
+
+PointCacheReader::~PointCacheReader()
+{
+    close();
+}
+
+bool PointCacheReader::open(const std::string &_path)
+{
+    close();
+
+    m_file = fopen(_path.c_str(), "rb");
+    if (!m_file)
+    {
+        return false;
+    }
+
+    if (fread(&m_header, sizeof(m_header), 1, m_file) != 1 ||
+        std::memcmp(m_header.m_magic, PointCache::FILE_MAGIC, sizeof(m_header.m_magic)) != 0 ||
+        m_header.m_version != PointCache::VERSION || m_header.m_headerSize != sizeof(PointCache::FileHeader) ||
+        m_header.m_encoding > (uint32_t)PointCache::DELTA || m_header.m_particleNum == 0 ||
+        (uint64_t)m_header.m_widthNum * (uint64_t)m_header.m_heightNum != m_header.m_particleNum || m_header.m_blockSize < 1)
+    {
+        close();
+        return false;
+    }
+
+    const uint64_t fileSize = getFileSize(m_file);
+    if (!readIndex(fileSize))
+    {
+        //the writer never finished; take whatever frames made it to disk
+        scanFrames(fileSize);
+    }
+    return true;
+}
+
+void PointCacheReader::close()
+{
+    if (m_file)
+    {
+        fclose(m_file);
+        m_file = 0;
+    }
+    std::memset(&m_header, 0, sizeof(m_header));
+    m_offsets.clear();
+    m_times.clear();
+    m_keyframes.clear();
+    m_decodedFrame = -1;
+}
+
+bool PointCacheReader::readIndex(const uint64_t &_fileSize)
+{
+    PointCache::IndexFooter footer;
+    if (_fileSize < sizeof(m_header) + sizeof(footer) || !seek(m_file, _fileSize - sizeof(footer)) ||
+        fread(&footer, sizeof(footer), 1, m_file) != 1 || std::memcmp(footer.m_magic, PointCache::INDEX_MAGIC, sizeof(footer.m_magic)) != 0 ||
+        footer.m_indexOffset + footer.m_frameNum * sizeof(uint64_t) + sizeof(footer) != _fileSize)
+    {
+        return false;
+    }
+
+    m_offsets.resize((size_t)footer.m_frameNum);
+    if (!m_offsets.empty() && (!seek(m_file, footer.m_indexOffset) || fread(&m_offsets[0], sizeof(uint64_t), m_offsets.size(), m_file) != m_offsets.size()))
+    {
+        m_offsets.clear();
+        return false;
+    }
+
+    //the times and keyframes come from the frame headers themselves
+    m_times.resize(m_offsets.size());
+    m_keyframes.resize(m_offsets.size());
+    for (unsigned int i=0; i<m_offsets.size(); ++i)
+    {
+        PointCache::FrameHeader header;
+        if (m_offsets[i] + sizeof(header) > footer.m_indexOffset || !seek(m_file, m_offsets[i]) ||
+            fread(&header, sizeof(header), 1, m_file) != 1 || header.m_magic != PointCache::FRAME_MAGIC)
+        {
+            m_offsets.clear();
+            m_times.clear();
+            m_keyframes.clear();
+            return false;
+        }
+        m_times[i] = header.m_time;
+        m_keyframes[i] = (header.m_flags & PointCache::KEYFRAME) != 0;
+    }
+    return true;
+}
+
+void PointCacheReader::scanFrames(const uint64_t &_fileSize)
+{
+    m_offsets.clear();
+    m_times.clear();
+    m_keyframes.clear();
+
+    uint64_t offset = sizeof(m_header);
+    PointCache::FrameHeader header;
+    while (offset + sizeof(header) <= _fileSize && seek(m_file, offset) && fread(&header, sizeof(header), 1, m_file) == 1 &&
+           header.m_magic == PointCache::FRAME_MAGIC && offset + sizeof(header) + header.m_payloadBytes <= _fileSize)
+    {
+        m_offsets.push_back(offset);
+        m_times.push_back(header.m_time);
+        m_keyframes.push_back((header.m_flags & PointCache::KEYFRAME) != 0);
+        offset += sizeof(header) + header.m_payloadBytes;
+    }
+}
+
+unsigned int PointCacheReader::findFrame(const double &_time) const
+{
+    std::vector<double>::const_iterator after = std::upper_bound(m_times.begin(), m_times.end(), _time);
+    return after == m_times.begin() ? 0 : (unsigned int)(after - m_times.begin()) - 1;
+}
+
+bool PointCacheReader::readFrame(const unsigned int &_frame, float _array[])
+{
+    if (!m_file || _frame >= m_offsets.size())
+    {
+        return false;
+    }
+
+    if ((int)_frame != m_decodedFrame)
+    {
+        //carry on from the frame we already have if we can, otherwise from the last keyframe
+        unsigned int first = _frame;
+        if (!(m_keyframes[_frame] || (m_decodedFrame >= 0 && (int)_frame == m_decodedFrame + 1)))
+        {
+            while (first > 0 && !m_keyframes[first])
+            {
+                --first;
+            }
+            if (m_decodedFrame >= 0 && (int)first <= m_decodedFrame && m_decodedFrame < (int)_frame)
+            {
+                first = (unsigned int)m_decodedFrame + 1;
+            }
+        }
+
+        for (unsigned int frame = first; frame <= _frame; ++frame)
+        {
+            if (!loadFrame(frame))
+            {
+                m_decodedFrame = -1;
+                return false;
+            }
+            decode();
+            m_decodedFrame = (int)frame;
+        }
+    }
+
+    for (unsigned int i=0; i<m_header.m_particleNum; ++i)
+    {
+        _array[4*i] = m_positions[3*i];
+        _array[4*i+1] = m_positions[3*i+1];
+        _array[4*i+2] = m_positions[3*i+2];
+        _array[4*i+3] = float(i);
+    }
+    return true;
+}
+
+bool PointCacheReader::loadFrame(const unsigned int &_frame)
+{
+    if (!seek(m_file, m_offsets[_frame]) || fread(&m_frameHeader, sizeof(m_frameHeader), 1, m_file) != 1 ||
+        m_frameHeader.m_magic != PointCache::FRAME_MAGIC)
+    {
+        return false;
+    }
+
+    //make sure the payload is big enough for what decode() reads from it
+    const uint64_t particleNum = m_header.m_particleNum;
+    uint64_t minimum = 0;
+    switch (m_header.m_encoding)
+    {
+        case PointCache::QUANTIZED :    minimum = 6 * sizeof(float) + 3 * particleNum * sizeof(uint16_t);   break;
+        case PointCache::DELTA :        minimum = 3 * particleNum;                                          break;
+        default :                       minimum = 3 * particleNum * sizeof(float);                          break;
+    }
+    if (m_frameHeader.m_payloadBytes < minimum)
+    {
+        return false;
+    }
+
+    m_payload.resize(m_frameHeader.m_payloadBytes);
+    return fread(&m_payload[0], 1, m_payload.size(), m_file) == m_payload.size();
+}
+
+void PointCacheReader::decode()
+{
+    const unsigned int particleNum = m_header.m_particleNum;
+    m_positions.resize(3 * particleNum);
+
+    switch (m_header.m_encoding)
+    {
+        case PointCache::QUANTIZED :
+        {
+            float bounds[6];
+            std::memcpy(bounds, &m_payload[0], sizeof(bounds));
+            const uint16_t *values = reinterpret_cast<const uint16_t*>(&m_payload[sizeof(bounds)]);
+            for (unsigned int i=0; i<3*particleNum; ++i)
+            {
+                const int c = i % 3;
+                m_positions[i] = bounds[c] + bounds[3+c] * (values[i] / 65535.0f);
+            }
+            break;
+        }
+
+        case PointCache::DELTA :
+        {
+            if ((m_frameHeader.m_flags & PointCache::KEYFRAME) || m_deltaValues.size() != 3 * particleNum)
+            {
+                m_deltaValues.assign(3 * particleNum, 0);
+            }
+
+            const unsigned char *byte = &m_payload[0];
+            const unsigned char *end = byte + m_payload.size();
+            for (unsigned int i=0; i<3*particleNum; ++i)
+            {
+                uint32_t bits = 0;
+                for (int shift = 0; byte != end && shift < 35; shift += 7)
+                {
+                    bits |= (uint32_t)(*byte & 0x7f) << shift;
+                    if (!(*byte++ & 0x80))
+                    {
+                        break;
+                    }
+                }
+                const int32_t delta = (int32_t)(bits >> 1) ^ -(int32_t)(bits & 1);
+                m_deltaValues[i] += delta;
+                m_positions[i] = m_deltaValues[i] * m_header.m_precision;
+            }
+            break;
+        }
+
+        default :
+        {
+            std::memcpy(&m_positions[0], &m_payload[0], 3 * particleNum * sizeof(float));
+            break;
+        }
+    }
+}
@@ -0,0 +1,260 @@
+#include "PointCacheWriter.h"
+#include "Cloth.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+//DELTA clamps rounded values to this so the difference between two of them always fits in 32 bits
+#define MAX_DELTA_VALUE 1000000000.0f
+
+PointCacheWriter::PointCacheWriter() : m_file(0), m_closing(false), m_framesAdded(0), m_offset(0), m_failed(false)
+{
+    std::memset(&m_header, 0, sizeof(m_header));
+}
+
+PointCacheWriter::~PointCacheWriter()
+{
+    close();
+}
+
+bool PointCacheWriter::open(const std::string &_path, const int &_widthNum, const int &_heightNum, const int &_blockSize,
+                            const PointCache::Encoding &_encoding, const float &_precision, const unsigned int &_keyframeInterval)
+{
+    close();
+
+    m_file = fopen(_path.c_str(), "wb");
+    if (!m_file)
+    {
+        return false;
+    }
+
+    std::memset(&m_header, 0, sizeof(m_header));
+    std::memcpy(m_header.m_magic, PointCache::FILE_MAGIC, sizeof(m_header.m_magic));
+    m_header.m_version = PointCache::VERSION;
+    m_header.m_headerSize = sizeof(PointCache::FileHeader);
+    m_header.m_encoding = (uint32_t)_encoding;
+    m_header.m_particleNum = (uint32_t)(_widthNum * _heightNum);
+    m_header.m_widthNum = _widthNum;
+    m_header.m_heightNum = _heightNum;
+    m_header.m_blockSize = _blockSize;
+    m_header.m_precision = _precision > 0.0f ? _precision : 1e-4f;
+    m_header.m_keyframeInterval = std::max(_keyframeInterval, 1u);
+
+    m_failed = fwrite(&m_header, sizeof(m_header), 1, m_file) != 1;
+    m_offset = sizeof(m_header);
+    m_offsets.clear();
+    m_framesAdded = 0;
+    m_closing = false;
+    m_thread = std::thread(&PointCacheWriter::writerLoop, this);
+    return true;
+}
+
+bool PointCacheWriter::close()
+{
+    if (!m_file)
+    {
+        return true;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closing = true;
+    }
+    m_wakeCondition.notify_one();
+    m_thread.join();
+
+    //the index lets readers seek; a file without one can still be read from the start
+    PointCache::IndexFooter footer;
+    footer.m_frameNum = m_offsets.size();
+    footer.m_indexOffset = m_offset;
+    std::memcpy(footer.m_magic, PointCache::INDEX_MAGIC, sizeof(footer.m_magic));
+    if (!m_offsets.empty() && fwrite(&m_offsets[0], sizeof(uint64_t), m_offsets.size(), m_file) != m_offsets.size())
+    {
+        m_failed = true;
+    }
+    if (fwrite(&footer, sizeof(footer), 1, m_file) != 1)
+    {
+        m_failed = true;
+    }
+    if (fclose(m_file) != 0)
+    {
+        m_failed = true;
+    }
+    m_file = 0;
+    return !m_failed;
+}
+
+void PointCacheWriter::addFrame(Cloth &_cloth, const double &_time)
+{
+    Frame frame = takeBuffer();
+    frame.m_points.resize(_cloth.getPointsArraySizeCopy() / sizeof(float));
+    _cloth.getPoints(&frame.m_points[0]);
+    frame.m_time = _time;
+    queue(frame);
+}
+
+void PointCacheWriter::addFrame(const std::vector<float> &_points, const double &_time)
+{
+    Frame frame = takeBuffer();
+    frame.m_points.assign(_points.begin(), _points.end());
+    frame.m_time = _time;
+    queue(frame);
+}
+
+PointCacheWriter::Frame PointCacheWriter::takeBuffer()
+{
+    Frame frame;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_spare.empty())
+    {
+        frame.m_points.swap(m_spare.back());
+        m_spare.pop_back();
+    }
+    return frame;
+}
+
+void PointCacheWriter::queue(Frame &_frame)
+{
+    if (!m_file || _frame.m_points.size() != 4 * (size_t)m_header.m_particleNum)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(Frame());
+        m_queue.back().m_points.swap(_frame.m_points);
+        m_queue.back().m_time = _frame.m_time;
+    }
+    ++m_framesAdded;
+    m_wakeCondition.notify_one();
+}
+
+void PointCacheWriter::writerLoop()
+{
+    Frame frame;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            //hand back the buffer we just wrote
+            if (!frame.m_points.empty())
+            {
+                m_spare.push_back(std::vector<float>());
+                m_spare.back().swap(frame.m_points);
+            }
+            m_wakeCondition.wait(lock, [this] {return m_closing || !m_queue.empty();});
+            if (m_queue.empty())
+            {
+                return;
+            }
+            frame.m_points.swap(m_queue.front().m_points);
+            frame.m_time = m_queue.front().m_time;
+            m_queue.pop_front();
+        }
+
+        const bool keyframe = m_offsets.size() % m_header.m_keyframeInterval == 0;
+        encode(frame, keyframe);
+
+        PointCache::FrameHeader header;
+        header.m_magic = PointCache::FRAME_MAGIC;
+        header.m_flags = (keyframe || m_header.m_encoding != PointCache::DELTA) ? PointCache::KEYFRAME : 0;
+        header.m_payloadBytes = (uint32_t)m_payload.size();
+        header.m_reserved = 0;
+        header.m_time = frame.m_time;
+
+        m_offsets.push_back(m_offset);
+        m_offset += sizeof(header) + m_payload.size();
+        if (fwrite(&header, sizeof(header), 1, m_file) != 1 || fwrite(&m_payload[0], 1, m_payload.size(), m_file) != m_payload.size())
+        {
+            m_failed = true;
+        }
+    }
+}
+
+void PointCacheWriter::encode(const Frame &_frame, const bool &_keyframe)
+{
+    const unsigned int particleNum = m_header.m_particleNum;
+    const float *points = &_frame.m_points[0];
+    m_payload.clear();
+
+    switch (m_header.m_encoding)
+    {
+        case PointCache::QUANTIZED :
+        {
+            float bounds[6] = {points[0], points[1], points[2], points[0], points[1], points[2]};
+            for (unsigned int i=0; i<particleNum; ++i)
+            {
+                for (int c=0; c<3; ++c)
+                {
+                    bounds[c] = std::min(bounds[c], points[4*i+c]);
+                    bounds[3+c] = std::max(bounds[3+c], points[4*i+c]);
+                }
+            }
+            //store the minimum and the extent
+            for (int c=0; c<3; ++c)
+            {
+                bounds[3+c] -= bounds[c];
+            }
+
+            m_payload.resize(sizeof(bounds) + 3 * particleNum * sizeof(uint16_t));
+            std::memcpy(&m_payload[0], bounds, sizeof(bounds));
+            uint16_t *values = reinterpret_cast<uint16_t*>(&m_payload[sizeof(bounds)]);
+            for (unsigned int i=0; i<particleNum; ++i)
+            {
+                for (int c=0; c<3; ++c)
+                {
+                    float fraction = bounds[3+c] > 0.0f ? (points[4*i+c] - bounds[c]) / bounds[3+c] : 0.0f;
+                    //a cloth that has blown up still gets recorded, just not meaningfully
+                    fraction = fraction >= 0.0f ? std::min(fraction, 1.0f) : 0.0f;
+                    values[3*i+c] = (uint16_t)std::lround(fraction * 65535.0f);
+                }
+            }
+            break;
+        }
+
+        case PointCache::DELTA :
+        {
+            if (_keyframe || m_previous.size() != 3 * particleNum)
+            {
+                m_previous.assign(3 * particleNum, 0);
+            }
+
+            const float scale = 1.0f / m_header.m_precision;
+            for (unsigned int i=0; i<particleNum; ++i)
+            {
+                for (int c=0; c<3; ++c)
+                {
+                    float scaled = points[4*i+c] * scale;
+                    scaled = scaled == scaled ? std::min(std::max(scaled, -MAX_DELTA_VALUE), MAX_DELTA_VALUE) : 0.0f;
+                    const int32_t value = (int32_t)std::lround(scaled);
+                    const int32_t delta = value - m_previous[3*i+c];
+                    m_previous[3*i+c] = value;
+
+                    //zigzag so small negative deltas are small too, then 7 bits per byte
+                    uint32_t bits = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+                    while (bits >= 0x80)
+                    {
+                        m_payload.push_back((unsigned char)(bits | 0x80));
+                        bits >>= 7;
+                    }
+                    m_payload.push_back((unsigned char)bits);
+                }
+            }
+            break;
+        }
+
+        default :
+        {
+            m_payload.resize(3 * particleNum * sizeof(float));
+            float *values = reinterpret_cast<float*>(&m_payload[0]);
+            for (unsigned int i=0; i<particleNum; ++i)
+            {
+                values[3*i] = points[4*i];
+                values[3*i+1] = points[4*i+1];
+                values[3*i+2] = points[4*i+2];
+            }
+            break;
+        }
+    }
+}
@@ -0,0 +1,276 @@
+#include "Replay.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+//bump this whenever the layout below changes; older logs are then refused rather than misread
+#define REPLAY_VERSION 1u
+//FNV-1a, which is plenty to tell two states apart and needs nothing but a multiply per byte
+#define HASH_OFFSET 14695981039346656037ull
+#define HASH_PRIME 1099511628211ull
+
+namespace
+{
+    const char MAGIC[8] = {'C','L','O','T','H','R','P','L'};
+
+    //bits of CommandRecord::m_flags
+    enum Flag
+    {
+        FLAG = 1 << 0,
+        TOP_LEFT = 1 << 1,
+        TOP_RIGHT = 1 << 2,
+        BOTTOM_LEFT = 1 << 3,
+        BOTTOM_RIGHT = 1 << 4
+    };
+
+    struct Header
+    {
+        char m_magic[8];
+        uint32_t m_version;
+        uint32_t m_headerSize;
+        uint32_t m_hashInterval;
+        uint32_t m_reserved;
+        uint64_t m_eventNum;
+        uint64_t m_checkpointNum;
+    };
+
+    //a ClothCommand with every field at a fixed size, since the struct itself has padding and
+    //ngl types in it
+    struct CommandRecord
+    {
+        uint64_t m_step;
+        uint32_t m_type;
+        int32_t m_intValue;
+        float m_value;
+        uint32_t m_flags;
+        float m_vector[3];
+        int32_t m_widthNum, m_heightNum, m_blockSize;
+        float m_width, m_height;
+        float m_springConstant, m_dampingConstant, m_sphereRadius;
+        uint32_t m_reserved;
+    };
+
+    static_assert(sizeof(Header) % 8 == 0 && sizeof(CommandRecord) % 8 == 0, "records are written back to back");
+
+    void hashBytes(uint64_t &_hash, const void *_data, const size_t &_bytes)
+    {
+        const unsigned char *byte = static_cast<const unsigned char*>(_data);
+        for (size_t i=0; i<_bytes; ++i)
+        {
+            _hash = (_hash ^ byte[i]) * HASH_PRIME;
+        }
+    }
+
+    template <typename T>
+    void hashArray(uint64_t &_hash, const std::vector<T> &_array)
+    {
+        if (!_array.empty())
+        {
+            hashBytes(_hash, &_array[0], _array.size() * sizeof(T));
+        }
+    }
+}
+
+Replay::Replay(const unsigned int &_hashInterval)
+{
+    clear(_hashInterval);
+}
+
+void Replay::clear(const unsigned int &_hashInterval)
+{
+    m_hashInterval = std::max(_hashInterval, 1u);
+    m_events.clear();
+    m_checkpoints.clear();
+}
+
+void Replay::addCommand(const uint64_t &_step, const ClothCommand &_command)
+{
+    Event event;
+    event.m_step = _step;
+    event.m_command = _command;
+    m_events.push_back(event);
+}
+
+void Replay::addCheckpoint(const uint64_t &_step, const Cloth &_cloth, const bool &_force)
+{
+    if (!m_checkpoints.empty() && (_step <= m_checkpoints.back().m_step || (!_force && _step < m_checkpoints.back().m_step + m_hashInterval)))
+    {
+        return;
+    }
+
+    Checkpoint checkpoint;
+    checkpoint.m_step = _step;
+    checkpoint.m_hash = hashState(_cloth);
+    m_checkpoints.push_back(checkpoint);
+}
+
+bool Replay::save(const std::string &_path) const
+{
+    std::ofstream file(_path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        return false;
+    }
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.m_magic, MAGIC, sizeof(header.m_magic));
+    header.m_version = REPLAY_VERSION;
+    header.m_headerSize = sizeof(Header);
+    header.m_hashInterval = m_hashInterval;
+    header.m_eventNum = m_events.size();
+    header.m_checkpointNum = m_checkpoints.size();
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    for (std::vector<Event>::const_iterator it=m_events.begin(); it!=m_events.end(); ++it)
+    {
+        const ClothCommand &command = it->m_command;
+        CommandRecord record;
+        std::memset(&record, 0, sizeof(record));
+        record.m_step = it->m_step;
+        record.m_type = (uint32_t)command.m_type;
+        record.m_intValue = command.m_intValue;
+        record.m_value = command.m_value;
+        record.m_flags = (command.m_flag ? FLAG : 0) | (command.m_info.anchoredTopLeft ? TOP_LEFT : 0) |
+                         (command.m_info.anchoredTopRight ? TOP_RIGHT : 0) | (command.m_info.anchoredBottomLeft ? BOTTOM_LEFT : 0) |
+                         (command.m_info.anchoredBottomRight ? BOTTOM_RIGHT : 0);
+        record.m_vector[0] = command.m_vector.m_x;
+        record.m_vector[1] = command.m_vector.m_y;
+        record.m_vector[2] = command.m_vector.m_z;
+        record.m_widthNum = command.m_info.widthNum;
+        record.m_heightNum = command.m_info.heightNum;
+        record.m_blockSize = command.m_info.blockSize;
+        record.m_width = command.m_info.width;
+        record.m_height = command.m_info.height;
+        record.m_springConstant = command.m_info.springConstant;
+        record.m_dampingConstant = command.m_info.dampingConstant;
+        record.m_sphereRadius = command.m_info.sphereRadius;
+        file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+    }
+
+    if (!m_checkpoints.empty())
+    {
+        file.write(reinterpret_cast<const char*>(&m_checkpoints[0]), (std::streamsize)(m_checkpoints.size() * sizeof(Checkpoint)));
+    }
+
+    file.close();
+    return !file.fail();
+}
+
+bool Replay::load(const std::string &_path)
+{
+    std::ifstream file(_path.c_str(), std::ios::in | std::ios::binary);
+    Header header;
+    if (!file || !file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.m_magic, MAGIC, sizeof(header.m_magic)) != 0 || header.m_version != REPLAY_VERSION ||
+        header.m_headerSize != sizeof(Header) || header.m_hashInterval == 0)
+    {
+        return false;
+    }
+
+    //read into fresh vectors so a truncated file leaves the log as it was
+    std::vector<Event> events;
+    for (uint64_t i=0; i<header.m_eventNum; ++i)
+    {
+        CommandRecord record;
+        if (!file.read(reinterpret_cast<char*>(&record), sizeof(record)) || record.m_type > (uint32_t)ClothCommand::SET_SLEEPING)
+        {
+            return false;
+        }
+
+        Event event;
+        event.m_step = record.m_step;
+        ClothCommand &command = event.m_command;
+        command.m_type = (ClothCommand::Type)record.m_type;
+        command.m_intValue = record.m_intValue;
+        command.m_value = record.m_value;
+        command.m_flag = (record.m_flags & FLAG) != 0;
+        command.m_vector = ngl::Vec3(record.m_vector[0], record.m_vector[1], record.m_vector[2]);
+        command.m_info.anchoredTopLeft = (record.m_flags & TOP_LEFT) != 0;
+        command.m_info.anchoredTopRight = (record.m_flags & TOP_RIGHT) != 0;
+        command.m_info.anchoredBottomLeft = (record.m_flags & BOTTOM_LEFT) != 0;
+        command.m_info.anchoredBottomRight = (record.m_flags & BOTTOM_RIGHT) != 0;
+        command.m_info.widthNum = record.m_widthNum;
+        command.m_info.heightNum = record.m_heightNum;
+        command.m_info.blockSize = record.m_blockSize;
+        command.m_info.width = record.m_width;
+        command.m_info.height = record.m_height;
+        command.m_info.springConstant = record.m_springConstant;
+        command.m_info.dampingConstant = record.m_dampingConstant;
+        command.m_info.sphereRadius = record.m_sphereRadius;
+        events.push_back(event);
+    }
+
+    std::vector<Checkpoint> checkpoints;
+    for (uint64_t i=0; i<header.m_checkpointNum; ++i)
+    {
+        Checkpoint checkpoint;
+        if (!file.read(reinterpret_cast<char*>(&checkpoint), sizeof(checkpoint)))
+        {
+            return false;
+        }
+        checkpoints.push_back(checkpoint);
+    }
+
+    m_hashInterval = header.m_hashInterval;
+    m_events.swap(events);
+    m_checkpoints.swap(checkpoints);
+    return true;
+}
+
+bool Replay::play(Cloth &_cloth, std::vector<Divergence> &_divergences) const
+{
+    _divergences.clear();
+    std::vector<Event>::const_iterator event = m_events.begin();
+    std::vector<Checkpoint>::const_iterator checkpoint = m_checkpoints.begin();
+    for (uint64_t step = 0; checkpoint != m_checkpoints.end(); ++step)
+    {
+        //a checkpoint was taken at the end of a batch of steps, so before any command applied
+        //between that batch and the next
+        if (checkpoint->m_step == step)
+        {
+            const uint64_t hash = hashState(_cloth);
+            if (hash != checkpoint->m_hash)
+            {
+                Divergence divergence;
+                divergence.m_step = step;
+                divergence.m_expected = checkpoint->m_hash;
+                divergence.m_actual = hash;
+                _divergences.push_back(divergence);
+            }
+            if (++checkpoint == m_checkpoints.end())
+            {
+                break;
+            }
+        }
+
+        for (; event != m_events.end() && event->m_step <= step; ++event)
+        {
+            event->m_command.apply(_cloth);
+        }
+
+        //pausing only stopped the clock that decided when to step, which the log replaces
+        _cloth.step();
+    }
+    return _divergences.empty();
+}
+
+uint64_t Replay::hashState(const Cloth &_cloth)
+{
+    const CS::ParticleStore &particles = _cloth.getParticles();
+    uint64_t hash = HASH_OFFSET;
+    hashArray(hash, particles.m_posX);
+    hashArray(hash, particles.m_posY);
+    hashArray(hash, particles.m_posZ);
+    hashArray(hash, particles.m_prevPosX);
+    hashArray(hash, particles.m_prevPosY);
+    hashArray(hash, particles.m_prevPosZ);
+    hashArray(hash, particles.m_isAnchored);
+    hashArray(hash, _cloth.getWarmStart());
+
+    const CS::Particle &sphere = _cloth.m_sphere;
+    const float sphereState[7] = {sphere.m_pos.m_x, sphere.m_pos.m_y, sphere.m_pos.m_z,
+                                  sphere.m_prevPos.m_x, sphere.m_prevPos.m_y, sphere.m_prevPos.m_z, sphere.m_radius};
+    hashBytes(hash, sphereState, sizeof(sphereState));
+    return hash;
+}
@@ -0,0 +1,211 @@
+#include "SimulationThread.h"
+#include "ClothFile.h"
+#include <algorithm>
+#include <chrono>
+
+//set in m_ready when the snapshot it points to hasn't been taken by the reader yet
+#define SNAPSHOT_FRESH 4u
+#define SNAPSHOT_INDEX 3u
+//the longest the thread sleeps between checks for new commands, in seconds
+#define MAX_SLEEP 0.002f
+//a particle that has moved less than this since it was last published doesn't count as changed,
+//so a cloth that has settled stops being sent to the GPU
+#define CHANGE_TOLERANCE 1e-5f
+
+SimulationThread::SimulationThread() : m_cloth(), m_quit(false), m_ready(1), m_writing(0), m_reading(2), m_generation(0), m_stepCount(0), m_time(0.0), m_version(0), m_recording(false), m_replayStartStep(0)
+{
+    //make sure there is something to draw before the thread has run at all
+    publish();
+    acquireSnapshot();
+}
+
+SimulationThread::~SimulationThread()
+{
+    stop();
+    stopRecording();
+}
+
+void SimulationThread::start()
+{
+    if (m_thread.joinable())
+    {
+        return;
+    }
+
+    m_quit = false;
+    m_thread = std::thread(&SimulationThread::run, this);
+}
+
+void SimulationThread::stop()
+{
+    m_quit = true;
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+}
+
+void SimulationThread::post(const Command &_command)
+{
+    //the queue is only full if the simulation has fallen a long way behind; it drains it every
+    //pass, so just wait for room rather than losing the change
+    while (!m_commands.push(_command))
+    {
+        std::this_thread::yield();
+    }
+
+    //nothing is stepping the cloth, so make the change straight away
+    if (!m_thread.joinable())
+    {
+        applyCommands();
+        publish();
+    }
+}
+
+bool SimulationThread::startRecording(const std::string &_path, const unsigned int &_hashInterval)
+{
+    //the cloth is only ours to touch while the thread is stopped, which also puts us between steps
+    const bool wasRunning = m_thread.joinable();
+    stop();
+    stopRecording();
+
+    //anything already posted is part of the starting state rather than the recording
+    applyCommands();
+    //a loaded cloth starts awake, so the recording has to as well
+    m_cloth.wakeAll();
+    bool saved = ClothFile::save(m_cloth, Replay::getStatePath(_path));
+    if (saved)
+    {
+        m_replay.clear(_hashInterval);
+        m_replay.addCheckpoint(0, m_cloth, true);
+        m_replayPath = _path;
+        m_replayStartStep = m_stepCount;
+        m_recording = true;
+    }
+
+    if (wasRunning)
+    {
+        start();
+    }
+    return saved;
+}
+
+bool SimulationThread::stopRecording()
+{
+    if (!m_recording)
+    {
+        return true;
+    }
+
+    const bool wasRunning = m_thread.joinable();
+    stop();
+
+    //finish on the state the last step left, before any commands still waiting
+    m_replay.addCheckpoint(m_stepCount - m_replayStartStep, m_cloth, true);
+    m_recording = false;
+    bool saved = m_replay.save(m_replayPath);
+
+    if (wasRunning)
+    {
+        start();
+    }
+    return saved;
+}
+
+bool SimulationThread::acquireSnapshot()
+{
+    if (!(m_ready.load(std::memory_order_acquire) & SNAPSHOT_FRESH))
+    {
+        return false;
+    }
+
+    //swap our old snapshot for the newest one; the writer will reuse ours next
+    m_reading = m_ready.exchange(m_reading, std::memory_order_acq_rel) & SNAPSHOT_INDEX;
+    return true;
+}
+
+void SimulationThread::publish()
+{
+    Snapshot &snapshot = m_snapshots[m_writing];
+    snapshot.m_points.resize(m_cloth.getPointsArraySizeCopy() / sizeof(GLfloat));
+    m_cloth.getPoints(&snapshot.m_points[0]);
+    m_cloth.updateTileVersions(++m_version, CHANGE_TOLERANCE);
+    snapshot.m_tileVersions = m_cloth.getTileVersions();
+    snapshot.m_version = m_version;
+    snapshot.m_widthNum = m_cloth.getWidthNum();
+    snapshot.m_heightNum = m_cloth.getHeightHum();
+    snapshot.m_blockSize = m_cloth.getBlockSize();
+    snapshot.m_spherePos = m_cloth.m_sphere.m_pos;
+    snapshot.m_sphereRadius = m_cloth.m_sphere.m_radius;
+    snapshot.m_generation = m_generation;
+    snapshot.m_stepCount = m_stepCount;
+    snapshot.m_time = m_time;
+
+    //swap it in as the newest, taking back whichever one was there before (if the reader hasn't
+    //taken that one, it is simply overwritten next time)
+    m_writing = m_ready.exchange(m_writing | SNAPSHOT_FRESH, std::memory_order_acq_rel) & SNAPSHOT_INDEX;
+}
+
+void SimulationThread::run()
+{
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point lastTime = Clock::now();
+
+    while (!m_quit)
+    {
+        bool changed = applyCommands();
+
+        Clock::time_point now = Clock::now();
+        float elapsed = std::chrono::duration<float>(now - lastTime).count();
+        lastTime = now;
+
+        //time spent paused doesn't count towards the next step
+        if (!m_cloth.isPaused())
+        {
+            unsigned int steps = m_cloth.update(elapsed);
+            m_stepCount += steps;
+            m_time += steps * (double)m_cloth.getTimestep();
+            changed = changed || steps > 0;
+
+            //checkpoints only go at the end of a batch, so they always come before the commands
+            //applied at the same step
+            if (m_recording && steps > 0)
+            {
+                m_replay.addCheckpoint(m_stepCount - m_replayStartStep, m_cloth);
+            }
+        }
+
+        if (changed)
+        {
+            publish();
+        }
+
+        //sleep until the next timestep is due, waking regularly to pick up new commands
+        float untilNextStep = m_cloth.getTimestep() * (1.0f - m_cloth.getInterpolationAlpha());
+        std::this_thread::sleep_for(std::chrono::duration<float>(std::min(untilNextStep, MAX_SLEEP)));
+    }
+}
+
+void SimulationThread::apply(const Command &_command)
+{
+    if (m_recording)
+    {
+        m_replay.addCommand(m_stepCount - m_replayStartStep, _command);
+    }
+    if (_command.apply(m_cloth))
+    {
+        ++m_generation;
+    }
+}
+
+bool SimulationThread::applyCommands()
+{
+    bool applied = false;
+    Command command;
+    while (m_commands.pop(command))
+    {
+        apply(command);
+        applied = true;
+    }
+    return applied;
+}
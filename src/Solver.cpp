@@ -1,13 +1,34 @@
 
 #include "Solver.h"
+#include "Integrator.h"
+#include "ThreadPool.h"
+#include <algorithm>
 #include <iostream>
+#include <limits>
 #include <math.h>
 #include <ngl/NGLStream.h>
 
 #define IMPULSE_SCALE 2.0f
 #define AIR_RESISTANCE -256.f
+//below this many springs, handing the pass out to other threads costs more than it saves
+#define PARALLEL_SPRING_THRESHOLD 16384
+#define SPRING_GRAIN 4096
+#define PARTICLE_GRAIN 2048
+//how many particles make up a tile, the unit most of advance()'s tasks work on
+#define PARTICLE_TILE 4096
+//marks a tile with no task touching it yet
+#define NO_TASK 0xffffffffu
+#define DEFAULT_ITERATIONS 8
+#define DEFAULT_SOLVE_ITERATIONS 64
+#define DEFAULT_SOLVE_TOLERANCE 1e-4f
+#define ROW_GRAIN 2048
+//how fast, in units per second of simulated time, a tile can drift and still count as still
+#define SLEEP_SPEED 0.02f
 
-Solver::Solver() : m_applySelfCollision(false), m_applySphereCollision(true), m_applyWind(false), m_gravity(32.0f), m_speed(1.0f)
+static_assert(PARTICLE_TILE % SLEEP_TILE_SIZE == 0, "each task's tile must hold whole sleep tiles");
+
+Solver::Solver() : m_applySelfCollision(false), m_applySphereCollision(true), m_applyWind(false), m_allowSleeping(false), m_gravity(32.0f), m_speed(1.0f), m_sphere(0), m_mode(FORCE_BASED), m_iterations(DEFAULT_ITERATIONS),
+    m_maxSolveIterations(DEFAULT_SOLVE_ITERATIONS), m_solveTolerance(DEFAULT_SOLVE_TOLERANCE), m_isStepping(false), m_springForces(0), m_windForces(0), m_lambdas(0), m_hasPattern(false), m_lastSolveIterations(0), m_hasSleepTopology(false), m_isSleeping(false), m_wholeTask(NO_TASK)
 {
 }
 
@@ -16,84 +37,946 @@ Solver::~Solver()
 
 }
 
-void Solver::advance(std::vector<CS::Spring>* _springs, std::vector<CS::Particle>* _particles, const double &_time, const float &_deltaSeconds)
+void Solver::advance(const CS::SpringStore* _springs, CS::ParticleStore* _particles, const double &_time, const float &_deltaSeconds)
 {
-    //calculate the springs' forces acting on the particles
-    for(std::vector<CS::Spring>::iterator it=_springs->begin(); it!=_springs->end(); ++it)
+    const unsigned int particleNum = _particles->size();
+    const unsigned int springNum = _springs->size();
+    const float newDelta = _deltaSeconds * m_speed;
+    ThreadPool *pool = ThreadPool::instance();
+
+    //nothing from the last step is needed any more
+    m_arena.reset();
+    m_isStepping = true;
+
+    prepareSleep(_springs, _particles);
+
+    //wind is the only force that needs a cos() per particle, so it is worked out separately and
+    //handed to the integration kernel as an array
+    const float *wind = 0;
+    if (m_applyWind && particleNum > 0)
     {
-        updateSpring(&(*it));
+        m_windForces = m_arena.allocate<float>(particleNum);
+        wind = m_windForces;
     }
 
-    //calculate other forces and then update particle positions accordingly
-    for(std::vector<CS::Particle>::iterator it=_particles->begin(); it!=_particles->end(); ++it)
+    //the step is built as a graph of tasks, most of them covering one tile of particles, so that
+    //each tile can go on to its collisions as soon as it has been integrated rather than waiting
+    //for the rest of the cloth. m_tileTasks holds the last task to touch each tile, and
+    //m_wholeTask the last one to touch every particle at once
+    m_graph.clear();
+    const unsigned int tileNum = (particleNum + PARTICLE_TILE - 1) / PARTICLE_TILE;
+    m_tileTasks.assign(tileNum, NO_TASK);
+    m_wholeTask = NO_TASK;
+
+    //calculate the springs' forces acting on the particles; in XPBD mode the springs are
+    //constraints instead, so the integration below just predicts where everything else takes them,
+    //and the implicit mode works out their forces as part of building its system
+    if (m_mode == FORCE_BASED)
     {
-        if(!(*it).m_isAnchored)
+        if (pool->getThreadCount() == 1 || springNum < PARALLEL_SPRING_THRESHOLD || !_springs->hasIncidence(particleNum))
         {
-            //gravity
-            (*it).addForce(ngl::Vec3(0,m_gravity,0));
+            m_wholeTask = m_graph.addTask([=]()
+            {
+                for(unsigned int i=0; i<springNum; ++i)
+                {
+                    if (!isSpringAsleep(_springs, i))
+                    {
+                        updateSpring(_particles, _springs, i);
+                    }
+                }
+            });
+        }
+        else
+        {
+            //see accumulateSpringForces(); every tile has to wait for all of the springs, since
+            //they are sorted by colour rather than by where they are
+            m_springForces = m_arena.allocate<ngl::Vec3>(springNum);
+            const unsigned int forces = m_graph.addRange(0, springNum, SPRING_GRAIN, [=](unsigned int _begin, unsigned int _end)
+            {
+                computeSpringForces(_particles, _springs, _begin, _end);
+            });
+            for (unsigned int t=0; t<tileNum; ++t)
+            {
+                m_tileTasks[t] = m_graph.addRange(t * PARTICLE_TILE, std::min((t + 1) * PARTICLE_TILE, particleNum), PARTICLE_TILE, [=](unsigned int _begin, unsigned int _end)
+                {
+                    gatherSpringForces(_particles, _springs, _begin, _end);
+                });
+                m_graph.addDependency(forces, m_tileTasks[t]);
+            }
+        }
+    }
 
-            //air resistance
-            ngl::Vec3 approximateVelocity = (*it).m_prevPos - (*it).m_pos;
-            (*it).addForce(AIR_RESISTANCE * approximateVelocity);
+    //calculate other forces and then update particle positions accordingly, a tile at a time
+    for (unsigned int t=0; t<tileNum; ++t)
+    {
+        const unsigned int task = m_graph.addRange(t * PARTICLE_TILE, std::min((t + 1) * PARTICLE_TILE, particleNum), PARTICLE_TILE, [=](unsigned int _begin, unsigned int _end)
+        {
+            if (wind)
+            {
+                computeWind(_particles, _time, _begin, _end);
+            }
+            if (m_isSleeping)
+            {
+                integrateAwake(_particles, wind, _begin, _end, newDelta * newDelta);
+            }
+            else if (m_mode != IMPLICIT)
+            {
+                Integrator::integrate(_particles, wind, _begin, _end, m_gravity, AIR_RESISTANCE, newDelta * newDelta);
+            }
+        });
+        addTileTask(t, task);
+    }
 
-            //wind
-            if(m_applyWind)
+    //the rest of the step needs the whole cloth at once, apart from the sphere collisions
+    if (m_mode == IMPLICIT)
+    {
+        addWholeTask(m_graph.addTask([=]()
+        {
+            stepImplicit(_particles, _springs, wind, newDelta);
+        }));
+    }
+    else if (m_mode == XPBD)
+    {
+        addWholeTask(m_graph.addTask([=]()
+        {
+            projectDistanceConstraints(_particles, _springs, newDelta);
+        }));
+    }
+
+    if (m_applySelfCollision)
+    {
+        addWholeTask(m_graph.addTask([=]()
+        {
+            resolveSelfCollisions(_particles);
+        }));
+    }
+
+    if (m_sphere && m_applySphereCollision)
+    {
+        const CS::Particle *sphere = m_sphere;
+        for (unsigned int t=0; t<tileNum; ++t)
+        {
+            const unsigned int task = m_graph.addRange(t * PARTICLE_TILE, std::min((t + 1) * PARTICLE_TILE, particleNum), PARTICLE_TILE, [=](unsigned int _begin, unsigned int _end)
+            {
+                //a sleeping tile the sphere could reach has already been woken by prepareSleep()
+                for (unsigned int begin=_begin; begin<_end; begin+=SLEEP_TILE_SIZE)
+                {
+                    if (isAsleep(begin))
+                    {
+                        continue;
+                    }
+                    const unsigned int end = std::min(begin + SLEEP_TILE_SIZE, _end);
+                    for(unsigned int i=begin; i<end; ++i)
+                    {
+                        resolveSweptCollision(_particles, i, sphere);
+                    }
+                }
+            });
+            addTileTask(t, task);
+        }
+    }
+
+    //see how far each tile moved once it is finished with, then decide which tiles sleep
+    if (m_isSleeping)
+    {
+        for (unsigned int t=0; t<tileNum; ++t)
+        {
+            const unsigned int task = m_graph.addRange(t * PARTICLE_TILE, std::min((t + 1) * PARTICLE_TILE, particleNum), PARTICLE_TILE, [=](unsigned int _begin, unsigned int _end)
             {
-                ngl::Vec3 wind = 512.0f*ngl::Vec3(0.0f,0.0f,cos((_time*128+(*it).m_pos.m_x*32+(*it).m_pos.m_y*32)*0.1)*0.15);//arbitrary function to create energy in the system
-                (*it).addForce(wind);
+                measureMotion(_particles, _begin, _end);
+            });
+            addTileTask(t, task);
+        }
+        addWholeTask(m_graph.addTask([=]()
+        {
+            updateSleep(_particles, SLEEP_SPEED * newDelta);
+        }));
+    }
+
+    pool->run(m_graph);
+    m_isStepping = false;
+}
+
+void Solver::wakeAll()
+{
+    std::fill(m_sleepCounters.begin(), m_sleepCounters.end(), 0);
+}
+
+unsigned int Solver::getSleepingTileNum() const
+{
+    return (unsigned int)std::count(m_sleepCounters.begin(), m_sleepCounters.end(), SLEEP_STEPS);
+}
+
+bool Solver::isSpringAsleep(const CS::SpringStore *_springs, const unsigned int &_index) const
+{
+    const CS::Spring &spring = (*_springs)[_index];
+    return isAsleep(spring.m_startParticle) && isAsleep(spring.m_endParticle);
+}
+
+void Solver::integrateAwake(CS::ParticleStore *_particles, const float *_windZ, const unsigned int &_begin, const unsigned int &_end, const float &_deltaSquared)
+{
+    for (unsigned int begin=_begin; begin<_end; begin+=SLEEP_TILE_SIZE)
+    {
+        const unsigned int end = std::min(begin + SLEEP_TILE_SIZE, _end);
+        if (!isAsleep(begin))
+        {
+            Integrator::integrate(_particles, _windZ, begin, end, m_gravity, AIR_RESISTANCE, _deltaSquared);
+        }
+        else
+        {
+            std::fill(_particles->m_forceX.begin() + begin, _particles->m_forceX.begin() + end, 0.0f);
+            std::fill(_particles->m_forceY.begin() + begin, _particles->m_forceY.begin() + end, 0.0f);
+            std::fill(_particles->m_forceZ.begin() + begin, _particles->m_forceZ.begin() + end, 0.0f);
+        }
+    }
+}
+
+void Solver::prepareSleep(const CS::SpringStore *_springs, const CS::ParticleStore *_particles)
+{
+    const unsigned int particleNum = _particles->size();
+    const unsigned int tileNum = (particleNum + SLEEP_TILE_SIZE - 1) / SLEEP_TILE_SIZE;
+    if (m_sleepCounters.size() != tileNum)
+    {
+        m_sleepCounters.assign(tileNum, 0);
+        m_hasSleepTopology = false;
+    }
+
+    //wind pushes on every particle all the time, and the implicit solve moves the whole cloth at
+    //once, so neither leaves anything still enough to skip
+    m_isSleeping = m_allowSleeping && !m_applyWind && m_mode != IMPLICIT && particleNum > 0;
+    if (!m_isSleeping)
+    {
+        wakeAll();
+        return;
+    }
+
+    m_tileMotion.resize(tileNum);
+    m_tileBounds.resize(tileNum * 6);
+    if (!m_hasSleepTopology)
+    {
+        //a tile moving can only disturb the tiles it is joined to by springs
+        uint64_t *pairs = m_arena.allocate<uint64_t>(2 * (size_t)_springs->size());
+        size_t pairNum = 0;
+        for (unsigned int i=0; i<_springs->size(); ++i)
+        {
+            const uint64_t a = (*_springs)[i].m_startParticle / SLEEP_TILE_SIZE;
+            const uint64_t b = (*_springs)[i].m_endParticle / SLEEP_TILE_SIZE;
+            if (a != b)
+            {
+                pairs[pairNum++] = (a << 32) | b;
+                pairs[pairNum++] = (b << 32) | a;
             }
+        }
+        std::sort(pairs, pairs + pairNum);
+        pairNum = size_t(std::unique(pairs, pairs + pairNum) - pairs);
 
-            updateParticle(&(*it), _deltaSeconds);
+        m_tileNeighbourOffsets.assign(tileNum + 1, 0);
+        m_tileNeighbours.resize(pairNum);
+        for (size_t k=0; k<pairNum; ++k)
+        {
+            ++m_tileNeighbourOffsets[(pairs[k] >> 32) + 1];
+            m_tileNeighbours[k] = uint32_t(pairs[k]);
+        }
+        for (unsigned int t=0; t<tileNum; ++t)
+        {
+            m_tileNeighbourOffsets[t+1] += m_tileNeighbourOffsets[t];
         }
+        m_hasSleepTopology = true;
     }
 
-    if (m_applySelfCollision)
+    //the sphere is the one thing that can move into a sleeping tile without a neighbour moving
+    //first, so wake anything its path this step could touch
+    //(compared exactly, as even a slow creep adds up)
+    const CS::Particle *sphere = m_sphere;
+    if (sphere && m_applySphereCollision)
     {
-        //adjust for collisions
-        for(std::vector<CS::Particle>::iterator first=_particles->begin(); first!=_particles->end()-1; ++first)
+        const float pos[3] = {sphere->m_pos.m_x, sphere->m_pos.m_y, sphere->m_pos.m_z};
+        const float prevPos[3] = {sphere->m_prevPos.m_x, sphere->m_prevPos.m_y, sphere->m_prevPos.m_z};
+        if (pos[0] == prevPos[0] && pos[1] == prevPos[1] && pos[2] == prevPos[2])
+        {
+            return;
+        }
+        float sweptMin[3], sweptMax[3];
+        for (int axis=0; axis<3; ++axis)
+        {
+            sweptMin[axis] = std::min(pos[axis], prevPos[axis]) - sphere->m_radius;
+            sweptMax[axis] = std::max(pos[axis], prevPos[axis]) + sphere->m_radius;
+        }
+        for (unsigned int t=0; t<tileNum; ++t)
         {
-            for(std::vector<CS::Particle>::iterator second=first+1; second!=_particles->end(); ++second)
+            if (m_sleepCounters[t] < SLEEP_STEPS)
+            {
+                continue;
+            }
+            const float *bounds = &m_tileBounds[t * 6];
+            bool overlaps = true;
+            for (int axis=0; axis<3; ++axis)
+            {
+                overlaps = overlaps && sweptMin[axis] <= bounds[axis + 3] && bounds[axis] <= sweptMax[axis];
+            }
+            if (overlaps)
             {
-                    resolveCollisionTranslate(&(*first), &(*second));
+                m_sleepCounters[t] = 0;
             }
         }
     }
+}
 
-    if (m_sphere && m_applySphereCollision)
+void Solver::measureMotion(const CS::ParticleStore *_particles, const unsigned int &_begin, const unsigned int &_end)
+{
+    for (unsigned int begin=_begin; begin<_end; begin+=SLEEP_TILE_SIZE)
+    {
+        const unsigned int end = std::min(begin + SLEEP_TILE_SIZE, _end);
+        float motion = 0.0f;
+        if (!isAsleep(begin))
+        {
+            //only the solver's own motion counts; anchors don't move, but nor do they get a
+            //previous position that matches
+            for (unsigned int i=begin; i<end; ++i)
+            {
+                if (_particles->m_isAnchored[i])
+                {
+                    continue;
+                }
+                motion = std::max(motion, std::fabs(_particles->m_posX[i] - _particles->m_prevPosX[i]));
+                motion = std::max(motion, std::fabs(_particles->m_posY[i] - _particles->m_prevPosY[i]));
+                motion = std::max(motion, std::fabs(_particles->m_posZ[i] - _particles->m_prevPosZ[i]));
+            }
+        }
+        m_tileMotion[begin / SLEEP_TILE_SIZE] = motion;
+    }
+}
+
+void Solver::updateSleep(CS::ParticleStore *_particles, const float &_threshold)
+{
+    const unsigned int tileNum = m_sleepCounters.size();
+    const unsigned int particleNum = _particles->size();
+
+    m_fallingAsleep.clear();
+    for (unsigned int t=0; t<tileNum; ++t)
+    {
+        if (m_sleepCounters[t] < SLEEP_STEPS)
+        {
+            m_sleepCounters[t] = isMoving(t, _threshold) ? 0 : m_sleepCounters[t] + 1;
+            if (m_sleepCounters[t] == SLEEP_STEPS)
+            {
+                m_fallingAsleep.push_back(t);
+            }
+        }
+    }
+
+    //a tile that is still moving pulls on its neighbours through their shared springs, so they
+    //have to start counting again whether they are asleep or not
+    for (unsigned int t=0; t<tileNum; ++t)
+    {
+        if (isMoving(t, _threshold))
+        {
+            for (uint32_t k=m_tileNeighbourOffsets[t]; k<m_tileNeighbourOffsets[t+1]; ++k)
+            {
+                m_sleepCounters[m_tileNeighbours[k]] = 0;
+            }
+        }
+    }
+
+    for (std::vector<unsigned int>::iterator it=m_fallingAsleep.begin(); it!=m_fallingAsleep.end(); ++it)
+    {
+        const unsigned int t = *it;
+        if (m_sleepCounters[t] < SLEEP_STEPS)
+        {
+            continue;
+        }
+
+        //stop the tile dead, so that it starts from rest whenever it wakes, and remember where it
+        //is for prepareSleep()
+        const unsigned int begin = t * SLEEP_TILE_SIZE;
+        const unsigned int end = std::min(begin + SLEEP_TILE_SIZE, particleNum);
+        float *bounds = &m_tileBounds[t * 6];
+        bounds[0] = bounds[1] = bounds[2] = std::numeric_limits<float>::max();
+        bounds[3] = bounds[4] = bounds[5] = -std::numeric_limits<float>::max();
+        float radius = 0.0f;
+        for (unsigned int i=begin; i<end; ++i)
+        {
+            if (!_particles->m_isAnchored[i])
+            {
+                _particles->setPrevPos(i, _particles->getPos(i));
+            }
+            const float pos[3] = {_particles->m_posX[i], _particles->m_posY[i], _particles->m_posZ[i]};
+            for (int axis=0; axis<3; ++axis)
+            {
+                bounds[axis] = std::min(bounds[axis], pos[axis]);
+                bounds[axis + 3] = std::max(bounds[axis + 3], pos[axis]);
+            }
+            radius = std::max(radius, _particles->m_radius[i]);
+        }
+        for (int axis=0; axis<3; ++axis)
+        {
+            bounds[axis] -= radius;
+            bounds[axis + 3] += radius;
+        }
+    }
+}
+
+void Solver::addTileTask(const unsigned int &_tile, const unsigned int &_task)
+{
+    if (m_tileTasks[_tile] != NO_TASK)
+    {
+        m_graph.addDependency(m_tileTasks[_tile], _task);
+    }
+    else if (m_wholeTask != NO_TASK)
+    {
+        m_graph.addDependency(m_wholeTask, _task);
+    }
+    m_tileTasks[_tile] = _task;
+}
+
+void Solver::addWholeTask(const unsigned int &_task)
+{
+    bool waitsForTile = false;
+    for (std::vector<unsigned int>::iterator it=m_tileTasks.begin(); it!=m_tileTasks.end(); ++it)
+    {
+        if (*it != NO_TASK)
+        {
+            m_graph.addDependency(*it, _task);
+            *it = NO_TASK;
+            waitsForTile = true;
+        }
+    }
+    //each tile task already waits for the last whole-cloth task, so this only needs to if there
+    //were no tile tasks since
+    if (!waitsForTile && m_wholeTask != NO_TASK)
+    {
+        m_graph.addDependency(m_wholeTask, _task);
+    }
+    m_wholeTask = _task;
+}
+
+void Solver::computeWind(const CS::ParticleStore *_particles, const double &_time, const unsigned int &_begin, const unsigned int &_end)
+{
+    for(unsigned int i=_begin; i<_end; ++i)
+    {
+        m_windForces[i] = 512.0f*float(cos((_time*128+_particles->m_posX[i]*32+_particles->m_posY[i]*32)*0.1)*0.15);//arbitrary function to create energy in the system
+    }
+}
+
+void Solver::resolveSelfCollisions(CS::ParticleStore *_particles)
+{
+    if (_particles->empty())
+    {
+        return;
+    }
+
+    //only particles in the same or adjacent grid cells can possibly touch, so bin them first
+    //rather than testing every pair; the cells must be at least as wide as the largest
+    //combined radii for this to hold
+    const unsigned int particleNum = _particles->size();
+    float maxRadius = *std::max_element(_particles->m_radius.begin(), _particles->m_radius.end());
+
+    if (maxRadius > 0.0f)
+    {
+        beginFrame();
+        m_broadphase.build(&_particles->m_posX[0], &_particles->m_posY[0], &_particles->m_posZ[0], 1, particleNum, 2.0f * maxRadius, m_arena);
+
+        //adjust for collisions; sleeping particles can't have moved into each other, so only the
+        //awake ones need to look for anything to collide with
+        for (unsigned int i=0; i<particleNum; ++i)
+        {
+            if (isAsleep(i))
+            {
+                continue;
+            }
+            m_broadphase.query(_particles->m_posX[i], _particles->m_posY[i], _particles->m_posZ[i], m_neighbours);
+            for (std::vector<unsigned int>::iterator it=m_neighbours.begin(); it!=m_neighbours.end(); ++it)
+            {
+                //each pair is seen from both sides, so only resolve it from the lower index, unless
+                //the other side is asleep and won't be looking; a sleeping particle that is hit
+                //wakes its tile
+                const bool otherAsleep = isAsleep(*it);
+                if ((*it > i || otherAsleep) && resolveCollisionTranslate(_particles, i, *it) && otherAsleep)
+                {
+                    m_sleepCounters[*it / SLEEP_TILE_SIZE] = 0;
+                }
+            }
+        }
+    }
+}
+
+void Solver::resolveSphereCollisions(CS::ParticleStore *_particles, const CS::Particle *_sphere)
+{
+    const unsigned int particleNum = _particles->size();
+    for(unsigned int i=0; i<particleNum; ++i)
+    {
+        resolveSweptCollision(_particles, i, _sphere);
+    }
+}
+
+void Solver::projectDistanceConstraints(CS::ParticleStore *_particles, const CS::SpringStore *_springs, const float &_deltaSeconds)
+{
+    const unsigned int springNum = _springs->size();
+    if (springNum == 0 || _deltaSeconds <= 0.0f)
+    {
+        return;
+    }
+
+    beginFrame();
+    m_lambdas = m_arena.allocate<float>(springNum);
+    std::fill(m_lambdas, m_lambdas + springNum, 0.0f);
+
+    //gauss-seidel: each projection sees the corrections made before it, which converges much
+    //faster than averaging them
+    ThreadPool *pool = ThreadPool::instance();
+    if (pool->getThreadCount() == 1 || springNum < PARALLEL_SPRING_THRESHOLD || !_springs->hasColours())
+    {
+        for (unsigned int iteration=0; iteration<m_iterations; ++iteration)
+        {
+            for (unsigned int i=0; i<springNum; ++i)
+            {
+                if (!isSpringAsleep(_springs, i))
+                {
+                    projectSpring(_particles, _springs, i, _deltaSeconds);
+                }
+            }
+        }
+        return;
+    }
+
+    //springs of the same colour never share a particle, so each colour can be projected all at
+    //once; the springs are sorted by colour, so this is the same order as the serial loop and
+    //gives the same result whatever the thread count
+    const unsigned int colourNum = _springs->getColourNum();
+    const uint32_t *offsets = &_springs->m_colourOffsets[0];
+    for (unsigned int iteration=0; iteration<m_iterations; ++iteration)
+    {
+        for (unsigned int colour=0; colour<colourNum; ++colour)
+        {
+            pool->parallelFor(offsets[colour], offsets[colour+1], SPRING_GRAIN, [&](unsigned int _begin, unsigned int _end)
+            {
+                for (unsigned int i=_begin; i<_end; ++i)
+                {
+                    if (!isSpringAsleep(_springs, i))
+                    {
+                        projectSpring(_particles, _springs, i, _deltaSeconds);
+                    }
+                }
+            });
+        }
+    }
+}
+
+void Solver::projectSpring(CS::ParticleStore *_particles, const CS::SpringStore *_springs, const unsigned int &_index, const float &_deltaSeconds)
+{
+    const CS::Spring &spring = (*_springs)[_index];
+    const unsigned int start = spring.m_startParticle;
+    const unsigned int end = spring.m_endParticle;
+
+    //a sleeping particle holds still like an anchored one until its tile wakes
+    const float inverseMassA = (_particles->m_isAnchored[start] || isAsleep(start)) ? 0.f : 1.f/_particles->m_mass[start];
+    const float inverseMassB = (_particles->m_isAnchored[end] || isAsleep(end)) ? 0.f : 1.f/_particles->m_mass[end];
+    if (inverseMassA + inverseMassB == 0.0f)
+    {
+        return;
+    }
+
+    ngl::Vec3 startPos = _particles->getPos(start);
+    ngl::Vec3 endPos = _particles->getPos(end);
+    ngl::Vec3 between = startPos - endPos;
+    const float length = between.length();
+    if (length <= 0.0f)
+    {
+        return;
+    }
+    const ngl::Vec3 normal = between / length;
+
+    //the compliance is the inverse of the stiffness, scaled by the step so that the same springs
+    //behave the same whatever the timestep
+    const float springConstant = _springs->getSpringConstant(_index);
+    const float compliance = springConstant > 0.0f ? 1.0f / (springConstant * _deltaSeconds * _deltaSeconds) : 0.0f;
+
+    //the force-based damping acts on how far the ends moved in one step rather than on their
+    //velocity, so its constant is already relative to the step; dividing by the stiffness gives
+    //the dimensionless XPBD damping term
+    const float damping = springConstant > 0.0f ? _springs->getDampingConstant(_index) / springConstant : 0.0f;
+    const ngl::Vec3 startMoved = startPos - _particles->getPrevPos(start);
+    const ngl::Vec3 endMoved = endPos - _particles->getPrevPos(end);
+    const float stretchRate = normal.dot(startMoved - endMoved);
+
+    const float constraint = length - spring.m_restLength;
+    float &lambda = m_lambdas[_index];
+    const float deltaLambda = (-constraint - compliance * lambda - damping * stretchRate)
+                            / ((1.0f + damping) * (inverseMassA + inverseMassB) + compliance);
+    lambda += deltaLambda;
+
+    _particles->move(start, normal * (deltaLambda * inverseMassA));
+    _particles->move(end, -normal * (deltaLambda * inverseMassB));
+}
+
+void Solver::stepImplicit(CS::ParticleStore *_particles, const CS::SpringStore *_springs, const float *_windZ, const float &_deltaSeconds)
+{
+    const unsigned int particleNum = _particles->size();
+    const unsigned int springNum = _springs->size();
+    const float h = _deltaSeconds;
+    if (particleNum == 0 || h <= 0.0f)
+    {
+        return;
+    }
+
+    //the pattern only depends on which particles the springs join, so it is kept until the cloth
+    //is rebuilt
+    if (!m_hasPattern || m_system.getRowNum() != particleNum)
+    {
+        m_system.buildPattern(particleNum, _springs);
+        //a warm start restored with setWarmStart() is kept, as long as it is the right size
+        if (m_deltaV.size() != 3 * particleNum)
+        {
+            m_deltaV.assign(3 * particleNum, 0.0f);
+        }
+        m_hasPattern = true;
+    }
+    else
+    {
+        m_system.clear();
+    }
+
+    m_velocity.resize(3 * particleNum);
+    m_rhs.resize(3 * particleNum);
+    m_deltaV.resize(3 * particleNum, 0.0f);
+
+    //the stored forces (and everything else in the store) use the opposite sign to the real ones,
+    //hence all the negations here; see Integrator
+    for (unsigned int i=0; i<particleNum; ++i)
+    {
+        const ngl::Vec3 moved = _particles->getPos(i) - _particles->getPrevPos(i);
+        const ngl::Vec3 force = -_particles->getForce(i)
+                              - ngl::Vec3(0.0f, m_gravity, 0.0f)
+                              + moved * AIR_RESISTANCE
+                              - ngl::Vec3(0.0f, 0.0f, _windZ ? _windZ[i] : 0.0f);
+
+        m_velocity[3*i] = moved.m_x / h;
+        m_velocity[3*i+1] = moved.m_y / h;
+        m_velocity[3*i+2] = moved.m_z / h;
+        m_rhs[3*i] = h * force.m_x;
+        m_rhs[3*i+1] = h * force.m_y;
+        m_rhs[3*i+2] = h * force.m_z;
+
+        //mass, plus the air resistance which acts on the velocity; both only touch the diagonal
+        float *diagonal = m_system.getDiagonalBlock(i);
+        const float drag = -AIR_RESISTANCE * h * h;
+        diagonal[0] += _particles->m_mass[i] + drag;
+        diagonal[4] += _particles->m_mass[i] + drag;
+        diagonal[8] += _particles->m_mass[i] + drag;
+    }
+
+    for (unsigned int i=0; i<springNum; ++i)
+    {
+        const CS::Spring &spring = (*_springs)[i];
+        const unsigned int start = spring.m_startParticle;
+        const unsigned int end = spring.m_endParticle;
+        const float springConstant = _springs->getSpringConstant(i);
+        const float dampingConstant = _springs->getDampingConstant(i);
+
+        const ngl::Vec3 between = _particles->getPos(end) - _particles->getPos(start);
+        const float length = between.length();
+        const float extension = length - spring.m_restLength;
+        const ngl::Vec3 velocity(m_velocity[3*end] - m_velocity[3*start], m_velocity[3*end+1] - m_velocity[3*start+1], m_velocity[3*end+2] - m_velocity[3*start+2]);
+
+        //the same force as getSpringForce(), the damping acting on how far the ends moved this step
+        const ngl::Vec3 force = between * (springConstant * extension) + velocity * (dampingConstant * h);
+
+        //the derivative of that force with respect to the other end's position is
+        //k * ((l - L) * I + l * n * n^T); when the spring is compressed the first term can make the
+        //system indefinite, so it is left out, which costs nothing in stability
+        float stiffness[9];
+        const float stretch = springConstant * std::max(extension, 0.0f);
+        const float along = length > 0.0f ? springConstant / length : 0.0f;
+        const float d[3] = {between.m_x, between.m_y, between.m_z};
+        for (int r=0; r<3; ++r)
+        {
+            for (int c=0; c<3; ++c)
+            {
+                stiffness[3*r+c] = along * d[r] * d[c] + (r == c ? stretch : 0.0f);
+            }
+        }
+
+        //right-hand side: h * (f + h * K * v) for both ends
+        const float v[3] = {velocity.m_x, velocity.m_y, velocity.m_z};
+        const float f[3] = {force.m_x, force.m_y, force.m_z};
+        for (int r=0; r<3; ++r)
+        {
+            const float stiffnessTerm = h * (stiffness[3*r] * v[0] + stiffness[3*r+1] * v[1] + stiffness[3*r+2] * v[2]);
+            m_rhs[3*start+r] += h * (f[r] + stiffnessTerm);
+            m_rhs[3*end+r] -= h * (f[r] + stiffnessTerm);
+        }
+
+        //the system gains h^2 * (K + c * I) on both diagonals and loses it off them
+        float *startBlock = m_system.getDiagonalBlock(start);
+        float *endBlock = m_system.getDiagonalBlock(end);
+        float *upper = m_system.getUpperBlock(i);
+        float *lower = m_system.getLowerBlock(i);
+        for (int k=0; k<9; ++k)
+        {
+            const float value = h * h * (stiffness[k] + (k % 4 == 0 ? dampingConstant : 0.0f));
+            startBlock[k] += value;
+            endBlock[k] += value;
+            upper[k] -= value;
+            lower[k] -= value;
+        }
+    }
+
+    m_lastSolveIterations = solveConjugateGradient(_particles);
+
+    for (unsigned int i=0; i<particleNum; ++i)
     {
-        for(std::vector<CS::Particle>::iterator it=_particles->begin(); it!=_particles->end(); ++it)
+        if (!_particles->m_isAnchored[i])
         {
-            resolveCollisionTranslate(&(*it), m_sphere);
+            const ngl::Vec3 pos = _particles->getPos(i);
+            const ngl::Vec3 velocity(m_velocity[3*i] + m_deltaV[3*i], m_velocity[3*i+1] + m_deltaV[3*i+1], m_velocity[3*i+2] + m_deltaV[3*i+2]);
+            _particles->setPrevPos(i, pos);
+            _particles->move(i, velocity * h);
         }
+        _particles->resetForce(i);
     }
 }
 
-void Solver::updateParticle(CS::Particle *_particle, float _deltaSeconds)
+unsigned int Solver::solveConjugateGradient(const CS::ParticleStore *_particles)
+{
+    const unsigned int particleNum = _particles->size();
+    const unsigned int size = 3 * particleNum;
+    const unsigned char *anchored = &_particles->m_isAnchored[0];
+    ThreadPool *pool = ThreadPool::instance();
+
+    m_residual.resize(size);
+    m_preconditioned.resize(size);
+    m_direction.resize(size);
+    m_product.resize(size);
+
+    //block jacobi: each particle's own 3x3 block, inverted
+    m_inverseDiagonal.resize(9 * particleNum);
+    pool->parallelFor(0, particleNum, ROW_GRAIN, [&](unsigned int _begin, unsigned int _end)
+    {
+        for (unsigned int i=_begin; i<_end; ++i)
+        {
+            const float *a = m_system.getDiagonalBlock(i);
+            float *inverse = &m_inverseDiagonal[9*i];
+            inverse[0] = a[4]*a[8] - a[5]*a[7];
+            inverse[1] = a[2]*a[7] - a[1]*a[8];
+            inverse[2] = a[1]*a[5] - a[2]*a[4];
+            inverse[3] = a[5]*a[6] - a[3]*a[8];
+            inverse[4] = a[0]*a[8] - a[2]*a[6];
+            inverse[5] = a[2]*a[3] - a[0]*a[5];
+            inverse[6] = a[3]*a[7] - a[4]*a[6];
+            inverse[7] = a[1]*a[6] - a[0]*a[7];
+            inverse[8] = a[0]*a[4] - a[1]*a[3];
+            const float determinant = a[0]*inverse[0] + a[1]*inverse[3] + a[2]*inverse[6];
+            const float scale = determinant != 0.0f ? 1.0f / determinant : 0.0f;
+            for (int k=0; k<9; ++k)
+            {
+                inverse[k] *= scale;
+            }
+        }
+    });
+
+    //anchored particles can't change velocity, so their rows are kept at zero throughout
+    auto multiplyFiltered = [&](const std::vector<float> &_vector, std::vector<float> &_result)
+    {
+        pool->parallelFor(0, particleNum, ROW_GRAIN, [&](unsigned int _begin, unsigned int _end)
+        {
+            m_system.multiply(&_vector[0], &_result[0], _begin, _end);
+            for (unsigned int i=_begin; i<_end; ++i)
+            {
+                if (anchored[i])
+                {
+                    _result[3*i] = _result[3*i+1] = _result[3*i+2] = 0.0f;
+                }
+            }
+        });
+    };
+
+    auto precondition = [&]()
+    {
+        pool->parallelFor(0, particleNum, ROW_GRAIN, [&](unsigned int _begin, unsigned int _end)
+        {
+            for (unsigned int i=_begin; i<_end; ++i)
+            {
+                const float *inverse = &m_inverseDiagonal[9*i];
+                const float *r = &m_residual[3*i];
+                m_preconditioned[3*i] = inverse[0]*r[0] + inverse[1]*r[1] + inverse[2]*r[2];
+                m_preconditioned[3*i+1] = inverse[3]*r[0] + inverse[4]*r[1] + inverse[5]*r[2];
+                m_preconditioned[3*i+2] = inverse[6]*r[0] + inverse[7]*r[1] + inverse[8]*r[2];
+            }
+        });
+    };
+
+    for (unsigned int i=0; i<particleNum; ++i)
+    {
+        if (anchored[i])
+        {
+            m_deltaV[3*i] = m_deltaV[3*i+1] = m_deltaV[3*i+2] = 0.0f;
+            m_rhs[3*i] = m_rhs[3*i+1] = m_rhs[3*i+2] = 0.0f;
+        }
+    }
+
+    multiplyFiltered(m_deltaV, m_product);
+    for (unsigned int k=0; k<size; ++k)
+    {
+        m_residual[k] = m_rhs[k] - m_product[k];
+    }
+
+    const double target = double(m_solveTolerance) * double(m_solveTolerance) * dot(m_rhs, m_rhs);
+    if (dot(m_residual, m_residual) <= target)
+    {
+        return 0;
+    }
+
+    precondition();
+    m_direction = m_preconditioned;
+    double residualDot = dot(m_residual, m_preconditioned);
+
+    unsigned int iteration = 0;
+    while (iteration < m_maxSolveIterations)
+    {
+        ++iteration;
+        multiplyFiltered(m_direction, m_product);
+        const double curvature = dot(m_direction, m_product);
+        if (curvature <= 0.0)
+        {
+            break;
+        }
+
+        const float alpha = float(residualDot / curvature);
+        for (unsigned int k=0; k<size; ++k)
+        {
+            m_deltaV[k] += alpha * m_direction[k];
+            m_residual[k] -= alpha * m_product[k];
+        }
+
+        if (dot(m_residual, m_residual) <= target)
+        {
+            break;
+        }
+
+        precondition();
+        const double newResidualDot = dot(m_residual, m_preconditioned);
+        const float beta = float(newResidualDot / residualDot);
+        residualDot = newResidualDot;
+        for (unsigned int k=0; k<size; ++k)
+        {
+            m_direction[k] = m_preconditioned[k] + beta * m_direction[k];
+        }
+    }
+
+    return iteration;
+}
+
+double Solver::dot(const std::vector<float> &_a, const std::vector<float> &_b) const
+{
+    double sum = 0.0;
+    for (size_t k=0; k<_a.size(); ++k)
+    {
+        sum += double(_a[k]) * double(_b[k]);
+    }
+    return sum;
+}
+
+void Solver::updateParticle(CS::ParticleStore *_particles, const unsigned int &_index, float _deltaSeconds)
 {
     float newDelta = _deltaSeconds * m_speed;
-    ngl::Vec3 approximateVelocity = _particle->m_pos - _particle->m_prevPos;
+    ngl::Vec3 pos = _particles->getPos(_index);
+    ngl::Vec3 approximateVelocity = pos - _particles->getPrevPos(_index);
 
     //Do Verlet integration here
     ngl::Vec3 moveBy = approximateVelocity
-            + (newDelta * newDelta * _particle->getAcceleration());
+            + (newDelta * newDelta * _particles->getAcceleration(_index));
+
+    _particles->setPrevPos(_index, pos);
+    _particles->move(_index, moveBy);
+    _particles->resetForce(_index);
+}
+
+void Solver::accumulateSpringForces(CS::ParticleStore *_particles, const CS::SpringStore *_springs)
+{
+    ThreadPool *pool = ThreadPool::instance();
+    const unsigned int springNum = _springs->size();
+    const unsigned int particleNum = _particles->size();
+
+    if (pool->getThreadCount() == 1 || springNum < PARALLEL_SPRING_THRESHOLD || !_springs->hasIncidence(particleNum))
+    {
+        for(unsigned int i=0; i<springNum; ++i)
+        {
+            updateSpring(_particles, _springs, i);
+        }
+        return;
+    }
+
+    //two springs can share a particle, so they can't safely add into it from different threads;
+    //instead each spring's force is worked out on its own first...
+    beginFrame();
+    m_springForces = m_arena.allocate<ngl::Vec3>(springNum);
+    pool->parallelFor(0, springNum, SPRING_GRAIN, [&](unsigned int _begin, unsigned int _end)
+    {
+        computeSpringForces(_particles, _springs, _begin, _end);
+    });
+
+    //...then every particle collects the forces of its own springs
+    pool->parallelFor(0, particleNum, PARTICLE_GRAIN, [&](unsigned int _begin, unsigned int _end)
+    {
+        gatherSpringForces(_particles, _springs, _begin, _end);
+    });
+}
+
+void Solver::computeSpringForces(const CS::ParticleStore *_particles, const CS::SpringStore *_springs, const unsigned int &_begin, const unsigned int &_end)
+{
+    for(unsigned int i=_begin; i<_end; ++i)
+    {
+        //nobody gathers a spring between two sleeping particles
+        if (!isSpringAsleep(_springs, i))
+        {
+            m_springForces[i] = getSpringForce(_particles, _springs, i);
+        }
+    }
+}
 
-    _particle->m_prevPos = _particle->m_pos;
-    _particle->move(moveBy);
-    _particle->resetForce();
+void Solver::gatherSpringForces(CS::ParticleStore *_particles, const CS::SpringStore *_springs, const unsigned int &_begin, const unsigned int &_end)
+{
+    const uint32_t *offsets = &_springs->m_incidentOffsets[0];
+    const uint32_t *incident = _springs->m_incidentSprings.empty() ? 0 : &_springs->m_incidentSprings[0];
+    for(unsigned int p=_begin; p<_end; ++p)
+    {
+        if (isAsleep(p))
+        {
+            continue;
+        }
+        for(uint32_t k=offsets[p]; k<offsets[p+1]; ++k)
+        {
+            const ngl::Vec3 &force = m_springForces[incident[k] >> 1];
+            _particles->addForce(p, (incident[k] & 1) ? -force : force);
+        }
+    }
 }
 
-void Solver::updateSpring(CS::Spring *_spring)
+ngl::Vec3 Solver::getSpringForce(const CS::ParticleStore *_particles, const CS::SpringStore *_springs, const unsigned int &_index) const
 {
-    CS::Particle* startParticle = _spring->m_startParticle;
-    CS::Particle* endParticle = _spring->m_endParticle;
+    const CS::Spring &spring = (*_springs)[_index];
+    const unsigned int start = spring.m_startParticle;
+    const unsigned int end = spring.m_endParticle;
+
+    //load each endpoint once; the store can't tell the compiler its arrays don't overlap
+    ngl::Vec3 startPos = _particles->getPos(start);
+    ngl::Vec3 endPos = _particles->getPos(end);
+
+    ngl::Vec3 force = spring.getSpringForce(endPos - startPos, _springs->getSpringConstant(_index));
+    ngl::Vec3 startVelocity = startPos - _particles->getPrevPos(start);
+    ngl::Vec3 endVelocity = endPos - _particles->getPrevPos(end);
+    ngl::Vec3 damping = (endVelocity-startVelocity) * _springs->getDampingConstant(_index);
+
+    return force-damping;
+}
 
-    ngl::Vec3 force = _spring->getSpringForce();
-    ngl::Vec3 startVelocity = startParticle->m_pos - startParticle->m_prevPos;
-    ngl::Vec3 endVelocity = endParticle->m_pos - endParticle->m_prevPos;
-    ngl::Vec3 damping = (endVelocity-startVelocity) * _spring->m_dampingConstant;
+void Solver::updateSpring(CS::ParticleStore *_particles, const CS::SpringStore *_springs, const unsigned int &_index)
+{
+    const CS::Spring &spring = (*_springs)[_index];
+    ngl::Vec3 force = getSpringForce(_particles, _springs, _index);
 
-    startParticle->addForce(force-damping);
-    endParticle->addForce(damping-force);//the other direction
+    _particles->addForce(spring.m_startParticle, force);
+    _particles->addForce(spring.m_endParticle, -force);//the other direction
 }
 
 //==================== OBSOLETE ====================
@@ -135,69 +1018,111 @@ bool Solver::resolveCollision(CS::Particle *_firstParticle, CS::Particle *_secon
     return false;
 }
 
-bool Solver::resolveCollisionTranslate(CS::Particle *_firstParticle, CS::Particle *_secondParticle)
+bool Solver::resolveCollisionTranslate(CS::ParticleStore *_particles, const unsigned int &_first, const unsigned int &_second)
 {
-    if (_firstParticle->m_isAnchored && _secondParticle->m_isAnchored)
+    const bool firstAnchored = _particles->m_isAnchored[_first];
+    const bool secondAnchored = _particles->m_isAnchored[_second];
+    if (firstAnchored && secondAnchored)
     {
         //do nothing
         return false;
     }
 
-    ngl::Vec3 firstPos = _firstParticle->m_pos;
-    ngl::Vec3 secondPos = _secondParticle->m_pos;
-    float combinedRadii = _firstParticle->m_radius + _secondParticle->m_radius;
+    ngl::Vec3 firstPos = _particles->getPos(_first);
+    ngl::Vec3 secondPos = _particles->getPos(_second);
+    float combinedRadii = _particles->m_radius[_first] + _particles->m_radius[_second];
     ngl::Vec3 between = secondPos - firstPos;
     if (between.lengthSquared() < combinedRadii * combinedRadii)
     {
-        _firstParticle->resetForce();
-        _secondParticle->resetForce();
+        _particles->resetForce(_first);
+        _particles->resetForce(_second);
         float penetration = combinedRadii - between.length();
         between.normalize();
 
-//        simple collision resolution
-//        (no different for us since mass is always 1)
-//        if (_firstParticle->m_isAnchored)
-//        {
-//            _secondParticle->move(between * penetration);
-//        }
-//        else if (_secondParticle->m_isAnchored)
-//        {
-//            _firstParticle->move(-between * penetration);
-//        }
-//        else
-//        {
-//            _firstParticle->move(-between * penetration * 0.5f);
-//            _secondParticle->move(between * penetration * 0.5f);
-//        }
-
-        float inverseMassA;
-        float inverseMassB;
-
-        if (_firstParticle->m_isAnchored)
-        {
-            inverseMassA = 0.f;
-        }
-        else
-        {
-            inverseMassA = 1.f/_firstParticle->m_mass;
-        }
-
-        if (_secondParticle->m_isAnchored)
-        {
-            inverseMassB = 0.f;
-        }
-        else
-        {
-            inverseMassB = 1.f/_firstParticle->m_mass;
-        }
+        float inverseMassA = firstAnchored ? 0.f : 1.f/_particles->m_mass[_first];
+        float inverseMassB = secondAnchored ? 0.f : 1.f/_particles->m_mass[_second];
 
         float weightA = inverseMassA / (inverseMassA + inverseMassB);
         float weightB = inverseMassB / (inverseMassA + inverseMassB);
 
-        _firstParticle->move(-between * penetration * weightA);
-        _secondParticle->move(between * penetration * weightB);
+        _particles->move(_first, -between * penetration * weightA);
+        _particles->move(_second, between * penetration * weightB);
+
+        return true;
+    }
+    return false;
+}
+
+bool Solver::resolveCollisionTranslate(CS::ParticleStore *_particles, const unsigned int &_index, const CS::Particle *_obstacle)
+{
+    if (_particles->m_isAnchored[_index])
+    {
+        //do nothing
+        return false;
+    }
+
+    ngl::Vec3 particlePos = _particles->getPos(_index);
+    float combinedRadii = _particles->m_radius[_index] + _obstacle->m_radius;
+    ngl::Vec3 between = _obstacle->m_pos - particlePos;
+    if (between.lengthSquared() < combinedRadii * combinedRadii)
+    {
+        _particles->resetForce(_index);
+        float penetration = combinedRadii - between.length();
+        between.normalize();
+
+        //the obstacle has no inverse mass, so the particle takes the whole correction
+        _particles->move(_index, -between * penetration);
 
         return true;
     }
     return false;
 }
+
+bool Solver::resolveSweptCollision(CS::ParticleStore *_particles, const unsigned int &_index, const CS::Particle *_obstacle)
+{
+    if (_particles->m_isAnchored[_index])
+    {
+        //do nothing
+        return false;
+    }
+
+    //work relative to the obstacle, so that only the particle is moving
+    const float combinedRadii = _particles->m_radius[_index] + _obstacle->m_radius;
+    const ngl::Vec3 start = _particles->getPrevPos(_index) - _obstacle->m_prevPos;
+    const ngl::Vec3 end = _particles->getPos(_index) - _obstacle->m_pos;
+    const float startOverlap = start.lengthSquared() - combinedRadii * combinedRadii;
+    if (startOverlap < 0.0f)
+    {
+        //already inside at the start of the step, so there is no first contact to find
+        return resolveCollisionTranslate(_particles, _index, _obstacle);
+    }
+
+    //solve |start + moved * t| = combinedRadii for the first t; heading away from the obstacle,
+    //or only reaching it after the step, means no contact
+    const ngl::Vec3 moved = end - start;
+    const float approach = start.dot(moved);
+    if (approach >= 0.0f)
+    {
+        return false;
+    }
+    const float movedSquared = moved.lengthSquared();
+    const float discriminant = approach * approach - movedSquared * startOverlap;
+    if (discriminant < 0.0f)
+    {
+        return false;
+    }
+    const float t = (-approach - sqrtf(discriminant)) / movedSquared;
+    if (t > 1.0f)
+    {
+        return false;
+    }
+
+    ngl::Vec3 normal = start + moved * t;
+    normal.normalize();
+
+    //the position is all Verlet integration needs to turn this into an impulse
+    _particles->resetForce(_index);
+    _particles->setPos(_index, _obstacle->m_pos + normal * combinedRadii);
+
+    return true;
+}
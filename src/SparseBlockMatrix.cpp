@@ -0,0 +1,107 @@
+#include "SparseBlockMatrix.h"
+#include <algorithm>
+
+SparseBlockMatrix::SparseBlockMatrix() : m_rowNum(0)
+{
+}
+
+SparseBlockMatrix::~SparseBlockMatrix()
+{
+
+}
+
+void SparseBlockMatrix::buildPattern(const unsigned int &_rowNum, const CS::SpringStore *_springs)
+{
+    m_rowNum = _rowNum;
+    const unsigned int springNum = _springs->size();
+
+    //count each row's blocks: the diagonal plus one per spring touching it, which may count the
+    //same pair twice if two springs join it, so the rows are tidied up afterwards
+    std::vector<unsigned int> counts(_rowNum, 1);
+    for (unsigned int i=0; i<springNum; ++i)
+    {
+        ++counts[(*_springs)[i].m_startParticle];
+        ++counts[(*_springs)[i].m_endParticle];
+    }
+
+    std::vector<unsigned int> offsets(_rowNum + 1, 0);
+    for (unsigned int row=0; row<_rowNum; ++row)
+    {
+        offsets[row + 1] = offsets[row] + counts[row];
+    }
+
+    std::vector<unsigned int> columns(offsets[_rowNum]);
+    std::vector<unsigned int> filled(offsets.begin(), offsets.end() - 1);
+    for (unsigned int row=0; row<_rowNum; ++row)
+    {
+        columns[filled[row]++] = row;
+    }
+    for (unsigned int i=0; i<springNum; ++i)
+    {
+        const unsigned int start = (*_springs)[i].m_startParticle;
+        const unsigned int end = (*_springs)[i].m_endParticle;
+        columns[filled[start]++] = end;
+        columns[filled[end]++] = start;
+    }
+
+    //sort each row by column and drop the duplicates
+    m_rowOffsets.assign(_rowNum + 1, 0);
+    m_columns.clear();
+    m_columns.reserve(columns.size());
+    m_diagonal.resize(_rowNum);
+    for (unsigned int row=0; row<_rowNum; ++row)
+    {
+        std::vector<unsigned int>::iterator begin = columns.begin() + offsets[row];
+        std::vector<unsigned int>::iterator end = columns.begin() + offsets[row + 1];
+        std::sort(begin, end);
+        end = std::unique(begin, end);
+
+        m_rowOffsets[row] = (unsigned int)m_columns.size();
+        m_diagonal[row] = m_rowOffsets[row] + (unsigned int)(std::lower_bound(begin, end, row) - begin);
+        m_columns.insert(m_columns.end(), begin, end);
+    }
+    m_rowOffsets[_rowNum] = (unsigned int)m_columns.size();
+
+    //remember where each spring's blocks ended up
+    m_springBlocks.resize(2 * springNum);
+    for (unsigned int i=0; i<springNum; ++i)
+    {
+        const unsigned int start = (*_springs)[i].m_startParticle;
+        const unsigned int end = (*_springs)[i].m_endParticle;
+        m_springBlocks[2 * i] = findBlock(start, end);
+        m_springBlocks[2 * i + 1] = findBlock(end, start);
+    }
+
+    m_values.assign(9 * m_columns.size(), 0.0f);
+}
+
+unsigned int SparseBlockMatrix::findBlock(const unsigned int &_row, const unsigned int &_column) const
+{
+    std::vector<unsigned int>::const_iterator begin = m_columns.begin() + m_rowOffsets[_row];
+    std::vector<unsigned int>::const_iterator end = m_columns.begin() + m_rowOffsets[_row + 1];
+    return (unsigned int)(std::lower_bound(begin, end, _column) - m_columns.begin());
+}
+
+void SparseBlockMatrix::clear()
+{
+    std::fill(m_values.begin(), m_values.end(), 0.0f);
+}
+
+void SparseBlockMatrix::multiply(const float *_vector, float *_result, const unsigned int &_begin, const unsigned int &_end) const
+{
+    for (unsigned int row=_begin; row<_end; ++row)
+    {
+        float x = 0.0f, y = 0.0f, z = 0.0f;
+        for (unsigned int k=m_rowOffsets[row]; k<m_rowOffsets[row + 1]; ++k)
+        {
+            const float *block = &m_values[9 * k];
+            const float *v = &_vector[3 * m_columns[k]];
+            x += block[0] * v[0] + block[1] * v[1] + block[2] * v[2];
+            y += block[3] * v[0] + block[4] * v[1] + block[5] * v[2];
+            z += block[6] * v[0] + block[7] * v[1] + block[8] * v[2];
+        }
+        _result[3 * row] = x;
+        _result[3 * row + 1] = y;
+        _result[3 * row + 2] = z;
+    }
+}
@@ -0,0 +1,106 @@
+#include "SpatialHash.h"
+#include "FrameArena.h"
+#include <algorithm>
+#include <math.h>
+
+//large primes from Teschner et al. "Optimized Spatial Hashing for Collision Detection of Deformable Objects"
+#define HASH_PRIME_X 73856093u
+#define HASH_PRIME_Y 19349663u
+#define HASH_PRIME_Z 83492791u
+
+SpatialHash::SpatialHash() : m_cellSize(1.0f), m_inverseCellSize(1.0f), m_bucketMask(0)
+{
+    m_bucketStart.resize(2, 0);
+}
+
+SpatialHash::~SpatialHash()
+{
+
+}
+
+int SpatialHash::cellCoord(const float &_p) const
+{
+    return (int)floorf(_p * m_inverseCellSize);
+}
+
+unsigned int SpatialHash::bucketOf(const int &_x, const int &_y, const int &_z) const
+{
+    return (((unsigned int)_x * HASH_PRIME_X) ^ ((unsigned int)_y * HASH_PRIME_Y) ^ ((unsigned int)_z * HASH_PRIME_Z)) & m_bucketMask;
+}
+
+void SpatialHash::build(const float *_x, const float *_y, const float *_z, const unsigned int &_stride, const unsigned int &_count, const float &_cellSize, FrameArena &_scratch)
+{
+    m_cellSize = _cellSize;
+    m_inverseCellSize = 1.0f / _cellSize;
+
+    //roughly two buckets per point keeps the chains short without wasting too much memory
+    unsigned int bucketCount = 1;
+    while (bucketCount < 2 * _count)
+    {
+        bucketCount <<= 1;
+    }
+    m_bucketMask = bucketCount - 1;
+
+    m_bucketStart.assign(bucketCount + 1, 0);
+    m_sortedIndices.resize(_count);
+    m_pointBucket.resize(_count);
+
+    //count how many points land in each bucket...
+    for (unsigned int i = 0; i < _count; ++i)
+    {
+        unsigned int offset = i * _stride;
+        unsigned int bucket = bucketOf(cellCoord(_x[offset]), cellCoord(_y[offset]), cellCoord(_z[offset]));
+        m_pointBucket[i] = bucket;
+        ++m_bucketStart[bucket + 1];
+    }
+
+    //...turn the counts into start offsets...
+    for (unsigned int b = 0; b < bucketCount; ++b)
+    {
+        m_bucketStart[b + 1] += m_bucketStart[b];
+    }
+
+    //...and scatter the indices into place (a counting sort, so no per-bucket allocations)
+    unsigned int *fill = _scratch.allocate<unsigned int>(bucketCount);
+    std::copy(m_bucketStart.begin(), m_bucketStart.end() - 1, fill);
+    for (unsigned int i = 0; i < _count; ++i)
+    {
+        m_sortedIndices[fill[m_pointBucket[i]]++] = i;
+    }
+}
+
+void SpatialHash::query(const float &_x, const float &_y, const float &_z, std::vector<unsigned int> &_result) const
+{
+    _result.clear();
+
+    int cx = cellCoord(_x);
+    int cy = cellCoord(_y);
+    int cz = cellCoord(_z);
+
+    //two neighbouring cells can hash into the same bucket, so gather the distinct buckets first
+    //to avoid reporting the same point twice
+    unsigned int buckets[27];
+    unsigned int bucketNum = 0;
+    for (int dz = -1; dz <= 1; ++dz)
+    {
+        for (int dy = -1; dy <= 1; ++dy)
+        {
+            for (int dx = -1; dx <= 1; ++dx)
+            {
+                unsigned int bucket = bucketOf(cx + dx, cy + dy, cz + dz);
+                if (std::find(buckets, buckets + bucketNum, bucket) == buckets + bucketNum)
+                {
+                    buckets[bucketNum++] = bucket;
+                }
+            }
+        }
+    }
+
+    for (unsigned int b = 0; b < bucketNum; ++b)
+    {
+        for (unsigned int i = m_bucketStart[buckets[b]]; i < m_bucketStart[buckets[b] + 1]; ++i)
+        {
+            _result.push_back(m_sortedIndices[i]);
+        }
+    }
+}
@@ -0,0 +1,229 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+namespace
+{
+    //which queue the current thread uses; zero for any thread that isn't one of the workers
+    thread_local unsigned int t_slot = 0;
+}
+
+ThreadPool* ThreadPool::instance()
+{
+    static ThreadPool pool;
+    return &pool;
+}
+
+ThreadPool::ThreadPool() : m_queued(0), m_quit(false)
+{
+    setThreadCount(0);
+}
+
+ThreadPool::~ThreadPool()
+{
+    stopWorkers();
+}
+
+void ThreadPool::setThreadCount(const unsigned int &_count)
+{
+    std::lock_guard<std::recursive_mutex> callLock(m_callMutex);
+
+    unsigned int count = _count;
+    if (count == 0)
+    {
+        count = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    stopWorkers();
+    m_quit = false;
+    m_queues.clear();
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        m_queues.push_back(std::unique_ptr<Queue>(new Queue));
+    }
+    for (unsigned int i = 1; i < count; ++i)
+    {
+        m_workers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+    }
+}
+
+void ThreadPool::stopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wakeCondition.notify_all();
+    for (std::vector<std::thread>::iterator it = m_workers.begin(); it != m_workers.end(); ++it)
+    {
+        (*it).join();
+    }
+    m_workers.clear();
+}
+
+void ThreadPool::run(TaskGraph &_graph)
+{
+    if (_graph.empty())
+    {
+        return;
+    }
+
+    //threads outside the pool all share the first queue, so only one of them can be running a
+    //graph at a time; workers running a graph from inside a task have their own queues
+    const unsigned int slot = t_slot;
+    std::unique_lock<std::recursive_mutex> callLock(m_callMutex, std::defer_lock);
+    if (slot == 0)
+    {
+        callLock.lock();
+    }
+
+    _graph.prepare();
+    for (unsigned int i = 0; i < _graph.size(); ++i)
+    {
+        if (_graph.m_nodes[i].m_dependencyNum == 0)
+        {
+            push(slot, &_graph, i);
+        }
+    }
+
+    //help out rather than sitting idle; once there is nothing left to take, the last few chunks
+    //are still running elsewhere
+    while (_graph.m_unfinished.load() > 0)
+    {
+        if (!runOne(slot))
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void ThreadPool::parallelFor(const unsigned int &_begin, const unsigned int &_end, const unsigned int &_grain, const RangeFunction &_function)
+{
+    if (_end <= _begin)
+    {
+        return;
+    }
+
+    const unsigned int grain = std::max(1u, _grain);
+    if (m_workers.empty() || _end - _begin <= grain)
+    {
+        _function(_begin, _end);
+        return;
+    }
+
+    TaskGraph graph;
+    graph.addRange(_begin, _end, grain, _function);
+    run(graph);
+}
+
+void ThreadPool::push(const unsigned int &_slot, TaskGraph *_graph, const unsigned int &_node)
+{
+    const TaskGraph::Node &node = _graph->m_nodes[_node];
+    const unsigned int chunkNum = node.getChunkNum();
+
+    //count them before they can be taken, so the count never drops below zero
+    m_queued += (int)chunkNum;
+    {
+        //pushed last to first, so the owner (taking from the back) works through the range in order
+        //while thieves take the far end
+        Queue &queue = *m_queues[_slot];
+        std::lock_guard<std::mutex> lock(queue.m_mutex);
+        for (unsigned int c = chunkNum; c-- > 0;)
+        {
+            Chunk chunk;
+            chunk.m_graph = _graph;
+            chunk.m_node = _node;
+            chunk.m_begin = std::min(node.m_begin + c * node.m_grain, node.m_end);
+            chunk.m_end = std::min(chunk.m_begin + node.m_grain, node.m_end);
+            queue.m_chunks.push_back(chunk);
+        }
+    }
+
+    if (!m_workers.empty())
+    {
+        //taking the lock means no worker can be between checking the count and going to sleep
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+        }
+        m_wakeCondition.notify_all();
+    }
+}
+
+bool ThreadPool::runOne(const unsigned int &_slot)
+{
+    const unsigned int queueNum = (unsigned int)m_queues.size();
+    Chunk chunk;
+    bool found = false;
+
+    {
+        Queue &own = *m_queues[_slot];
+        std::lock_guard<std::mutex> lock(own.m_mutex);
+        if (!own.m_chunks.empty())
+        {
+            chunk = own.m_chunks.back();
+            own.m_chunks.pop_back();
+            found = true;
+        }
+    }
+
+    for (unsigned int i = 1; i < queueNum && !found; ++i)
+    {
+        Queue &victim = *m_queues[(_slot + i) % queueNum];
+        std::lock_guard<std::mutex> lock(victim.m_mutex);
+        if (!victim.m_chunks.empty())
+        {
+            chunk = victim.m_chunks.front();
+            victim.m_chunks.pop_front();
+            found = true;
+        }
+    }
+
+    if (!found)
+    {
+        return false;
+    }
+    --m_queued;
+
+    TaskGraph &graph = *chunk.m_graph;
+    const TaskGraph::Node &node = graph.m_nodes[chunk.m_node];
+    if (chunk.m_end > chunk.m_begin)
+    {
+        node.m_function(chunk.m_begin, chunk.m_end);
+    }
+
+    //whoever finishes a task's last chunk releases the tasks waiting for it
+    if (--graph.m_chunksLeft[chunk.m_node] == 0)
+    {
+        for (std::vector<unsigned int>::const_iterator it = node.m_successors.begin(); it != node.m_successors.end(); ++it)
+        {
+            if (--graph.m_waiting[*it] == 0)
+            {
+                push(_slot, &graph, *it);
+            }
+        }
+        --graph.m_unfinished;
+    }
+    return true;
+}
+
+void ThreadPool::workerLoop(unsigned int _slot)
+{
+    t_slot = _slot;
+
+    for (;;)
+    {
+        if (runOne(_slot))
+        {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_quit && m_queued.load() <= 0)
+        {
+            m_wakeCondition.wait(lock);
+        }
+        if (m_quit)
+        {
+            return;
+        }
+    }
+}
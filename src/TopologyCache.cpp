@@ -0,0 +1,329 @@
+#include "TopologyCache.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <unistd.h>
+
+//how many topologies are kept in memory unless setCapacity() says otherwise; a reset, a resize
+//and back again, and the drawing side catching up, never need more than a few
+#define DEFAULT_TOPOLOGY_CAPACITY 4
+//bump this whenever the layout below changes; older files are then ignored and remade
+#define TOPOLOGY_FILE_VERSION 1u
+
+namespace
+{
+    const char MAGIC[8] = {'C','L','O','T','H','T','O','P'};
+
+    //the start of every file, followed by each array in the order below
+    struct Header
+    {
+        char m_magic[8];
+        uint32_t m_version;
+        int32_t m_widthNum, m_heightNum, m_blockSize;
+        float m_width, m_height;
+        uint32_t m_springNum, m_colourOffsetNum, m_incidentOffsetNum, m_incidentSpringNum, m_indexNum;
+    };
+
+    static_assert(sizeof(CS::Spring) == 12, "springs are written as they are stored");
+
+    template <typename T>
+    void writeArray(std::ofstream &_stream, const std::vector<T> &_vector)
+    {
+        if (!_vector.empty())
+        {
+            _stream.write(reinterpret_cast<const char*>(&_vector[0]), (std::streamsize)(_vector.size() * sizeof(T)));
+        }
+    }
+
+    //reads the bytes first, as not everything stored has a default constructor to resize() with
+    template <typename T>
+    bool readArray(std::ifstream &_stream, const uint32_t &_num, std::vector<T> &_vector)
+    {
+        std::vector<char> bytes((size_t)_num * sizeof(T));
+        if (_num > 0 && !_stream.read(&bytes[0], (std::streamsize)bytes.size()))
+        {
+            return false;
+        }
+        const T *begin = reinterpret_cast<const T*>(bytes.data());
+        _vector.assign(begin, begin + _num);
+        return true;
+    }
+
+    //whether a list of offsets starts at 0, never goes down and ends at the specified total
+    bool isAscending(const std::vector<uint32_t> &_offsets, const uint32_t &_total)
+    {
+        if (_offsets.empty() || _offsets[0] != 0 || _offsets.back() != _total)
+        {
+            return false;
+        }
+        for (size_t i=1; i<_offsets.size(); ++i)
+        {
+            if (_offsets[i] < _offsets[i-1])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //the exact bits of a dimension, so the file name tells apart sizes that print the same
+    uint32_t getBits(const float &_value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &_value, sizeof(bits));
+        return bits;
+    }
+}
+
+TopologyCache* TopologyCache::instance()
+{
+    static TopologyCache cache;
+    return &cache;
+}
+
+TopologyCache::TopologyCache() : m_capacity(DEFAULT_TOPOLOGY_CAPACITY), m_hits(0), m_misses(0)
+{
+}
+
+std::shared_ptr<const TopologyCache::Topology> TopologyCache::find(const int &_widthNum, const int &_heightNum, const int &_blockSize, const float &_width, const float &_height)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (std::list<std::shared_ptr<const Topology> >::iterator it=m_entries.begin(); it!=m_entries.end(); ++it)
+    {
+        if ((*it)->matches(_widthNum, _heightNum, _blockSize, _width, _height))
+        {
+            //move it to the front, as the most recently used
+            m_entries.splice(m_entries.begin(), m_entries, it);
+            ++m_hits;
+            return m_entries.front();
+        }
+    }
+
+    if (!m_directory.empty())
+    {
+        std::shared_ptr<const Topology> topology = load(getPath(_widthNum, _heightNum, _blockSize, _width, _height));
+        if (topology && topology->matches(_widthNum, _heightNum, _blockSize, _width, _height))
+        {
+            push(topology);
+            ++m_hits;
+            return topology;
+        }
+    }
+
+    ++m_misses;
+    return std::shared_ptr<const Topology>();
+}
+
+std::shared_ptr<const TopologyCache::Topology> TopologyCache::findResolution(const int &_widthNum, const int &_heightNum, const int &_blockSize)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (std::list<std::shared_ptr<const Topology> >::iterator it=m_entries.begin(); it!=m_entries.end(); ++it)
+    {
+        if ((*it)->m_widthNum == _widthNum && (*it)->m_heightNum == _heightNum && (*it)->m_blockSize == _blockSize)
+        {
+            return *it;
+        }
+    }
+    return std::shared_ptr<const Topology>();
+}
+
+void TopologyCache::insert(const std::shared_ptr<const Topology> &_topology)
+{
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        push(_topology);
+        if (!m_directory.empty())
+        {
+            path = getPath(_topology->m_widthNum, _topology->m_heightNum, _topology->m_blockSize, _topology->m_width, _topology->m_height);
+        }
+    }
+
+    //the entry can't change, so it can be written without holding up anyone else; failing to
+    //write it only means it is made again next time
+    if (!path.empty())
+    {
+        save(*_topology, path);
+    }
+}
+
+void TopologyCache::setCapacity(const unsigned int &_capacity)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_capacity = std::max(_capacity, 1u);
+    while (m_entries.size() > m_capacity)
+    {
+        m_entries.pop_back();
+    }
+}
+
+void TopologyCache::setDirectory(const std::string &_directory)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_directory = _directory;
+}
+
+void TopologyCache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+}
+
+unsigned int TopologyCache::getHitCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_hits;
+}
+
+unsigned int TopologyCache::getMissCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_misses;
+}
+
+void TopologyCache::push(const std::shared_ptr<const Topology> &_topology)
+{
+    m_entries.push_front(_topology);
+    while (m_entries.size() > m_capacity)
+    {
+        m_entries.pop_back();
+    }
+}
+
+std::string TopologyCache::getPath(const int &_widthNum, const int &_heightNum, const int &_blockSize, const float &_width, const float &_height) const
+{
+    char name[96];
+    std::snprintf(name, sizeof(name), "topology_%dx%d_b%d_%08x_%08x.bin", _widthNum, _heightNum, _blockSize, getBits(_width), getBits(_height));
+    const char last = m_directory[m_directory.size() - 1];
+    return (last == '/' || last == '\\') ? m_directory + name : m_directory + "/" + name;
+}
+
+std::shared_ptr<const TopologyCache::Topology> TopologyCache::load(const std::string &_path)
+{
+    std::ifstream stream(_path.c_str(), std::ios::binary);
+    Header header;
+    if (!stream || !stream.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.m_magic, MAGIC, sizeof(MAGIC)) != 0 || header.m_version != TOPOLOGY_FILE_VERSION ||
+        header.m_widthNum < 1 || header.m_heightNum < 1 || header.m_blockSize < 1)
+    {
+        return std::shared_ptr<const Topology>();
+    }
+
+    //the arrays have to fit together as the solver expects them to, whatever is on disk; the sizes
+    //are worked out in 64 bits so that a huge resolution can't wrap around to a plausible one
+    const uint64_t particleNum = uint64_t(header.m_widthNum) * uint64_t(header.m_heightNum);
+    const uint64_t quadNum = uint64_t(header.m_widthNum - 1) * uint64_t(header.m_heightNum - 1);
+    //(a particle has at most twelve springs, each in two lists, and there are at most 256 colours)
+    if (header.m_springNum > 6 * particleNum || header.m_colourOffsetNum > 257 ||
+        header.m_incidentOffsetNum != particleNum + 1 || header.m_incidentSpringNum != 2 * uint64_t(header.m_springNum) ||
+        header.m_indexNum != 6 * quadNum)
+    {
+        return std::shared_ptr<const Topology>();
+    }
+
+    std::shared_ptr<Topology> topology(new Topology);
+    topology->m_widthNum = header.m_widthNum;
+    topology->m_heightNum = header.m_heightNum;
+    topology->m_blockSize = header.m_blockSize;
+    topology->m_width = header.m_width;
+    topology->m_height = header.m_height;
+    if (!readArray(stream, header.m_springNum, topology->m_springs) ||
+        !readArray(stream, header.m_colourOffsetNum, topology->m_colourOffsets) ||
+        !readArray(stream, header.m_incidentOffsetNum, topology->m_incidentOffsets) ||
+        !readArray(stream, header.m_incidentSpringNum, topology->m_incidentSprings) ||
+        !readArray(stream, header.m_indexNum, topology->m_indices))
+    {
+        return std::shared_ptr<const Topology>();
+    }
+
+    //a corrupt index would have the solver, or the drawing, reading past the end of its particles
+    //or springs
+    for (std::vector<CS::Spring>::const_iterator it=topology->m_springs.begin(); it!=topology->m_springs.end(); ++it)
+    {
+        if ((*it).m_startParticle >= particleNum || (*it).m_endParticle >= particleNum)
+        {
+            return std::shared_ptr<const Topology>();
+        }
+    }
+    if (!isAscending(topology->m_incidentOffsets, header.m_incidentSpringNum) ||
+        (!topology->m_colourOffsets.empty() && !isAscending(topology->m_colourOffsets, header.m_springNum)))
+    {
+        return std::shared_ptr<const Topology>();
+    }
+    //each particle's list may only name springs attached to it; an entry is a spring's index
+    //shifted up, with its lowest bit saying which end the particle is
+    const std::vector<uint32_t> &offsets = topology->m_incidentOffsets;
+    const std::vector<uint32_t> &incident = topology->m_incidentSprings;
+    for (uint32_t p=0; p<uint32_t(particleNum); ++p)
+    {
+        for (uint32_t k=offsets[p]; k<offsets[p+1]; ++k)
+        {
+            const uint32_t spring = incident[k] >> 1;
+            if (spring >= header.m_springNum ||
+                ((incident[k] & 1) ? topology->m_springs[spring].m_endParticle : topology->m_springs[spring].m_startParticle) != p)
+            {
+                return std::shared_ptr<const Topology>();
+            }
+        }
+    }
+    for (std::vector<GLuint>::const_iterator it=topology->m_indices.begin(); it!=topology->m_indices.end(); ++it)
+    {
+        if (*it >= particleNum)
+        {
+            return std::shared_ptr<const Topology>();
+        }
+    }
+
+    return topology;
+}
+
+bool TopologyCache::save(const Topology &_topology, const std::string &_path)
+{
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.m_magic, MAGIC, sizeof(MAGIC));
+    header.m_version = TOPOLOGY_FILE_VERSION;
+    header.m_widthNum = _topology.m_widthNum;
+    header.m_heightNum = _topology.m_heightNum;
+    header.m_blockSize = _topology.m_blockSize;
+    header.m_width = _topology.m_width;
+    header.m_height = _topology.m_height;
+    header.m_springNum = (uint32_t)_topology.m_springs.size();
+    header.m_colourOffsetNum = (uint32_t)_topology.m_colourOffsets.size();
+    header.m_incidentOffsetNum = (uint32_t)_topology.m_incidentOffsets.size();
+    header.m_incidentSpringNum = (uint32_t)_topology.m_incidentSprings.size();
+    header.m_indexNum = (uint32_t)_topology.m_indices.size();
+
+    //every writer gets its own temporary file, as two jobs making the same size at once would
+    //otherwise truncate and write over each other's before either is renamed into place
+    static std::atomic<unsigned int> s_saveNum(0);
+    char suffix[48];
+    std::snprintf(suffix, sizeof(suffix), ".%ld.%u.tmp", (long)getpid(), s_saveNum++);
+    const std::string temporary = _path + suffix;
+    {
+        std::ofstream stream(temporary.c_str(), std::ios::binary | std::ios::trunc);
+        if (!stream)
+        {
+            return false;
+        }
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        writeArray(stream, _topology.m_springs);
+        writeArray(stream, _topology.m_colourOffsets);
+        writeArray(stream, _topology.m_incidentOffsets);
+        writeArray(stream, _topology.m_incidentSprings);
+        writeArray(stream, _topology.m_indices);
+        if (!stream.flush())
+        {
+            stream.close();
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+    if (std::rename(temporary.c_str(), _path.c_str()) != 0)
+    {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
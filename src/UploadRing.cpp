@@ -0,0 +1,191 @@
+#include "UploadRing.h"
+#include <cstring>
+
+//how long to wait on a fence each time round before checking again, in nanoseconds
+#define FENCE_TIMEOUT 1000000
+
+UploadRing::UploadRing() : m_bytes(0), m_current(0), m_isPersistent(false), m_isPartial(false), m_isCreated(false)
+{
+    for (unsigned int i = 0; i < UPLOAD_RING_SLOTS; ++i)
+    {
+        m_buffers[i] = 0;
+        m_textures[i] = 0;
+        m_fences[i] = 0;
+        m_mapped[i] = 0;
+    }
+}
+
+UploadRing::~UploadRing()
+{
+
+}
+
+bool UploadRing::supportsPersistentMapping()
+{
+#ifdef GL_MAP_PERSISTENT_BIT
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major > 4 || (major == 4 && minor >= 4))
+    {
+        return true;
+    }
+
+    GLint extensionNum = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionNum);
+    for (GLint i = 0; i < extensionNum; ++i)
+    {
+        const char *extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if (extension && !strcmp(extension, "GL_ARB_buffer_storage"))
+        {
+            return true;
+        }
+    }
+#endif
+    return false;
+}
+
+void UploadRing::create(const GLsizeiptr &_bytes, const GLenum &_textureFormat)
+{
+    destroy();
+
+    m_bytes = _bytes;
+    m_current = 0;
+    m_isPersistent = supportsPersistentMapping();
+
+    glGenBuffers(UPLOAD_RING_SLOTS, m_buffers);
+    glGenTextures(UPLOAD_RING_SLOTS, m_textures);
+
+    for (unsigned int i = 0; i < UPLOAD_RING_SLOTS; ++i)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, m_buffers[i]);
+#ifdef GL_MAP_PERSISTENT_BIT
+        if (m_isPersistent)
+        {
+            //coherent, so writes become visible to the GPU without any explicit flush
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_TEXTURE_BUFFER, m_bytes, NULL, flags);
+            m_mapped[i] = glMapBufferRange(GL_TEXTURE_BUFFER, 0, m_bytes, flags);
+        }
+        else
+#endif
+        {
+            glBufferData(GL_TEXTURE_BUFFER, m_bytes, NULL, GL_STREAM_DRAW);
+        }
+
+        glBindTexture(GL_TEXTURE_BUFFER, m_textures[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, _textureFormat, m_buffers[i]);
+    }
+
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    m_isCreated = true;
+}
+
+void UploadRing::destroy()
+{
+    if (!m_isCreated)
+    {
+        return;
+    }
+
+    for (unsigned int i = 0; i < UPLOAD_RING_SLOTS; ++i)
+    {
+        if (m_fences[i])
+        {
+            glDeleteSync(m_fences[i]);
+            m_fences[i] = 0;
+        }
+        if (m_mapped[i])
+        {
+            glBindBuffer(GL_TEXTURE_BUFFER, m_buffers[i]);
+            glUnmapBuffer(GL_TEXTURE_BUFFER);
+            m_mapped[i] = 0;
+        }
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    glDeleteTextures(UPLOAD_RING_SLOTS, m_textures);
+    glDeleteBuffers(UPLOAD_RING_SLOTS, m_buffers);
+    for (unsigned int i = 0; i < UPLOAD_RING_SLOTS; ++i)
+    {
+        m_buffers[i] = 0;
+        m_textures[i] = 0;
+    }
+    m_isCreated = false;
+}
+
+void UploadRing::waitForSlot(const unsigned int &_slot)
+{
+    if (!m_fences[_slot])
+    {
+        return;
+    }
+
+    //flush on the first wait so the fence is guaranteed to be reached eventually
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    for (;;)
+    {
+        GLenum result = glClientWaitSync(m_fences[_slot], flags, FENCE_TIMEOUT);
+        if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED)
+        {
+            break;
+        }
+        flags = 0;
+    }
+
+    glDeleteSync(m_fences[_slot]);
+    m_fences[_slot] = 0;
+}
+
+void* UploadRing::beginWrite(const bool &_partial)
+{
+    m_current = (m_current + 1) % UPLOAD_RING_SLOTS;
+    m_isPartial = _partial;
+    waitForSlot(m_current);
+
+    if (m_isPersistent)
+    {
+        return m_mapped[m_current];
+    }
+
+    //we have already waited for the GPU to finish with this slot, so the driver doesn't need to
+    //synchronise the mapping itself; a partial write has to keep the rest of the slot, and tells
+    //the driver which parts to send rather than having it send the lot
+    glBindBuffer(GL_TEXTURE_BUFFER, m_buffers[m_current]);
+    const GLbitfield access = _partial ? GL_MAP_FLUSH_EXPLICIT_BIT : GL_MAP_INVALIDATE_RANGE_BIT;
+    return glMapBufferRange(GL_TEXTURE_BUFFER, 0, m_bytes, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | access);
+}
+
+void UploadRing::flushRange(const GLintptr &_offset, const GLsizeiptr &_bytes)
+{
+    //coherent persistent mappings are already visible to the GPU
+    if (m_isPartial && !m_isPersistent)
+    {
+        glFlushMappedBufferRange(GL_TEXTURE_BUFFER, _offset, _bytes);
+    }
+}
+
+void UploadRing::endWrite()
+{
+    if (!m_isPersistent)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, m_buffers[m_current]);
+        glUnmapBuffer(GL_TEXTURE_BUFFER);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void UploadRing::fence()
+{
+    if (!m_isCreated)
+    {
+        return;
+    }
+
+    if (m_fences[m_current])
+    {
+        glDeleteSync(m_fences[m_current]);
+    }
+    m_fences[m_current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}